@@ -0,0 +1,222 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bbv.h"
+#include "debug.h"
+#include "opcode.h"
+#include "util.h"
+
+/*
+ Basic-block vectors for SimPoint.  A block runs from its entry PC up to and
+ including the next control transfer (or anything else that doesn't fall
+ through, such as ERET); blocks are identified by entry PC and numbered
+ from 1 in order of first execution.  Every interval instructions (checked
+ at block ends, like other BBV tools) we write one line of the standard
+ format,
+
+   T:<id>:<count> :<id>:<count> ...
+
+ where count is the number of instructions executed in that block during
+ the interval.
+ */
+#define BBV_INIT_SIZE 1024
+
+struct block {
+    uint32_t pc;
+    uint32_t id;            /* 0 if the slot is free. */
+    uint64_t count;         /* Instructions this interval. */
+};
+
+struct bbv {
+    uint64_t interval;
+    FILE *out;
+
+    struct block *table;
+    uint32_t size;          /* Power of two. */
+    uint32_t nblocks;
+    uint32_t *touched;      /* Slots with a nonzero count, in order. */
+    uint32_t ntouched;
+
+    uint32_t start;         /* Entry PC of the current block. */
+    uint32_t len;           /* Instructions so far in the current block. */
+    uint64_t done;          /* Instructions so far in the interval. */
+    uint64_t intervals;
+};
+
+static void end_block(bbv_t *b);
+static struct block *lookup(bbv_t *b, uint32_t pc);
+static void grow(bbv_t *b);
+static void write_interval(bbv_t *b);
+
+bbv_t *bbv_create(uint64_t interval, FILE *out)
+{
+    bbv_t *b = xmalloc(sizeof(*b));
+
+    b->interval = interval;
+    b->out = out;
+    b->size = BBV_INIT_SIZE;
+    b->table = xmalloc(b->size * sizeof(*b->table));
+    memset(b->table, 0, b->size * sizeof(*b->table));
+    b->touched = xmalloc(b->size * sizeof(*b->touched));
+    b->nblocks = 0;
+    b->ntouched = 0;
+    b->start = 0;
+    b->len = 0;
+    b->done = 0;
+    b->intervals = 0;
+    return b;
+}
+
+void bbv_destroy(bbv_t *b)
+{
+    free(b->table);
+    free(b->touched);
+    free(b);
+}
+
+/* Called for every retired instruction. */
+void bbv_step(bbv_t *b, uint32_t pc, uint32_t ins, uint32_t next_pc)
+{
+    int cti;
+
+    if (!b->len) {
+        b->start = pc;
+    }
+    b->len++;
+
+    switch (OP(ins)) {
+    case OP_SPECIAL:
+        cti = (FUNCT(ins) == FUNCT_JR) || (FUNCT(ins) == FUNCT_JALR);
+        break;
+    case OP_REGIMM:
+    case OP_J:
+    case OP_JAL:
+    case OP_BEQ:
+    case OP_BNE:
+    case OP_BLEZ:
+    case OP_BGTZ:
+        cti = 1;
+        break;
+    default:
+        cti = 0;
+        break;
+    }
+
+    if (cti || (next_pc != pc + 4)) {
+        end_block(b);
+    }
+}
+
+/* Called instead of bbv_step when an instruction takes an exception. */
+void bbv_except(bbv_t *b)
+{
+    if (b->len) {
+        end_block(b);
+    }
+}
+
+/* Writes out the partial last interval, if any. */
+void bbv_finish(bbv_t *b)
+{
+    if (b->len) {
+        end_block(b);
+    }
+    if (b->ntouched) {
+        write_interval(b);
+    }
+    fflush(b->out);
+    debug_printf(MAIN, INFO, "Wrote %llu basic-block vectors (%u blocks)\n",
+            (unsigned long long)b->intervals, b->nblocks);
+}
+
+static void end_block(bbv_t *b)
+{
+    struct block *blk = lookup(b, b->start);
+
+    if (!blk->count) {
+        b->touched[b->ntouched++] = blk - b->table;
+    }
+    blk->count += b->len;
+    b->done += b->len;
+    b->len = 0;
+
+    if (b->done >= b->interval) {
+        write_interval(b);
+    }
+}
+
+static struct block *lookup(bbv_t *b, uint32_t pc)
+{
+    uint32_t i = (pc >> 2) * 2654435761u;
+
+    for (;;) {
+        i &= b->size - 1;
+        if (b->table[i].id == 0) {
+            break;
+        }
+        if (b->table[i].pc == pc) {
+            return &b->table[i];
+        }
+        i++;
+    }
+
+    /* New block: keep the table at most half full. */
+    if (2 * (b->nblocks + 1) > b->size) {
+        grow(b);
+        return lookup(b, pc);
+    }
+    b->table[i].pc = pc;
+    b->table[i].id = ++b->nblocks;
+    b->table[i].count = 0;
+    return &b->table[i];
+}
+
+/* Rehashes into a table twice the size, rebuilding the touched list. */
+static void grow(bbv_t *b)
+{
+    struct block *old = b->table;
+    uint32_t old_size = b->size, i, j;
+
+    b->size *= 2;
+    b->table = xmalloc(b->size * sizeof(*b->table));
+    memset(b->table, 0, b->size * sizeof(*b->table));
+    b->touched = xrealloc(b->touched, b->size * sizeof(*b->touched));
+    b->ntouched = 0;
+
+    for (i = 0; i < old_size; i++) {
+        if (!old[i].id) {
+            continue;
+        }
+        for (j = (old[i].pc >> 2) * 2654435761u; ; j++) {
+            j &= b->size - 1;
+            if (!b->table[j].id) {
+                break;
+            }
+        }
+        b->table[j] = old[i];
+        if (old[i].count) {
+            b->touched[b->ntouched++] = j;
+        }
+    }
+    free(old);
+}
+
+static void write_interval(bbv_t *b)
+{
+    uint32_t i;
+    struct block *blk;
+
+    fputc('T', b->out);
+    for (i = 0; i < b->ntouched; i++) {
+        blk = &b->table[b->touched[i]];
+        fprintf(b->out, ":%u:%llu ", blk->id, (unsigned long long)blk->count);
+        blk->count = 0;
+    }
+    fputc('\n', b->out);
+    b->ntouched = 0;
+    b->done = 0;
+    b->intervals++;
+}
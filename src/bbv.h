@@ -0,0 +1,15 @@
+#ifndef BBV_H
+#define BBV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct bbv bbv_t;
+
+bbv_t *bbv_create(uint64_t interval, FILE *out);
+void bbv_destroy(bbv_t *b);
+void bbv_step(bbv_t *b, uint32_t pc, uint32_t ins, uint32_t next_pc);
+void bbv_except(bbv_t *b);
+void bbv_finish(bbv_t *b);
+
+#endif
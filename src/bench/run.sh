@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Runs each benchmark workload several times and reports the simulator's
+# speed in host MIPS (mean and standard deviation over the runs).
+#
+# usage: run.sh <tmips> [runs]
+
+TMIPS=${1:-./tmips}
+RUNS=${2:-5}
+DIR=$(dirname "$0")
+
+# name, entry point, extra options
+WORKLOADS="
+alu     80000000
+stream  80000000
+string  80000000
+branch  80000000
+tlb     80000200 -f lab5
+exc     80000200
+"
+
+printf '%-8s %12s %10s %10s\n' workload instructions MIPS stddev
+echo "$WORKLOADS" | while read -r name pc opts; do
+    [ -n "$name" ] || continue
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        # shellcheck disable=SC2086
+        "$TMIPS" -r 0 100000 "$DIR/$name.hex" -p "$pc" $opts -d /dev/null \
+            --stats 2>&1 | grep 'instructions retired'
+        i=$((i + 1))
+    done | awk -v name="$name" '
+        { n++; insts = $2; mips[n] = $8; sum += $8 }
+        END {
+            if (n == 0) { printf "%-8s failed\n", name; exit 1 }
+            mean = sum / n
+            for (i = 1; i <= n; i++) { var += (mips[i] - mean) ^ 2 }
+            sd = (n > 1) ? sqrt(var / (n - 1)) : 0
+            printf "%-8s %12d %10.2f %10.2f\n", name, insts, mean, sd
+        }'
+done
@@ -0,0 +1,493 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpred.h"
+#include "debug.h"
+#include "opcode.h"
+#include "uarch.h"
+#include "util.h"
+
+#define DEFAULT_BITS 12
+#define MAX_BITS 24
+#define BTB_BITS 9
+#define RAS_DEPTH 16
+#define TOP_BRANCHES 10
+
+enum {
+    BPRED_STATIC,           /* Backward taken, forward not taken. */
+    BPRED_BIMODAL,
+    BPRED_GSHARE,
+    BPRED_TOURNAMENT
+};
+
+static const char *type_names[] = {
+    [BPRED_STATIC] = "static",
+    [BPRED_BIMODAL] = "bimodal",
+    [BPRED_GSHARE] = "gshare",
+    [BPRED_TOURNAMENT] = "tournament"
+};
+
+enum {
+    KIND_COND,
+    KIND_JUMP,
+    KIND_INDIRECT,
+    KIND_RETURN,
+    NUM_KINDS
+};
+
+static const char *kind_names[] = {
+    [KIND_COND] = "conditional",
+    [KIND_JUMP] = "jump",
+    [KIND_INDIRECT] = "indirect",
+    [KIND_RETURN] = "return"
+};
+
+/*
+ Every predictor has its own BTB (direct-mapped, tagged with the full PC) and
+ return address stack.  A prediction is the next fetch address: a predicted
+ taken branch or a jump with no BTB entry falls through, and returns use the
+ RAS.  Anything that gets the next PC wrong counts as a misprediction.
+
+ The 2-bit counter tables are plain byte arrays; bimodal indexes them by PC,
+ gshare by PC xor global history, and tournament keeps one of each plus a
+ PC-indexed chooser.
+ */
+struct bpred {
+    char name[32];
+    int type;
+    unsigned bits;
+    uint32_t mask;
+
+    uint8_t *local;
+    uint8_t *global;
+    uint8_t *chooser;
+    uint32_t history;
+
+    uint32_t btb_tag[1 << BTB_BITS];
+    uint32_t btb_target[1 << BTB_BITS];
+
+    uint32_t ras[RAS_DEPTH];
+    unsigned ras_top;
+
+    uint64_t count[NUM_KINDS];
+    uint64_t miss[NUM_KINDS];
+    uint64_t dir_miss;
+};
+
+struct branch {
+    uint32_t pc;
+    uint32_t used;
+    uint64_t count;
+    uint64_t taken;
+    uint64_t miss[BPRED_MAX];
+};
+
+struct bpred_set {
+    bpred_t *bp[BPRED_MAX];
+    int n;
+
+    struct branch *table;
+    uint32_t size;
+    uint32_t used;
+};
+
+static int kind_of(const uarch_dec_t *d);
+static int predict_dir(bpred_t *bp, uint32_t pc, uint32_t ins);
+static void train_dir(bpred_t *bp, uint32_t pc, int taken);
+static void train(uint8_t *ctr, int taken);
+static uint32_t *btb_lookup(bpred_t *bp, uint32_t pc);
+static struct branch *find_branch(bpred_set_t *s, uint32_t pc);
+static int cmp_branch(const void *a, const void *b);
+static uint8_t *new_counters(unsigned bits);
+
+/* spec is <type>[:<bits>] */
+bpred_t *bpred_create_spec(char *spec)
+{
+    bpred_t *bp;
+    unsigned long bits = DEFAULT_BITS;
+    char *colon, *end;
+    size_t len;
+    int type;
+
+    colon = strchr(spec, ':');
+    len = colon ? (size_t)(colon - spec) : strlen(spec);
+    for (type = 0; type <= BPRED_TOURNAMENT; type++) {
+        if ((strlen(type_names[type]) == len) &&
+            !strncmp(type_names[type], spec, len)) {
+            break;
+        }
+    }
+    if (type > BPRED_TOURNAMENT) {
+        debug_printf(CONFIG, FATAL, "--bpred: unknown predictor \"%s\"\n",
+                spec);
+        return NULL;
+    }
+    if (colon) {
+        bits = strtoul(colon + 1, &end, 10);
+        if ((*end != '\0') || (bits < 1) || (bits > MAX_BITS)) {
+            debug_printf(CONFIG, FATAL,
+                    "--bpred: invalid table size in \"%s\" (1-%d bits)\n",
+                    spec, MAX_BITS);
+            return NULL;
+        }
+    }
+
+    bp = xmalloc(sizeof(*bp));
+    memset(bp, 0, sizeof(*bp));
+    bp->type = type;
+    bp->bits = bits;
+    bp->mask = (1U << bits) - 1;
+    if (type == BPRED_STATIC) {
+        sprintf(bp->name, "%s", type_names[type]);
+    } else {
+        sprintf(bp->name, "%s:%u", type_names[type], bp->bits);
+    }
+    if ((type == BPRED_BIMODAL) || (type == BPRED_TOURNAMENT)) {
+        bp->local = new_counters(bits);
+    }
+    if ((type == BPRED_GSHARE) || (type == BPRED_TOURNAMENT)) {
+        bp->global = new_counters(bits);
+    }
+    if (type == BPRED_TOURNAMENT) {
+        bp->chooser = new_counters(bits);
+    }
+
+    return bp;
+}
+
+void bpred_destroy(bpred_t *bp)
+{
+    free(bp->local);
+    free(bp->global);
+    free(bp->chooser);
+    free(bp);
+}
+
+/* Returns nonzero if bp mispredicted this control transfer. */
+int bpred_update(bpred_t *bp, const uarch_rec_t *rec, const uarch_dec_t *d)
+{
+    int kind = kind_of(d);
+    int taken = rec->next_pc != rec->pc + 4;
+    uint32_t predicted = rec->pc + 4;
+    uint32_t *target;
+    int miss;
+
+    target = btb_lookup(bp, rec->pc);
+
+    switch (kind) {
+    case KIND_COND:
+        if (predict_dir(bp, rec->pc, rec->ins)) {
+            if (target) {
+                predicted = *target;
+            }
+            if (!taken) {
+                bp->dir_miss++;
+            }
+        } else if (taken) {
+            bp->dir_miss++;
+        }
+        train_dir(bp, rec->pc, taken);
+        break;
+    case KIND_RETURN:
+        /* An empty RAS falls back to the BTB. */
+        if (bp->ras_top > 0) {
+            predicted = bp->ras[--bp->ras_top % RAS_DEPTH];
+            break;
+        }
+        /* Fall through. */
+    default:
+        if (target) {
+            predicted = *target;
+        }
+        break;
+    }
+
+    miss = predicted != rec->next_pc;
+    bp->count[kind]++;
+    bp->miss[kind] += miss;
+
+    if (taken && (kind != KIND_RETURN)) {
+        uint32_t idx = (rec->pc >> 2) & ((1 << BTB_BITS) - 1);
+        bp->btb_tag[idx] = rec->pc;
+        bp->btb_target[idx] = rec->next_pc;
+    }
+    /* Calls push even if they are conditional and not taken, like BxxZAL. */
+    if (d->dst == 31) {
+        bp->ras[bp->ras_top++ % RAS_DEPTH] = rec->pc + 4;
+        if (bp->ras_top > 2 * RAS_DEPTH) {
+            bp->ras_top -= RAS_DEPTH;
+        }
+    }
+
+    return miss;
+}
+
+void bpred_report(bpred_t *bp, FILE *out)
+{
+    uint64_t count = 0, miss = 0;
+    int k;
+
+    for (k = 0; k < NUM_KINDS; k++) {
+        count += bp->count[k];
+        miss += bp->miss[k];
+    }
+
+    fprintf(out, "bpred %s: %llu control transfers, %llu mispredicted "
+            "(%.2f%%)\n", bp->name, (unsigned long long)count,
+            (unsigned long long)miss, count ? 100.0 * miss / count : 0.0);
+    fprintf(out, "bpred %s:", bp->name);
+    for (k = 0; k < NUM_KINDS; k++) {
+        fprintf(out, " %s %llu/%llu", kind_names[k],
+                (unsigned long long)bp->miss[k],
+                (unsigned long long)bp->count[k]);
+    }
+    fprintf(out, " (direction %llu)\n", (unsigned long long)bp->dir_miss);
+}
+
+
+
+bpred_set_t *bpred_set_create(void)
+{
+    bpred_set_t *s = xmalloc(sizeof(*s));
+    s->n = 0;
+    s->size = 1024;
+    s->used = 0;
+    s->table = xmalloc(s->size * sizeof(*s->table));
+    memset(s->table, 0, s->size * sizeof(*s->table));
+    return s;
+}
+
+void bpred_set_destroy(bpred_set_t *s)
+{
+    int i;
+
+    for (i = 0; i < s->n; i++) {
+        bpred_destroy(s->bp[i]);
+    }
+    free(s->table);
+    free(s);
+}
+
+int bpred_set_add(bpred_set_t *s, char *spec)
+{
+    if (s->n == BPRED_MAX) {
+        debug_printf(CONFIG, FATAL,
+                "--bpred: at most %d predictors may be given\n", BPRED_MAX);
+        return 1;
+    }
+    s->bp[s->n] = bpred_create_spec(spec);
+    if (!s->bp[s->n]) {
+        return 1;
+    }
+    s->n++;
+    return 0;
+}
+
+/*
+ Runs every predictor on a control transfer.  Returns a mask with bit i set if
+ predictor i mispredicted.
+ */
+unsigned bpred_set_update(bpred_set_t *s, const uarch_rec_t *rec,
+                          const uarch_dec_t *d)
+{
+    struct branch *b = find_branch(s, rec->pc);
+    unsigned mask = 0;
+    int i;
+
+    b->count++;
+    b->taken += rec->next_pc != rec->pc + 4;
+    for (i = 0; i < s->n; i++) {
+        if (bpred_update(s->bp[i], rec, d)) {
+            b->miss[i]++;
+            mask |= 1U << i;
+        }
+    }
+
+    return mask;
+}
+
+void bpred_set_report(bpred_set_t *s, FILE *out)
+{
+    struct branch *sorted;
+    uint32_t i, n;
+    int j;
+
+    for (j = 0; j < s->n; j++) {
+        bpred_report(s->bp[j], out);
+    }
+    if (!s->used) {
+        return;
+    }
+
+    sorted = xmalloc(s->used * sizeof(*sorted));
+    for (i = n = 0; i < s->size; i++) {
+        if (s->table[i].used) {
+            sorted[n++] = s->table[i];
+        }
+    }
+    qsort(sorted, n, sizeof(*sorted), &cmp_branch);
+
+    fprintf(out, "bpred: most mispredicted branches (of %u):\n", n);
+    fprintf(out, "bpred:   %-8s  %12s  %7s", "pc", "count", "taken");
+    for (j = 0; j < s->n; j++) {
+        fprintf(out, "  %14s", s->bp[j]->name);
+    }
+    fprintf(out, "\n");
+    for (i = 0; (i < n) && (i < TOP_BRANCHES); i++) {
+        fprintf(out, "bpred:   %08x  %12llu  %6.2f%%", sorted[i].pc,
+                (unsigned long long)sorted[i].count,
+                100.0 * sorted[i].taken / sorted[i].count);
+        for (j = 0; j < s->n; j++) {
+            fprintf(out, "  %13.2f%%",
+                    100.0 * sorted[i].miss[j] / sorted[i].count);
+        }
+        fprintf(out, "\n");
+    }
+
+    free(sorted);
+}
+
+
+
+static int kind_of(const uarch_dec_t *d)
+{
+    switch (d->cls) {
+    case UARCH_CLASS_BRANCH:
+        return KIND_COND;
+    case UARCH_CLASS_JUMP:
+        return KIND_JUMP;
+    default:
+        assert(d->cls == UARCH_CLASS_JUMP_REG);
+        return ((d->src1 == 31) && (d->dst == UARCH_NO_REG))
+                ? KIND_RETURN : KIND_INDIRECT;
+    }
+}
+
+static int predict_dir(bpred_t *bp, uint32_t pc, uint32_t ins)
+{
+    uint32_t li = (pc >> 2) & bp->mask;
+    uint32_t gi = ((pc >> 2) ^ bp->history) & bp->mask;
+
+    switch (bp->type) {
+    case BPRED_STATIC:
+        return IMMED(ins) & 0x8000;
+    case BPRED_BIMODAL:
+        return bp->local[li] >= 2;
+    case BPRED_GSHARE:
+        return bp->global[gi] >= 2;
+    default:
+        return (bp->chooser[li] >= 2) ? (bp->global[gi] >= 2)
+                                      : (bp->local[li] >= 2);
+    }
+}
+
+static void train_dir(bpred_t *bp, uint32_t pc, int taken)
+{
+    uint32_t li = (pc >> 2) & bp->mask;
+    uint32_t gi = ((pc >> 2) ^ bp->history) & bp->mask;
+    int lok, gok;
+
+    switch (bp->type) {
+    case BPRED_BIMODAL:
+        train(&bp->local[li], taken);
+        break;
+    case BPRED_GSHARE:
+        train(&bp->global[gi], taken);
+        break;
+    case BPRED_TOURNAMENT:
+        lok = (bp->local[li] >= 2) == taken;
+        gok = (bp->global[gi] >= 2) == taken;
+        if (lok != gok) {
+            train(&bp->chooser[li], gok);
+        }
+        train(&bp->local[li], taken);
+        train(&bp->global[gi], taken);
+        break;
+    }
+
+    bp->history = ((bp->history << 1) | (taken ? 1 : 0)) & bp->mask;
+}
+
+static void train(uint8_t *ctr, int taken)
+{
+    if (taken) {
+        if (*ctr < 3) { (*ctr)++; }
+    } else {
+        if (*ctr > 0) { (*ctr)--; }
+    }
+}
+
+static uint32_t *btb_lookup(bpred_t *bp, uint32_t pc)
+{
+    uint32_t idx = (pc >> 2) & ((1 << BTB_BITS) - 1);
+
+    if (bp->btb_tag[idx] == pc && bp->btb_target[idx]) {
+        return &bp->btb_target[idx];
+    }
+    return NULL;
+}
+
+/*
+ Per-branch counts live in an open-addressed hash table keyed by PC, which is
+ doubled whenever it gets half full.
+ */
+static struct branch *find_branch(bpred_set_t *s, uint32_t pc)
+{
+    struct branch *old;
+    uint32_t i, h, old_size;
+
+    for (;;) {
+        h = (pc >> 2) * 2654435761U;
+        for (i = h & (s->size - 1); s->table[i].used;
+             i = (i + 1) & (s->size - 1)) {
+            if (s->table[i].pc == pc) {
+                return &s->table[i];
+            }
+        }
+        if (2 * (s->used + 1) <= s->size) {
+            break;
+        }
+
+        old = s->table;
+        old_size = s->size;
+        s->size *= 2;
+        s->table = xmalloc(s->size * sizeof(*s->table));
+        memset(s->table, 0, s->size * sizeof(*s->table));
+        for (h = 0; h < old_size; h++) {
+            if (old[h].used) {
+                for (i = ((old[h].pc >> 2) * 2654435761U) & (s->size - 1);
+                     s->table[i].used; i = (i + 1) & (s->size - 1))
+                    ;
+                s->table[i] = old[h];
+            }
+        }
+        free(old);
+    }
+
+    s->table[i].pc = pc;
+    s->table[i].used = 1;
+    s->used++;
+    return &s->table[i];
+}
+
+static int cmp_branch(const void *a, const void *b)
+{
+    const struct branch *x = a, *y = b;
+
+    if (x->miss[0] != y->miss[0]) {
+        return (x->miss[0] < y->miss[0]) ? 1 : -1;
+    }
+    return (x->count < y->count) ? 1 : (x->count > y->count) ? -1 : 0;
+}
+
+static uint8_t *new_counters(unsigned bits)
+{
+    uint8_t *p = xmalloc((size_t)1 << bits);
+
+    /* Weakly taken. */
+    memset(p, 2, (size_t)1 << bits);
+    return p;
+}
@@ -0,0 +1,26 @@
+#ifndef BPRED_H
+#define BPRED_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "uarch.h"
+
+#define BPRED_MAX 8
+
+typedef struct bpred bpred_t;
+typedef struct bpred_set bpred_set_t;
+
+bpred_t *bpred_create_spec(char *spec);
+void bpred_destroy(bpred_t *bp);
+int bpred_update(bpred_t *bp, const uarch_rec_t *rec, const uarch_dec_t *d);
+void bpred_report(bpred_t *bp, FILE *out);
+
+bpred_set_t *bpred_set_create(void);
+void bpred_set_destroy(bpred_set_t *s);
+int bpred_set_add(bpred_set_t *s, char *spec);
+unsigned bpred_set_update(bpred_set_t *s, const uarch_rec_t *rec,
+                          const uarch_dec_t *d);
+void bpred_set_report(bpred_set_t *s, FILE *out);
+
+#endif
@@ -0,0 +1,346 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "debug.h"
+#include "util.h"
+
+#define MAX_ASSOC 64
+
+/*
+ All state lives in flat per-way arrays indexed by set * assoc + way, so an
+ access is a shift, a mask and a scan of at most assoc tags.  tags[] holds the
+ line address plus one, leaving zero free to mean "invalid".
+ */
+struct cache {
+    char *name;
+    uint32_t size;
+    uint32_t line;
+    uint32_t assoc;
+    int repl;
+    int write_policy;
+
+    unsigned line_shift;
+    uint32_t set_mask;
+
+    uint32_t *tags;
+    uint8_t *dirty;
+    uint64_t *stamp;        /* LRU: time of last use. */
+    uint64_t *plru;         /* PLRU: one tree of assoc - 1 bits per set. */
+    uint64_t clock;
+    uint32_t rand;
+
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_misses;
+    uint64_t write_misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+};
+
+static const char *repl_names[] = {
+    [CACHE_REPL_LRU] = "lru",
+    [CACHE_REPL_PLRU] = "plru",
+    [CACHE_REPL_RANDOM] = "random"
+};
+
+static const char *write_names[] = {
+    [CACHE_WRITE_BACK] = "wb",
+    [CACHE_WRITE_THROUGH] = "wt"
+};
+
+static int is_pow2(uint32_t x);
+static unsigned log2_32(uint32_t x);
+static uint32_t victim(cache_t *c, uint32_t set);
+static void touch(cache_t *c, uint32_t set, uint32_t way);
+static int lookup_name(const char **names, int n, char *s);
+static int parse_size(char *s, unsigned long *out);
+
+cache_t *cache_create(char *name, uint32_t size, uint32_t line,
+                      uint32_t assoc, int repl, int write_policy)
+{
+    cache_t *c;
+    uint32_t sets, ways;
+
+    if (!is_pow2(size) || !is_pow2(line) || !is_pow2(assoc) || (line < 4) ||
+        (assoc > MAX_ASSOC) || ((uint64_t)line * assoc > size)) {
+        debug_printf(CONFIG, FATAL,
+                "%s: invalid geometry (size=%u line=%u assoc=%u); sizes must "
+                "be powers of two, line >= 4, assoc <= %d\n",
+                name, size, line, assoc, MAX_ASSOC);
+        return NULL;
+    }
+
+    sets = size / (line * assoc);
+    ways = sets * assoc;
+
+    c = xmalloc(sizeof(*c));
+    memset(c, 0, sizeof(*c));
+    c->name = name;
+    c->size = size;
+    c->line = line;
+    c->assoc = assoc;
+    c->repl = repl;
+    c->write_policy = write_policy;
+    c->line_shift = log2_32(line);
+    c->set_mask = sets - 1;
+    c->rand = 0x2545F491;
+
+    c->tags = xmalloc(ways * sizeof(*c->tags));
+    memset(c->tags, 0, ways * sizeof(*c->tags));
+    c->dirty = xmalloc(ways);
+    memset(c->dirty, 0, ways);
+    c->stamp = NULL;
+    c->plru = NULL;
+    if (repl == CACHE_REPL_LRU) {
+        c->stamp = xmalloc(ways * sizeof(*c->stamp));
+        memset(c->stamp, 0, ways * sizeof(*c->stamp));
+    } else if (repl == CACHE_REPL_PLRU) {
+        c->plru = xmalloc(sets * sizeof(*c->plru));
+        memset(c->plru, 0, sets * sizeof(*c->plru));
+    }
+
+    debug_printf(CONFIG, INFO,
+            "%s: %u bytes, %u-byte lines, %u-way, %u sets, %s, %s\n",
+            name, size, line, assoc, sets, repl_names[repl],
+            write_names[write_policy]);
+
+    return c;
+}
+
+/* spec is <size>:<line>:<assoc>[:<lru|plru|random>[:<wb|wt>]] */
+cache_t *cache_create_spec(char *name, char *spec)
+{
+    char buf[64];
+    char *field[5];
+    char *p;
+    unsigned long v[3];
+    int repl = CACHE_REPL_LRU, write_policy = CACHE_WRITE_BACK;
+    int i, n;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        goto bad;
+    }
+    strcpy(buf, spec);
+    n = 0;
+    for (p = strtok(buf, ":"); p; p = strtok(NULL, ":")) {
+        if (n == 5) {
+            goto bad;
+        }
+        field[n++] = p;
+    }
+    if (n < 3) {
+        goto bad;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (parse_size(field[i], &v[i])) {
+            goto bad;
+        }
+    }
+    if ((n > 3) && ((repl = lookup_name(repl_names, 3, field[3])) < 0)) {
+        goto bad;
+    }
+    if ((n > 4) &&
+        ((write_policy = lookup_name(write_names, 2, field[4])) < 0)) {
+        goto bad;
+    }
+
+    return cache_create(name, v[0], v[1], v[2], repl, write_policy);
+
+bad:
+    debug_printf(CONFIG, FATAL,
+            "%s: invalid cache spec \"%s\" (expected "
+            "<size>:<line>:<assoc>[:lru|plru|random[:wb|wt]])\n", name, spec);
+    return NULL;
+}
+
+void cache_destroy(cache_t *c)
+{
+    free(c->tags);
+    free(c->dirty);
+    free(c->stamp);
+    free(c->plru);
+    free(c);
+}
+
+/* Returns CACHE_* flags; *wb_addr is only set with CACHE_WRITEBACK. */
+int cache_access(cache_t *c, uint32_t addr, int write, uint32_t *wb_addr)
+{
+    uint32_t tag = (addr >> c->line_shift) + 1;
+    uint32_t set = (addr >> c->line_shift) & c->set_mask;
+    uint32_t base = set * c->assoc;
+    uint32_t way;
+    int ret = CACHE_FILL;
+
+    if (write) { c->writes++; } else { c->reads++; }
+
+    for (way = 0; way < c->assoc; way++) {
+        if (c->tags[base + way] == tag) {
+            touch(c, set, way);
+            if (write && (c->write_policy == CACHE_WRITE_BACK)) {
+                c->dirty[base + way] = 1;
+            }
+            return CACHE_HIT;
+        }
+    }
+
+    if (write) { c->write_misses++; } else { c->read_misses++; }
+
+    if (write && (c->write_policy == CACHE_WRITE_THROUGH)) {
+        return 0;
+    }
+
+    way = victim(c, set);
+    if (c->tags[base + way]) {
+        c->evictions++;
+        if (c->dirty[base + way]) {
+            c->writebacks++;
+            *wb_addr = (c->tags[base + way] - 1) << c->line_shift;
+            ret |= CACHE_WRITEBACK;
+        }
+    }
+    c->tags[base + way] = tag;
+    c->dirty[base + way] = write;
+    touch(c, set, way);
+
+    return ret;
+}
+
+void cache_counts(cache_t *c, uint64_t *accesses, uint64_t *misses)
+{
+    *accesses = c->reads + c->writes;
+    *misses = c->read_misses + c->write_misses;
+}
+
+void cache_report(cache_t *c, FILE *out)
+{
+    uint64_t accesses = c->reads + c->writes;
+    uint64_t misses = c->read_misses + c->write_misses;
+
+    fprintf(out, "%s: %llu accesses, %llu hits, %llu misses (%.2f%%)\n",
+            c->name, (unsigned long long)accesses,
+            (unsigned long long)(accesses - misses),
+            (unsigned long long)misses,
+            accesses ? 100.0 * misses / accesses : 0.0);
+    fprintf(out, "%s: reads %llu (%llu misses), writes %llu (%llu misses), "
+            "evictions %llu, writebacks %llu\n",
+            c->name, (unsigned long long)c->reads,
+            (unsigned long long)c->read_misses,
+            (unsigned long long)c->writes,
+            (unsigned long long)c->write_misses,
+            (unsigned long long)c->evictions,
+            (unsigned long long)c->writebacks);
+}
+
+
+
+static int is_pow2(uint32_t x)
+{
+    return x && !(x & (x - 1));
+}
+
+static unsigned log2_32(uint32_t x)
+{
+    unsigned n = 0;
+
+    while (x >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+/*
+ Invalid ways are always filled first.  Tree PLRU keeps, for each internal
+ node, a bit pointing toward the less recently used half; node n's children
+ are 2n+1 and 2n+2, and leaves below node assoc-1 are ways.
+ */
+static uint32_t victim(cache_t *c, uint32_t set)
+{
+    uint32_t base = set * c->assoc;
+    uint32_t way, best, node;
+
+    for (way = 0; way < c->assoc; way++) {
+        if (!c->tags[base + way]) {
+            return way;
+        }
+    }
+
+    switch (c->repl) {
+    case CACHE_REPL_LRU:
+        best = 0;
+        for (way = 1; way < c->assoc; way++) {
+            if (c->stamp[base + way] < c->stamp[base + best]) {
+                best = way;
+            }
+        }
+        return best;
+    case CACHE_REPL_PLRU:
+        node = 0;
+        while (node < c->assoc - 1) {
+            node = 2 * node + 1 + ((c->plru[set] >> node) & 1);
+        }
+        return node - (c->assoc - 1);
+    default:
+        c->rand ^= c->rand << 13;
+        c->rand ^= c->rand >> 17;
+        c->rand ^= c->rand << 5;
+        return c->rand & (c->assoc - 1);
+    }
+}
+
+static void touch(cache_t *c, uint32_t set, uint32_t way)
+{
+    uint32_t node;
+    int right;
+
+    if (c->repl == CACHE_REPL_LRU) {
+        c->stamp[set * c->assoc + way] = ++c->clock;
+    } else if (c->repl == CACHE_REPL_PLRU) {
+        /* Walk up from the leaf, pointing each node away from it. */
+        node = way + c->assoc - 1;
+        while (node > 0) {
+            right = !(node & 1);
+            node = (node - 1) / 2;
+            if (right) {
+                c->plru[set] &= ~((uint64_t)1 << node);
+            } else {
+                c->plru[set] |= (uint64_t)1 << node;
+            }
+        }
+    }
+}
+
+static int lookup_name(const char **names, int n, char *s)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (!strcmp(names[i], s)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Accepts a decimal or 0x-prefixed number with an optional k or M suffix. */
+static int parse_size(char *s, unsigned long *out)
+{
+    char *end;
+
+    *out = strtoul(s, &end, 0);
+    if (end == s) {
+        return 1;
+    }
+    if ((*end == 'k') || (*end == 'K')) {
+        *out <<= 10;
+        end++;
+    } else if (*end == 'M') {
+        *out <<= 20;
+        end++;
+    }
+    return (*end != '\0') || (*out > UINT32_MAX);
+}
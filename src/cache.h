@@ -0,0 +1,36 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct cache cache_t;
+
+enum {
+    CACHE_REPL_LRU,
+    CACHE_REPL_PLRU,
+    CACHE_REPL_RANDOM
+};
+
+enum {
+    CACHE_WRITE_BACK,       /* Write-allocate; dirty lines written on evict. */
+    CACHE_WRITE_THROUGH     /* No write-allocate; every write goes through. */
+};
+
+/* What cache_access did, or'd together. */
+enum {
+    CACHE_HIT       = 1 << 0,
+    CACHE_FILL      = 1 << 1,   /* Missed, and read the line in. */
+    CACHE_WRITEBACK = 1 << 2    /* Evicted a dirty line, at *wb_addr. */
+};
+
+cache_t *cache_create(char *name, uint32_t size, uint32_t line,
+                      uint32_t assoc, int repl, int write_policy);
+cache_t *cache_create_spec(char *name, char *spec);
+void cache_destroy(cache_t *cache);
+int cache_access(cache_t *cache, uint32_t addr, int write,
+                 uint32_t *wb_addr);
+void cache_counts(cache_t *cache, uint64_t *accesses, uint64_t *misses);
+void cache_report(cache_t *cache, FILE *out);
+
+#endif
@@ -7,24 +7,37 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "cache.h"
 #include "config.h"
 #include "core.h"
+#include "core_cp0.h"
 #include "debug.h"
+#include "disk.h"
+#include "dram.h"
+#include "dump.h"
 #include "filter.h"
 #include "mem.h"
 #include "mem_dev.h"
 #include "ram.h"
 #include "readmemh.h"
+#include "rr.h"
+#include "sample.h"
 #include "serial.h"
+#include "sym.h"
+#include "timer.h"
+#include "uarch.h"
 
 static void version(void);
 static void usage(char *progn);
 static int do_region(mem_t *mem, uint32_t base, uint32_t size, char *file);
+static uarch_t *get_uarch(config_t *cfg);
+static int add_watch(config_t *cfg, char *opt, char *spec, int kinds);
 
 int config_parse_args(config_t *cfg, int argc, char *argv[])
 {
     int i;
     int saw_dump_file = 0;
+    int saw_rr = 0;
 
     if (argc < 2) {
         debug_printf(CONFIG, WARNING,
@@ -92,6 +105,32 @@ int config_parse_args(config_t *cfg, int argc, char *argv[])
             }
             saw_dump_file = 1;
             i += 2;
+        } else if (!strcmp(argv[i], "--dump-format")) {
+            char *fmt, *comma;
+
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL,
+                        "--dump-format: expected text|json|bin[,ram]\n");
+                return 1;
+            }
+            fmt = argv[i + 1];
+            comma = strchr(fmt, ',');
+            cfg->dump_ram = comma && !strcmp(comma, ",ram");
+            if (cfg->dump_ram) {
+                *comma = '\0';
+            }
+            if (!strcmp(fmt, "text")) {
+                cfg->dump_format = DUMP_TEXT;
+            } else if (!strcmp(fmt, "json")) {
+                cfg->dump_format = DUMP_JSON;
+            } else if (!strcmp(fmt, "bin")) {
+                cfg->dump_format = DUMP_BIN;
+            } else {
+                debug_printf(CONFIG, FATAL,
+                        "--dump-format: unknown format \"%s\"\n", fmt);
+                return 1;
+            }
+            i += 2;
         } else if (!strcmp(argv[i], "--console") || !strcmp(argv[i], "-c")) {
             uint32_t addr;
             char *end;
@@ -108,6 +147,51 @@ int config_parse_args(config_t *cfg, int argc, char *argv[])
             }
             mem_map(cfg->mem, addr, serial_create(0, 1));
             i += 2;
+        } else if (!strcmp(argv[i], "--timer") || !strcmp(argv[i], "-t")) {
+            uint32_t addr;
+            long irq;
+            char *end;
+
+            if (argc - i < 3) {
+                debug_print(CONFIG, FATAL, "--timer: expected <addr> <irq>\n");
+                return 1;
+            }
+            addr = strtoul(argv[i + 1], &end, 16);
+            if (*end != '\0') {
+                debug_printf(CONFIG, FATAL,
+                        "--timer: invalid addr \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            irq = strtol(argv[i + 2], &end, 10);
+            if ((*end != '\0') || (irq < 0) || (irq >= CP0_NUM_IRQS)) {
+                debug_printf(CONFIG, FATAL,
+                        "--timer: invalid irq \"%s\"\n", argv[i + 2]);
+                return 1;
+            }
+            mem_map(cfg->mem, addr, timer_create(cfg->core, (int)irq));
+            i += 3;
+        } else if (!strcmp(argv[i], "--disk") || !strcmp(argv[i], "-b")) {
+            uint32_t addr;
+            mem_dev_t *disk;
+            char *end;
+
+            if (argc - i < 3) {
+                debug_print(CONFIG, FATAL,
+                        "--disk: expected <addr> <image>\n");
+                return 1;
+            }
+            addr = strtoul(argv[i + 1], &end, 16);
+            if (*end != '\0') {
+                debug_printf(CONFIG, FATAL,
+                        "--disk: invalid addr \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            disk = disk_create(cfg->mem, argv[i + 2]);
+            if (!disk) {
+                return 1;
+            }
+            mem_map(cfg->mem, addr, disk);
+            i += 3;
         } else if (!strcmp(argv[i], "--filter") || !strcmp(argv[i], "-f")) {
             if (argc - i < 2) {
                 debug_print(CONFIG, FATAL, "--filter: expected <filter>\n");
@@ -128,9 +212,240 @@ int config_parse_args(config_t *cfg, int argc, char *argv[])
                 return 1;
             }
             i += 1;
+        } else if (!strcmp(argv[i], "--host-syscalls") ||
+                   !strcmp(argv[i], "-H")) {
+            core_set_host_syscalls(cfg->core, 1);
+            i += 1;
+        } else if (!strcmp(argv[i], "--icache") ||
+                   !strcmp(argv[i], "--dcache")) {
+            int d = !strcmp(argv[i], "--dcache");
+            cache_t *cache;
+
+            if (argc - i < 2) {
+                debug_printf(CONFIG, FATAL, "%s: expected <spec>\n", argv[i]);
+                return 1;
+            }
+            cache = cache_create_spec(d ? "dcache" : "icache", argv[i + 1]);
+            if (!cache) {
+                return 1;
+            }
+            if (d) {
+                cfg->dcache = cache;
+            } else {
+                cfg->icache = cache;
+            }
+            uarch_set_caches(get_uarch(cfg), cfg->icache, cfg->dcache);
+            i += 2;
+        } else if (!strcmp(argv[i], "--dram")) {
+            dram_t *dram;
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--dram: expected <spec>\n");
+                return 1;
+            }
+            dram = dram_create_spec(argv[i + 1]);
+            if (!dram) {
+                return 1;
+            }
+            uarch_set_dram(get_uarch(cfg), dram);
+            i += 2;
+        } else if (!strcmp(argv[i], "--uarch") || !strcmp(argv[i], "-u")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--uarch: expected <model>\n");
+                return 1;
+            }
+            if (uarch_set_model(get_uarch(cfg), argv[i + 1])) {
+                debug_printf(CONFIG, FATAL,
+                        "--uarch: invalid model \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--bpred")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--bpred: expected <spec>\n");
+                return 1;
+            }
+            if (uarch_add_bpred(get_uarch(cfg), argv[i + 1])) {
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--sample")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--sample: expected <spec>\n");
+                return 1;
+            }
+            cfg->sample = sample_create_spec(argv[i + 1]);
+            if (!cfg->sample) {
+                return 1;
+            }
+            get_uarch(cfg);
+            i += 2;
+        } else if (!strcmp(argv[i], "--bbv")) {
+            char *end;
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--bbv: expected <interval>\n");
+                return 1;
+            }
+            cfg->bbv_interval = strtoul(argv[i + 1], &end, 0);
+            if ((end == argv[i + 1]) || *end || !cfg->bbv_interval) {
+                debug_printf(CONFIG, FATAL,
+                        "--bbv: invalid interval \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--bbv-file")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--bbv-file: expected <file>\n");
+                return 1;
+            }
+            cfg->bbv_file = argv[i + 1];
+            i += 2;
+        } else if (!strcmp(argv[i], "--profile")) {
+            char *end;
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--profile: expected <period>\n");
+                return 1;
+            }
+            cfg->profile_period = strtoul(argv[i + 1], &end, 0);
+            if ((end == argv[i + 1]) || *end || !cfg->profile_period) {
+                debug_printf(CONFIG, FATAL,
+                        "--profile: invalid period \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--profile-file")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL,
+                        "--profile-file: expected <file>\n");
+                return 1;
+            }
+            cfg->profile_file = argv[i + 1];
+            i += 2;
+        } else if (!strcmp(argv[i], "--symbols")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--symbols: expected <file>\n");
+                return 1;
+            }
+            cfg->syms = sym_load(argv[i + 1]);
+            if (!cfg->syms) {
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--stats") ||
+                   !strcmp(argv[i], "--stats=text")) {
+            cfg->stats = STATS_TEXT;
+            i += 1;
+        } else if (!strcmp(argv[i], "--stats=json")) {
+            cfg->stats = STATS_JSON;
+            i += 1;
+        } else if (!strcmp(argv[i], "--record") ||
+                   !strcmp(argv[i], "--replay")) {
+            int replay = !strcmp(argv[i], "--replay");
+
+            if (argc - i < 2) {
+                debug_printf(CONFIG, FATAL, "%s: expected <log>\n", argv[i]);
+                return 1;
+            }
+            if (saw_rr) {
+                debug_print(CONFIG, FATAL,
+                        "Only one --record or --replay is allowed\n");
+                return 1;
+            }
+            if (replay ? rr_replay(argv[i + 1], core_get_sched(cfg->core))
+                       : rr_record(argv[i + 1], core_get_sched(cfg->core))) {
+                return 1;
+            }
+            saw_rr = 1;
+            i += 2;
+        } else if (!strcmp(argv[i], "--reverse")) {
+            char *end;
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--reverse: expected <interval>\n");
+                return 1;
+            }
+            cfg->reverse_interval = strtoul(argv[i + 1], &end, 0);
+            if ((end == argv[i + 1]) || *end || !cfg->reverse_interval) {
+                debug_printf(CONFIG, FATAL,
+                        "--reverse: invalid interval \"%s\"\n", argv[i + 1]);
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--checkpoint-file")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL,
+                        "--checkpoint-file: expected <file>\n");
+                return 1;
+            }
+            cfg->checkpoint_file = argv[i + 1];
+            i += 2;
+        } else if (!strcmp(argv[i], "--restore")) {
+            char *colon, *end;
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL,
+                        "--restore: expected <file>[:<n>]\n");
+                return 1;
+            }
+            cfg->restore_file = argv[i + 1];
+            colon = strrchr(argv[i + 1], ':');
+            if (colon) {
+                cfg->restore_index = strtol(colon + 1, &end, 0);
+                if ((end == colon + 1) || *end || (cfg->restore_index < 0)) {
+                    debug_printf(CONFIG, FATAL,
+                            "--restore: invalid checkpoint \"%s\"\n",
+                            colon + 1);
+                    return 1;
+                }
+                *colon = '\0';
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--watch") ||
+                   !strcmp(argv[i], "--watch-log")) {
+            if (argc - i < 2) {
+                debug_printf(CONFIG, FATAL,
+                        "%s: expected <addr>[:<len>][:<rwx>]\n", argv[i]);
+                return 1;
+            }
+            if (add_watch(cfg, argv[i], argv[i + 1],
+                          strcmp(argv[i], "--watch") ? TRAP_LOG : 0)) {
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--gdb")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--gdb: expected <port|socket>\n");
+                return 1;
+            }
+            cfg->gdb = argv[i + 1];
+            i += 2;
         } else if (!strcmp(argv[i], "--step") || !strcmp(argv[i], "-s")) {
             cfg->step = 1;
             i += 1;
+        } else if (!strcmp(argv[i], "--step-changes")) {
+            cfg->step = 1;
+            cfg->step_changes = 1;
+            i += 1;
+        } else if (!strcmp(argv[i], "--trace")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--trace: expected <file>\n");
+                return 1;
+            }
+            if (cfg->trace_file && (cfg->trace_file != stdout)) {
+                fclose(cfg->trace_file);
+            }
+            cfg->trace_file = strcmp(argv[i + 1], "-")
+                    ? fopen(argv[i + 1], "w") : stdout;
+            if (!cfg->trace_file) {
+                debug_printf(CONFIG, FATAL,
+                        "%s: %s\n", argv[i + 1], strerror(errno));
+                return 1;
+            }
+            i += 2;
+        } else if (!strcmp(argv[i], "--cosim")) {
+            if (argc - i < 2) {
+                debug_print(CONFIG, FATAL, "--cosim: expected <trace>\n");
+                return 1;
+            }
+            cfg->cosim_file = argv[i + 1];
+            i += 2;
         } else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
             usage(argv[0]);
             return 1;
@@ -181,15 +496,161 @@ static void usage(char *progn)
         "        Dumps the final state of the machine's registers to the specified\n"
         "        file.  (If unspecified, the state is dumped to standard output.)\n"
         "\n"
+        "    --dump-format text|json|bin[,ram]\n"
+        "        Selects the format of the final dump: the usual text, a JSON\n"
+        "        object with a key per register, or binary.  With \",ram\", it\n"
+        "        also includes a hash of each RAM region.  Compare dumps with\n"
+        "        the dumpcmp tool (\"make dumpcmp\").\n"
+        "\n"
         "    --console|-c <addr>\n"
         "        Maps a serial console (connected to stdio) at the specified address.\n"
         "\n"
+        "    --timer|-t <addr> <irq>\n"
+        "        Maps an interval timer at the specified address, raising hardware\n"
+        "        interrupt <irq> (0-5, i.e. CAUSE bits IP2-IP7) when it fires.  Time\n"
+        "        is counted in retired instructions.\n"
+        "\n"
+        "    --disk|-b <addr> <image>\n"
+        "        Maps a block device backed by the specified disk image at the\n"
+        "        specified address.  Transfers are DMA'd directly to and from RAM.\n"
+        "\n"
         "    --filter|-f <filter>\n"
         "        Sets a filter to allow only instructions required for a certain lab.\n"
         "        Valid values of filter are: lab1, lab2, lab3\n"
         "\n"
+        "    --host-syscalls|-H\n"
+        "        Handles SPIM-style SYSCALL services (print/read, open/read/write/\n"
+        "        close on host files, exit, and 30 for the retired instruction count)\n"
+        "        in the simulator instead of raising a Syscall exception.\n"
+        "\n"
+        "    --icache <spec>\n"
+        "    --dcache <spec>\n"
+        "        Simulates an instruction or data cache and reports its hit and miss\n"
+        "        counts at halt.  <spec> is <size>:<line>:<assoc>[:<repl>[:<write>]]\n"
+        "        where sizes are in bytes (k and M suffixes allowed), <repl> is lru\n"
+        "        (default), plru or random, and <write> is wb (write-back with\n"
+        "        write-allocate, the default) or wt (write-through, no allocate).\n"
+        "        Accesses through kseg1 and to device registers bypass the caches.\n"
+        "\n"
+        "    --dram <channels>:<banks>:<policy>:<tRCD>:<tCAS>:<tRP>[:<row>]\n"
+        "        Models DRAM behind the RAM regions: cache misses (or every access,\n"
+        "        without caches) cost row-buffer dependent latencies in core\n"
+        "        cycles, and row hit rates and bandwidth are reported at halt.\n"
+        "        <policy> is open or closed; <row> is the row size in bytes\n"
+        "        (default 2k).  Channels, banks and row size are powers of two.\n"
+        "\n"
+        "    --uarch|-u <model>\n"
+        "        Runs a timing model alongside the functional simulation and reports\n"
+        "        cycle counts at halt.  Valid values of model are: pipeline5 (a\n"
+        "        classic five-stage pipeline with forwarding) and\n"
+        "        ooo[:<param>=<value>...] (a superscalar out-of-order core; params\n"
+        "        are width, rob, rs, alu, mem, mul, div, lat_alu, lat_load, lat_mul\n"
+        "        and lat_div, defaulting to 4, 128, 32, 4, 2, 1, 1, 1, 2, 4, 32).\n"
+        "        Cache misses cost extra cycles if --icache or --dcache is also\n"
+        "        given.  May be given more than once to run several models.\n"
+        "\n"
+        "    --bpred <type>[:<bits>][,...]\n"
+        "        Runs one or more branch predictors over every control transfer and\n"
+        "        reports their misprediction rates, overall and for the worst\n"
+        "        branches.  <type> is static (backward taken, forward not taken),\n"
+        "        bimodal, gshare or tournament; <bits> sizes the counter tables\n"
+        "        (default 12).  Each has a 512-entry BTB and a 16-entry return\n"
+        "        address stack.  May be given several times.\n"
+        "\n"
+        "    --bbv <interval>\n"
+        "        Writes a SimPoint basic-block vector for every <interval>\n"
+        "        instructions, to bb.out unless --bbv-file says otherwise.\n"
+        "\n"
+        "    --bbv-file <file>\n"
+        "        Sets the file written by --bbv.\n"
+        "\n"
+        "    --stats[=text|json]\n"
+        "        Reports retired instructions by class and opcode, exceptions, TLB\n"
+        "        refills, reads and writes per memory region, host time and\n"
+        "        simulated MIPS at halt, as text or as a JSON object.\n"
+        "\n"
+        "    --profile <period>\n"
+        "        Profiles the guest, sampling the PC every <period> instructions\n"
+        "        (1 counts exactly) and following calls and returns.  Prints a\n"
+        "        flat profile and the hottest PCs at halt, and writes the call\n"
+        "        tree as collapsed stacks for flame graph tools to\n"
+        "        profile.folded unless --profile-file says otherwise.\n"
+        "\n"
+        "    --profile-file <file>\n"
+        "        Sets the file written by --profile.\n"
+        "\n"
+        "    --symbols <file>\n"
+        "        Names functions in --profile output, from an ELF32 file's symbol\n"
+        "        table or a text map of \"<hex addr> ... <name>\" lines (nm output\n"
+        "        works).\n"
+        "\n"
+        "    --sample <period>:<warmup>:<window>\n"
+        "        Runs the caches, predictors and timing models only for the last\n"
+        "        <warmup> + <window> instructions of every <period>, measures each\n"
+        "        window, and reports CPI and miss rates with 95%% confidence\n"
+        "        intervals at halt.  Counts may use k and M suffixes.\n"
+        "\n"
+        "    --record <log>\n"
+        "        Logs every byte the guest reads from the console or through host\n"
+        "        syscalls, and the results of host file operations, with the\n"
+        "        instruction count at which each happened.\n"
+        "\n"
+        "    --replay <log>\n"
+        "        Reruns a recorded session, feeding the guest its logged input\n"
+        "        instead of reading stdin or host files, and warns if execution\n"
+        "        diverges from the recording.\n"
+        "\n"
+        "    --watch <addr>[:<len>][:<rwx>]\n"
+        "        Stops at the step prompt (see --step) just before an instruction\n"
+        "        reads (r), writes (w) or executes (x) any of the <len> bytes at\n"
+        "        <addr>, in hex.  <len> defaults to 4 and the access to w.  kseg0\n"
+        "        and kseg1 addresses are taken as the physical memory they map;\n"
+        "        others are physical, and must be mapped by an earlier option.\n"
+        "        Only accesses to the watched pages are slowed down.\n"
+        "\n"
+        "    --watch-log <addr>[:<len>][:<rwx>]\n"
+        "        As --watch, but only logs the accesses and carries on.\n"
+        "\n"
+        "    --gdb <port|socket>\n"
+        "        Waits for GDB to connect, on a local TCP port or a Unix socket,\n"
+        "        and runs under its control (\"target remote :<port>\").  With\n"
+        "        --reverse, GDB can also step and continue backwards.\n"
+        "\n"
         "    --step|-s\n"
-        "        Pause and dump registers after each instruction executes.\n"
+        "        Pause and dump registers after each instruction executes.  Press\n"
+        "        enter to step, or enter \"c\" to run on.  With --reverse, \"c\" runs\n"
+        "        until halted and stays at the prompt, \"rs [<n>]\" steps back,\n"
+        "        \"rc <addr>\" goes back to the last time the PC was <addr> and\n"
+        "        \"rw <reg>\" to the instruction that last changed register <reg>.\n"
+        "\n"
+        "    --step-changes\n"
+        "        As --step, but after the first full dump, shows only the PC and\n"
+        "        the registers and TLB entries that have changed since the last.\n"
+        "\n"
+        "    --trace <file>\n"
+        "        Writes a line to <file> (\"-\" for standard output) after every\n"
+        "        instruction, with the PC and the registers and TLB entries that\n"
+        "        changed, as --step-changes shows them.\n"
+        "\n"
+        "    --cosim <trace>\n"
+        "        Checks each instruction against a commit trace from an RTL\n"
+        "        simulation (\"-\" for standard input, e.g. from zcat), one line\n"
+        "        per instruction: \"<pc> [r<n>=<value>] [m<addr>=<data>]\", in hex\n"
+        "        but for the register number.  Stops at the first difference.\n"
+        "\n"
+        "    --reverse <interval>\n"
+        "        Checkpoints the machine every <interval> instructions so that\n"
+        "        execution can be stepped backwards, by restoring the nearest\n"
+        "        earlier checkpoint and replaying host input from there.\n"
+        "\n"
+        "    --checkpoint-file <file>\n"
+        "        With --reverse, also writes each checkpoint to <file>, storing\n"
+        "        only the RAM pages written since the one before.\n"
+        "\n"
+        "    --restore <file>[:<n>]\n"
+        "        Starts from checkpoint <n> (counting from 0; by default the last)\n"
+        "        in a file written by --checkpoint-file.  The machine must be\n"
+        "        configured with the same memory map and devices.\n"
         "\n"
         "    --help|-h\n"
         "        Shows this help screen.\n"
@@ -210,3 +671,61 @@ static int do_region(mem_t *mem, uint32_t base, uint32_t size, char *file)
     mem_map(mem, base, ram_create(size));
     return readmemh_load(mem, base, file);
 }
+
+static uarch_t *get_uarch(config_t *cfg)
+{
+    if (!cfg->uarch) {
+        cfg->uarch = uarch_create(cfg->mem);
+    }
+    return cfg->uarch;
+}
+
+/* Parses <addr>[:<len>][:<rwx>] and sets the trap. */
+static int add_watch(config_t *cfg, char *opt, char *spec, int kinds)
+{
+    uint32_t addr, len = 4;
+    int access = 0;
+    char *p, *end;
+
+    addr = strtoul(spec, &end, 16);
+    if (end == spec) {
+        goto invalid;
+    }
+    for (p = end; *p == ':'; p = end) {
+        if (strspn(p + 1, "rwx") && !p[1 + strspn(p + 1, "rwx")]) {
+            for (end = p + 1; *end; end++) {
+                access |= (*end == 'r') ? TRAP_READ :
+                          (*end == 'w') ? TRAP_WRITE : TRAP_EXEC;
+            }
+        } else {
+            len = strtoul(p + 1, &end, 16);
+            if ((end == p + 1) || !len) {
+                goto invalid;
+            }
+        }
+    }
+    if (*p) {
+        goto invalid;
+    }
+
+    /* kseg0 and kseg1 are unmapped windows onto the first 512MB. */
+    if (addr - 0x80000000 < 0x40000000) {
+        addr &= 0x1FFFFFFF;
+    }
+    if (!cfg->trap) {
+        cfg->trap = trap_create(cfg->mem);
+    }
+    if (!access) {
+        access = TRAP_WRITE;
+    }
+    if (trap_add(cfg->trap, addr, len, kinds | access)) {
+        debug_printf(CONFIG, FATAL, "%s: nothing mapped at %08x-%08x\n",
+                opt, addr, addr + len - 1);
+        return 1;
+    }
+    return 0;
+
+invalid:
+    debug_printf(CONFIG, FATAL, "%s: invalid watch \"%s\"\n", opt, spec);
+    return 1;
+}
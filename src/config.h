@@ -8,17 +8,47 @@
 #include "debug.h"
 #include "filter.h"
 #include "mem.h"
+#include "sample.h"
+#include "sym.h"
+#include "trap.h"
+#include "uarch.h"
 
 typedef struct config config_t;
 
+enum {
+    STATS_TEXT = 1,
+    STATS_JSON
+};
+
 struct config {
     core_t *core;
     mem_t *mem;
     uint32_t pc;
     FILE *dump_file;
+    int dump_format;        /* DUMP_TEXT, DUMP_JSON or DUMP_BIN. */
+    int dump_ram;
     filter_t *filter;
+    uarch_t *uarch;
+    cache_t *icache;
+    cache_t *dcache;
+    sample_t *sample;
+    uint64_t bbv_interval;
+    char *bbv_file;
+    uint64_t profile_period;
+    char *profile_file;
+    symtab_t *syms;
+    int stats;              /* 0 for none, else STATS_TEXT or STATS_JSON. */
+    uint64_t reverse_interval;
+    char *checkpoint_file;
+    char *restore_file;
+    long restore_index;     /* -1 for the last checkpoint in the file. */
+    trap_t *trap;           /* For --watch and --gdb. */
+    char *gdb;
     debug_level_t debug;
     int step;
+    int step_changes;
+    FILE *trace_file;
+    char *cosim_file;
 };
 
 int config_parse_args(config_t *cfg, int argc, char *argv[]);
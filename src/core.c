@@ -6,29 +6,36 @@
 #include "core.h"
 #include "core_priv.h"
 #include "core_cp0.h"
+#include "core_sys.h"
 #include "debug.h"
 #include "err.h"
 #include "exc.h"
 #include "filter.h"
 #include "opcode.h"
+#include "trap.h"
 #include "util.h"
 
-#define NUM_REGS 32
-
-struct core {
-    mem_t *mem;
-    filter_t *filter;
+/* Everything core_save copies, i.e. all state that execution changes. */
+struct core_state {
     uint32_t r[NUM_REGS];
     uint32_t hi;
     uint32_t lo;
     uint32_t pc;
-
     core_cp0_t cp0;
-
+    uint64_t now;
+    core_stats_t stats;
     int exc_count;
+    uint64_t nstores;
+    struct idle idle;
+    int exit_status;
+    int32_t sys_fds[NUM_SYS_FDS];
 };
 
 static int __core_step(core_t *c);
+static int service_events(core_t *c);
+static int check_idle(core_t *c);
+static void save_idle(core_t *c);
+static int same_idle(core_t *c);
 
 static int add_overflows(uint32_t a, uint32_t b);
 static int sub_overflows(uint32_t a, uint32_t b);
@@ -38,6 +45,7 @@ static int except(core_t *c, uint8_t exc_code);
 static int except_vm(core_t *c, uint8_t exc_code, uint32_t badvaddr);
 static int user_mode(core_t *c);
 static int translate(core_t *c, uint32_t va, uint32_t *pa_out, int write);
+static int probe(core_t *c, uint32_t va, uint32_t *pa_out);
 
 static int rdb(core_t *c, uint32_t addr, uint8_t *out);
 static int rdh(core_t *c, uint32_t addr, uint16_t *out);
@@ -46,14 +54,26 @@ static int rdiw(core_t *c, uint32_t addr, uint32_t *out);
 static int wrb(core_t *c, uint32_t addr, uint8_t in);
 static int wrh(core_t *c, uint32_t addr, uint16_t in);
 static int wrw(core_t *c, uint32_t addr, uint32_t in);
-static int _rdw(core_t *c, uint32_t va, uint32_t *out, int ins);
+static int _rdw(core_t *c, uint32_t va, uint32_t *out, uint8_t re, int ins);
 static int _wrw(core_t *c, uint32_t va, uint32_t in, uint8_t we);
+static int trapped(core_t *c, uint32_t va, uint32_t pa, uint8_t mask,
+                   int kind, uint32_t val);
 
 core_t *core_create(mem_t *m)
 {
     core_t *c = xmalloc(sizeof(*c));
     c->mem = m;
     c->filter = NULL;
+    c->uarch = NULL;
+    c->bbv = NULL;
+    c->prof = NULL;
+    c->trap = NULL;
+    c->skipping = 0;
+    c->watch_kinds = 0;
+    c->host_syscalls = 0;
+    c->idle_skip = 1;
+    memset(&c->stats, 0, sizeof(c->stats));
+    sched_init(&c->sched);
     return c;
 }
 
@@ -63,6 +83,10 @@ void core_reset(core_t *c)
     c->hi = c->lo = c->pc = 0;
     core_cp0_reset(c, &c->cp0);
     c->exc_count = 0;
+    c->nstores = 0;
+    c->idle.branches = 0;
+    c->exit_status = 0;
+    core_sys_reset(c);
 }
 
 void core_destroy(core_t *c)
@@ -80,11 +104,234 @@ void core_set_pc(core_t *c, uint32_t pc)
     c->pc = pc;
 }
 
+/* reg is a GPR number or one of the CORE_REG_* extras. */
+uint32_t core_get_reg(core_t *c, int reg)
+{
+    uint32_t val;
+
+    switch (reg) {
+    case CORE_REG_HI:
+        return c->hi;
+    case CORE_REG_LO:
+        return c->lo;
+    case CORE_REG_PC:
+        return c->pc;
+    default:
+        if (reg >= CORE_REG_CP0(0)) {
+            core_cp0_move_from(c, &c->cp0, reg - CORE_REG_CP0(0), &val);
+            return val;
+        }
+        assert(reg >= 0 && reg < NUM_REGS);
+        return c->r[reg];
+    }
+}
+
+void core_set_reg(core_t *c, int reg, uint32_t val)
+{
+    switch (reg) {
+    case CORE_REG_HI:
+        c->hi = val;
+        break;
+    case CORE_REG_LO:
+        c->lo = val;
+        break;
+    case CORE_REG_PC:
+        c->pc = val;
+        break;
+    default:
+        if (reg >= CORE_REG_CP0(0)) {
+            core_cp0_move_to(c, &c->cp0, reg - CORE_REG_CP0(0), val);
+            sched_kick(&c->sched);
+        } else if (reg > 0) {
+            assert(reg < NUM_REGS);
+            c->r[reg] = val;
+        }
+        break;
+    }
+}
+
 void core_set_filter(core_t *c, filter_t *f)
 {
     c->filter = f;
 }
 
+void core_set_uarch(core_t *c, uarch_t *u)
+{
+    c->uarch = u;
+}
+
+void core_set_bbv(core_t *c, bbv_t *b)
+{
+    c->bbv = b;
+}
+
+void core_set_profile(core_t *c, profile_t *p)
+{
+    c->prof = p;
+}
+
+void core_set_trap(core_t *c, trap_t *t)
+{
+    c->trap = t;
+}
+
+trap_t *core_get_trap(core_t *c)
+{
+    return c->trap;
+}
+
+/* Lets the next instruction run without its own traps going off again. */
+void core_skip_traps(core_t *c)
+{
+    c->skipping = 1;
+    c->skip_pc = c->pc;
+    c->skip_now = c->sched.now;
+}
+
+/* After an ERR_WATCH: returns the watchpoint's kinds and the address. */
+int core_get_watch(core_t *c, uint32_t *va_out)
+{
+    *va_out = c->watch_va;
+    return c->watch_kinds;
+}
+
+const core_stats_t *core_get_stats(core_t *c)
+{
+    return &c->stats;
+}
+
+sched_t *core_get_sched(core_t *c)
+{
+    return &c->sched;
+}
+
+void core_set_irq(core_t *c, int irq, int level)
+{
+    core_cp0_set_irq(c, &c->cp0, irq, level);
+    sched_kick(&c->sched);
+}
+
+void core_set_host_syscalls(core_t *c, int enable)
+{
+    c->host_syscalls = enable;
+}
+
+/*
+ Idle loop skipping (see check_idle) is on by default; turning it off makes
+ the core run idle loops an instruction at a time, as hardware does.
+ */
+void core_set_idle_skip(core_t *c, int enable)
+{
+    c->idle_skip = enable;
+}
+
+int core_get_exit_status(core_t *c)
+{
+    return c->exit_status;
+}
+
+size_t core_state_size(void)
+{
+    return sizeof(struct core_state);
+}
+
+void core_save(core_t *c, void *buf)
+{
+    struct core_state *st = buf;
+
+    memcpy(st->r, c->r, sizeof(st->r));
+    st->hi = c->hi;
+    st->lo = c->lo;
+    st->pc = c->pc;
+    st->cp0 = c->cp0;
+    st->now = c->sched.now;
+    st->stats = c->stats;
+    st->exc_count = c->exc_count;
+    st->nstores = c->nstores;
+    st->idle = c->idle;
+    st->exit_status = c->exit_status;
+    memcpy(st->sys_fds, c->sys_fds, sizeof(st->sys_fds));
+}
+
+/*
+ Devices put their own events back on the scheduler when they are restored;
+ the kick makes the next core_step look at them (and at any interrupt the
+ restored CAUSE has pending).
+ */
+void core_restore(core_t *c, const void *buf)
+{
+    const struct core_state *st = buf;
+
+    memcpy(c->r, st->r, sizeof(c->r));
+    c->hi = st->hi;
+    c->lo = st->lo;
+    c->pc = st->pc;
+    c->cp0 = st->cp0;
+    c->sched.now = st->now;
+    c->stats = st->stats;
+    c->exc_count = st->exc_count;
+    c->nstores = st->nstores;
+    c->idle = st->idle;
+    c->exit_status = st->exit_status;
+    memcpy(c->sys_fds, st->sys_fds, sizeof(c->sys_fds));
+    sched_kick(&c->sched);
+}
+
+/*
+ Returns a host pointer to len bytes of guest memory at virtual address va,
+ as seen by the program currently running, or NULL if it isn't mapped to
+ RAM.  The range may not cross a page boundary.  Never takes an exception.
+ */
+void *core_map_virt(core_t *c, uint32_t va, uint32_t len, int write)
+{
+    uint32_t pa;
+
+    assert(len <= 0x1000 - (va & 0xFFF));
+
+    if (probe(c, va, &pa)) {
+        return NULL;
+    }
+    if (write) {
+        c->nstores++;
+    }
+    return mem_map_host(c->mem, pa, len, write);
+}
+
+/* Translates va as the running program would, without taking exceptions. */
+int core_virt_to_phys(core_t *c, uint32_t va, uint32_t *pa_out)
+{
+    return probe(c, va, pa_out);
+}
+
+/*
+ Word accesses to virtual memory for debuggers, which neither take
+ exceptions nor set off traps.  Only RAM is reachable this way: device
+ registers can have side effects on access (a serial read consumes input),
+ so they are left alone.  Return nonzero if va isn't mapped to RAM.
+ */
+int core_read_virt(core_t *c, uint32_t va, uint32_t *val_out)
+{
+    uint32_t *p = core_map_virt(c, va & ~0x3, 4, 0);
+
+    if (!p) {
+        return 1;
+    }
+    *val_out = *p;
+    return 0;
+}
+
+int core_write_virt(core_t *c, uint32_t va, uint32_t val, uint8_t we)
+{
+    uint32_t *p = core_map_virt(c, va & ~0x3, 4, 1);
+    uint32_t mask = we_to_mask(we);
+
+    if (!p) {
+        return 1;
+    }
+    *p = (*p & ~mask) | (val & mask);
+    return 0;
+}
+
 #define SE8(b) ((uint32_t)((int32_t)((int8_t)(b))))
 #define SE16(hw) ((uint32_t)((int32_t)((int16_t)(hw))))
 #define SIMMED(ins) ((int32_t)((int16_t)IMMED(ins)))
@@ -99,11 +346,54 @@ void core_set_filter(core_t *c, filter_t *f)
 
 #define MAX_EXCS 10
 
+/* Architecturally uncached; only reachable in kernel mode. */
+#define KSEG1(va) (((va) & 0xE0000000) == 0xA0000000)
+
 int core_step(core_t *c)
 {
+    uint32_t pc = c->pc;
     int ret;
 
-    ret = __core_step(c);
+    c->rec.flags = 0;
+    c->rec.ins = 0;
+
+    if (c->sched.now >= c->sched.next) {
+        ret = service_events(c);
+    } else {
+        ret = 0;
+    }
+    if (!ret) {
+        ret = __core_step(c);
+        if (!ret) {
+            c->stats.ins[STATS_INDEX(c->rec.ins)]++;
+            c->sched.now++;
+            if ((c->pc <= pc) && c->idle_skip) {
+                ret = check_idle(c);
+            }
+        }
+    }
+    if (c->bbv && (ret <= 0)) {
+        if (ret == EXCEPTED) {
+            bbv_except(c->bbv);
+        } else {
+            bbv_step(c->bbv, pc, c->rec.ins, c->pc);
+        }
+    }
+    if (c->prof && (ret <= 0)) {
+        if (ret == EXCEPTED) {
+            profile_except(c->prof, c->pc);
+        } else {
+            profile_step(c->prof, pc, c->rec.ins, c->pc);
+        }
+    }
+    if (c->uarch && (ret <= 0)) {
+        c->rec.pc = pc;
+        c->rec.next_pc = c->pc;
+        if (ret == EXCEPTED) {
+            c->rec.flags |= UARCH_EXC;
+        }
+        uarch_commit(c->uarch, &c->rec);
+    }
     if (ret == EXCEPTED) {
         ret = 0;
         c->exc_count++;
@@ -116,6 +406,92 @@ int core_step(core_t *c)
     return ret;
 }
 
+/*
+ Interrupts are only checked here, when an event is due or something has
+ kicked the scheduler (an IRQ line changing, or a write to STATUS or CAUSE),
+ so the common path through core_step costs a single comparison.
+ */
+static int service_events(core_t *c)
+{
+    sched_run(&c->sched);
+
+    if (core_cp0_irq_pending(c, &c->cp0)) {
+        return except(c, EXC_INT);
+    }
+
+    return 0;
+}
+
+/*
+ A loop is idle if one iteration leaves the architectural state exactly as it
+ found it without storing to memory: it will then do the same thing forever,
+ until a scheduled event (e.g. a timer interrupt) changes something.  That
+ covers "j ." as well as polling an unchanged device register.  Comparing
+ state on every backward branch would be far too slow, so we sample a pair of
+ consecutive backward branches every IDLE_CHECK_INTERVAL.
+
+ When an idle loop is found we skip straight to the next event, or halt if
+ there isn't one.  Skipping lands at the loop head rather than wherever the
+ loop would have been, so the retired count can be off by up to one
+ iteration.
+ */
+#define IDLE_CHECK_INTERVAL 4096
+
+static int check_idle(core_t *c)
+{
+    unsigned n = c->idle.branches++ % IDLE_CHECK_INTERVAL;
+    sched_event_t *ev;
+    uint64_t skip;
+
+    if (n == 0) {
+        save_idle(c);
+        return 0;
+    } else if ((n != 1) || !same_idle(c)) {
+        return 0;
+    }
+
+    /* Observers (e.g. the sampler) can't end the loop; don't wait on them. */
+    for (ev = c->sched.events; ev && ev->observer; ev = ev->next)
+        ;
+    if (ev == NULL) {
+        debug_printf(CORE, INFO, "Idle loop at %08x\n", c->pc);
+        return ERR_IDLE;
+    }
+
+    skip = ev->when - c->sched.now;
+    debug_printf(CORE, DETAIL,
+            "Idle loop at %08x, skipping %lu instructions\n",
+            c->pc, (unsigned long)skip);
+    core_cp0_skip(c, &c->cp0, skip);
+    c->sched.now += skip;
+    return 0;
+}
+
+static void save_idle(core_t *c)
+{
+    c->idle.pc = c->pc;
+    memcpy(c->idle.r, c->r, sizeof(c->r));
+    c->idle.hi = c->hi;
+    c->idle.lo = c->lo;
+    c->idle.cp0 = c->cp0;
+    c->idle.nstores = c->nstores;
+}
+
+static int same_idle(core_t *c)
+{
+    core_cp0_t cp0 = c->cp0;
+
+    /* RANDOM ticks every step regardless of what the loop does. */
+    cp0.r[CP0_RANDOM] = c->idle.cp0.r[CP0_RANDOM];
+
+    return (c->idle.pc == c->pc) &&
+           (c->idle.nstores == c->nstores) &&
+           (c->idle.hi == c->hi) &&
+           (c->idle.lo == c->lo) &&
+           !memcmp(c->idle.r, c->r, sizeof(c->r)) &&
+           !memcmp(&c->idle.cp0, &cp0, sizeof(cp0));
+}
+
 int __core_step(core_t *c)
 {
     uint32_t ins;
@@ -128,6 +504,7 @@ int __core_step(core_t *c)
 
     ret = rdiw(c, c->pc, &ins);
     if (ret) { return ret; }
+    c->rec.ins = ins;
 
     if (c->filter) {
         if (!filter_ins_allowed(c->filter, ins)) {
@@ -189,6 +566,13 @@ int __core_step(core_t *c)
             c->r[RD(ins)] = c->pc + 4;
             break;
         case FUNCT_SYSCALL:
+            if (c->host_syscalls) {
+                ret = core_sys_call(c);
+                if (ret != SYS_UNHANDLED) {
+                    if (ret) return ret;
+                    break;
+                }
+            }
             return except(c, EXC_SYS);
         case FUNCT_TESTDONE:
             if (user_mode(c)) { return except(c, EXC_RI); }
@@ -296,7 +680,9 @@ int __core_step(core_t *c)
             }
             break;
         case FUNCT_DIVU:
-            if ((RD(ins) != 0) || (SA(ins) != 0)) { return EXC_RI; }
+            if ((RD(ins) != 0) || (SA(ins) != 0)) {
+                return except(c, EXC_RI);
+            }
             if (c->r[RT(ins)] != 0) {
                 c->lo = c->r[RS(ins)] / c->r[RT(ins)];
                 c->hi = c->r[RS(ins)] % c->r[RT(ins)];
@@ -404,7 +790,7 @@ int __core_step(core_t *c)
         c->r[RT(ins)] = c->r[RS(ins)] ^ IMMED(ins);
         break;
     case OP_LUI:
-        if (RS(ins) != 0) return EXC_RI;
+        if (RS(ins) != 0) { return except(c, EXC_RI); }
         c->r[RT(ins)] = IMMED(ins) << 16;
         break;
     case OP_LB:
@@ -458,6 +844,7 @@ int __core_step(core_t *c)
             if (user_mode(c)) { return except(c, EXC_RI); }
             ret = core_cp0_move_to(c, &c->cp0, RD(ins), c->r[RT(ins)]);
             if (ret) return ret;
+            sched_kick(&c->sched);
             break;
         case 020:
             if ((RT(ins) != 0) || (RD(ins) != 0) || (SA(ins) != 0)) {
@@ -476,6 +863,7 @@ int __core_step(core_t *c)
                 if (user_mode(c)) { return except(c, EXC_RI); }
                 ret = core_cp0_eret(c, &c->cp0, &newpc);
                 if (ret) return ret;
+                sched_kick(&c->sched);
                 break;
             default:
                 debug_printf(CORE, DETAIL, "Unimplemented CP0 funct %03o\n",
@@ -515,6 +903,63 @@ void core_dump_regs(core_t *c, FILE *out)
     core_cp0_dump_regs(c, &c->cp0, out);
 }
 
+/* The state a core_dump_changes caller last saw. */
+struct core_dump {
+    int valid;
+    uint32_t r[NUM_REGS];
+    uint32_t hi;
+    uint32_t lo;
+    core_cp0_t cp0;
+};
+
+core_dump_t *core_dump_create(void)
+{
+    core_dump_t *d = xmalloc(sizeof(*d));
+    d->valid = 0;
+    return d;
+}
+
+void core_dump_destroy(core_dump_t *d)
+{
+    free(d);
+}
+
+/*
+ Prints, on one line, the PC and whatever else has changed since the last
+ call with d; the first call prints everything, as core_dump_regs does.
+ */
+void core_dump_changes(core_t *c, core_dump_t *d, FILE *out)
+{
+    char line[2048], *p = line;
+    int i;
+
+    if (!d->valid) {
+        core_dump_regs(c, out);
+    } else {
+        p += sprintf(p, "PC =%08x", c->pc);
+        if (c->hi != d->hi) {
+            p += sprintf(p, "  HI =%08x", c->hi);
+        }
+        if (c->lo != d->lo) {
+            p += sprintf(p, "  LO =%08x", c->lo);
+        }
+        for (i = 1; i < NUM_REGS; i++) {
+            if (c->r[i] != d->r[i]) {
+                p += sprintf(p, "  R%-2d=%08x", i, c->r[i]);
+            }
+        }
+        p = core_cp0_dump_changes(c, &c->cp0, &d->cp0, p);
+        strcpy(p, "\n");
+        fputs(line, out);
+    }
+
+    d->valid = 1;
+    memcpy(d->r, c->r, sizeof(d->r));
+    d->hi = c->hi;
+    d->lo = c->lo;
+    d->cp0 = c->cp0;
+}
+
 static int add_overflows(uint32_t a, uint32_t b)
 {
     uint32_t c = a + b;
@@ -574,6 +1019,18 @@ static int translate(core_t *c, uint32_t va, uint32_t *pa_out, int write)
     }
 }
 
+static int probe(core_t *c, uint32_t va, uint32_t *pa_out)
+{
+    if ((!c->filter) || filter_misc(c->filter, FILTER_MISC_VM)) {
+        return core_cp0_probe(c, &c->cp0, va, pa_out);
+    } else if (user_mode(c) && (va & 0x80000000)) {
+        return 1;
+    } else {
+        *pa_out = va;
+        return 0;
+    }
+}
+
 /*
  Note: The virtual address passed to _rdw or _wrw is the address of the actual
        byte, halfword, or word being read, in case a TLB exception is thrown.
@@ -586,7 +1043,7 @@ static int rdb(core_t *c, uint32_t addr, uint8_t *out)
     uint32_t w;
     int ret;
 
-    ret = _rdw(c, addr, &w, 0);
+    ret = _rdw(c, addr, &w, 0x1 << (addr & 0x3), 0);
     if (ret) { return ret; }
 
     *out = (uint8_t)(w >> (8 * (addr & 0x3)));
@@ -600,7 +1057,7 @@ static int rdh(core_t *c, uint32_t addr, uint16_t *out)
 
     if (addr & 0x1) { return except_vm(c, EXC_ADEL, addr); }
 
-    ret = _rdw(c, addr, &w, 0);
+    ret = _rdw(c, addr, &w, 0x3 << (addr & 0x3), 0);
     if (ret) { return ret; }
 
     *out = (uint16_t)(w >> (8 * (addr & 0x3)));
@@ -610,13 +1067,13 @@ static int rdh(core_t *c, uint32_t addr, uint16_t *out)
 static int rdw(core_t *c, uint32_t addr, uint32_t *out)
 {
     if (addr & 0x3) { return except_vm(c, EXC_ADEL, addr); }
-    return _rdw(c, addr, out, 0);
+    return _rdw(c, addr, out, 0xf, 0);
 }
 
 static int rdiw(core_t *c, uint32_t addr, uint32_t *out)
 {
     if (addr & 0x3) { return except_vm(c, EXC_ADEL, addr); }
-    return _rdw(c, addr, out, 1);
+    return _rdw(c, addr, out, 0xf, 1);
 }
 
 static int wrb(core_t *c, uint32_t addr, uint8_t in)
@@ -638,7 +1095,7 @@ static int wrw(core_t *c, uint32_t addr, uint32_t in)
     return _wrw(c, addr, in, 0xf);
 }
 
-static int _rdw(core_t *c, uint32_t va, uint32_t *out, int ins)
+static int _rdw(core_t *c, uint32_t va, uint32_t *out, uint8_t re, int ins)
 {
     uint32_t pa;
     int ret;
@@ -647,8 +1104,21 @@ static int _rdw(core_t *c, uint32_t va, uint32_t *out, int ins)
     if (ret) { return ret; }
 
     ret = mem_read(c->mem, pa & ~0x3, out);
+    if (ret == MEM_TRAP) {
+        ret = trapped(c, va, pa, re, ins ? TRAP_EXEC : TRAP_READ, 0);
+        if (ret) { return ret; }
+        ret = mem_read_untrapped(c->mem, pa & ~0x3, out);
+    }
     if (ret) { return except(c, ins ? EXC_IBE : EXC_DBE); }
 
+    if (ins) {
+        c->rec.ipa = pa;
+        c->rec.flags |= UARCH_FETCH | (KSEG1(va) ? UARCH_IUNCACHED : 0);
+    } else {
+        c->rec.maddr = pa;
+        c->rec.flags |= UARCH_LOAD | (KSEG1(va) ? UARCH_DUNCACHED : 0);
+    }
+
     return 0;
 }
 
@@ -661,9 +1131,65 @@ static int _wrw(core_t *c, uint32_t va, uint32_t in, uint8_t we)
     if (ret) { return ret; }
 
     ret = mem_write(c->mem, pa & ~0x03, in, we);
+    if (ret == MEM_TRAP) {
+        ret = trapped(c, va, pa, we, TRAP_WRITE, in);
+        if (ret) { return ret; }
+        ret = mem_write_untrapped(c->mem, pa & ~0x03, in, we);
+    }
     if (ret) { return except(c, EXC_DBE); }
+    c->nstores++;
+
+    c->rec.maddr = pa;
+    c->rec.flags |= UARCH_STORE | (KSEG1(va) ? UARCH_DUNCACHED : 0);
 
     return 0;
 }
 
+/*
+ Called for accesses to pages with traps set, before the access is made.
+ Returns ERR_BREAK or ERR_WATCH to stop before the instruction executes, or
+ 0 to go ahead.  Traps are off while rev re-executes history (with the trap
+ list unset) and for the instruction core_skip_traps lets past.
+ */
+static int trapped(core_t *c, uint32_t va, uint32_t pa, uint8_t mask,
+                   int kind, uint32_t val)
+{
+    unsigned off = 0, len = 0;
+    int kinds;
+
+    if (!c->trap || (c->skipping && (c->pc == c->skip_pc) &&
+                     (c->sched.now == c->skip_now))) {
+        return 0;
+    }
+    while (!(mask & (1 << off))) {
+        off++;
+    }
+    while ((off + len < 4) && (mask & (1 << (off + len)))) {
+        len++;
+    }
 
+    kinds = trap_match(c->trap, (pa & ~0x3) + off, len, kind);
+    if (!kinds) {
+        return 0;
+    }
+
+    if (kind == TRAP_EXEC) {
+        debug_printf(TRAP, INFO, "Watch: executing %08x\n", va);
+    } else if (kind == TRAP_WRITE) {
+        debug_printf(TRAP, INFO, "Watch: %08x writes %0*lx to %08x\n",
+                c->pc, (int)(2 * len),
+                (unsigned long)(val >> (8 * off)) &
+                (0xFFFFFFFFUL >> (32 - 8 * len)), va);
+    } else {
+        debug_printf(TRAP, INFO, "Watch: %08x reads %u bytes at %08x\n",
+                c->pc, len, va);
+    }
+    if (kinds & TRAP_LOG) {
+        return 0;
+    } else if (kind == TRAP_EXEC) {
+        return ERR_BREAK;
+    }
+    c->watch_va = va;
+    c->watch_kinds = kinds;
+    return ERR_WATCH;
+}
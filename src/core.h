@@ -1,22 +1,63 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "bbv.h"
 #include "filter.h"
 #include "mem.h"
+#include "profile.h"
+#include "sched.h"
+#include "stats.h"
+#include "trap.h"
+#include "uarch.h"
 
 typedef struct core core_t;
+typedef struct core_dump core_dump_t;
+
+/* Register numbers for core_get_reg and core_set_reg, beyond the GPRs. */
+enum {
+    CORE_REG_HI = 32,
+    CORE_REG_LO,
+    CORE_REG_PC
+};
+#define CORE_REG_CP0(n) (64 + (n))
 
 core_t *core_create(mem_t *m);
 void core_reset(core_t *c);
 void core_destroy(core_t *c);
 uint32_t core_get_pc(core_t *c);
 void core_set_pc(core_t *c, uint32_t pc);
+uint32_t core_get_reg(core_t *c, int reg);
+void core_set_reg(core_t *c, int reg, uint32_t val);
 void core_set_filter(core_t *c, filter_t *f);
+void core_set_uarch(core_t *c, uarch_t *u);
+void core_set_bbv(core_t *c, bbv_t *b);
+void core_set_profile(core_t *c, profile_t *p);
+void core_set_trap(core_t *c, trap_t *t);
+trap_t *core_get_trap(core_t *c);
+void core_skip_traps(core_t *c);
+int core_get_watch(core_t *c, uint32_t *va_out);
+const core_stats_t *core_get_stats(core_t *c);
+sched_t *core_get_sched(core_t *c);
+void core_set_irq(core_t *c, int irq, int level);
+void core_set_host_syscalls(core_t *c, int enable);
+void core_set_idle_skip(core_t *c, int enable);
+int core_get_exit_status(core_t *c);
+size_t core_state_size(void);
+void core_save(core_t *c, void *buf);
+void core_restore(core_t *c, const void *buf);
+void *core_map_virt(core_t *c, uint32_t va, uint32_t len, int write);
+int core_virt_to_phys(core_t *c, uint32_t va, uint32_t *pa_out);
+int core_read_virt(core_t *c, uint32_t va, uint32_t *val_out);
+int core_write_virt(core_t *c, uint32_t va, uint32_t val, uint8_t we);
 int core_step(core_t *c);
 
 void core_dump_regs(core_t *c, FILE *f);
+core_dump_t *core_dump_create(void);
+void core_dump_destroy(core_dump_t *d);
+void core_dump_changes(core_t *c, core_dump_t *d, FILE *f);
 
 #endif
@@ -63,6 +63,11 @@ int core_cp0_step(core_t *c, core_cp0_t *cp0)
     return 0;
 }
 
+void core_cp0_skip(core_t *c, core_cp0_t *cp0, uint64_t steps)
+{
+    cp0->r[CP0_RANDOM] = (cp0->r[CP0_RANDOM] + steps) % 16;
+}
+
 int core_cp0_move_from(core_t *c, core_cp0_t *cp0, uint8_t reg,
                        uint32_t *val_out)
 {
@@ -95,9 +100,10 @@ int core_cp0_except(core_t *c, core_cp0_t *cp0, uint8_t exc_code)
         break;
     }
 
+    c->stats.excs[exc_code]++;
     epc = core_get_pc(c);
     cp0->r[CP0_EPC] = epc;
-    cp0->r[CP0_CAUSE] = exc_code << 2;
+    cp0->r[CP0_CAUSE] = (cp0->r[CP0_CAUSE] & CAUSE_IP) | (exc_code << 2);
     cp0->r[CP0_STATUS] |= STATUS_EXL;
     debug_printf(EXC, DETAIL,
             "Took exception: epc=%08x exc_code=%d (%s)\n",
@@ -123,6 +129,25 @@ int core_cp0_user_mode(core_t *c, core_cp0_t *cp0)
     return get_mode(c, cp0) == U_MODE;
 }
 
+void core_cp0_set_irq(core_t *c, core_cp0_t *cp0, int irq, int level)
+{
+    assert(irq >= 0 && irq < CP0_NUM_IRQS);
+
+    if (level) {
+        cp0->r[CP0_CAUSE] |= CAUSE_IP_HW(irq);
+    } else {
+        cp0->r[CP0_CAUSE] &= ~CAUSE_IP_HW(irq);
+    }
+}
+
+int core_cp0_irq_pending(core_t *c, core_cp0_t *cp0)
+{
+    uint32_t status = cp0->r[CP0_STATUS];
+
+    return (status & STATUS_IE) && !(status & STATUS_EXL) &&
+           (status & cp0->r[CP0_CAUSE] & CAUSE_IP);
+}
+
 
 
 int core_cp0_tlbwr(core_t *c, core_cp0_t *cp0)
@@ -173,6 +198,7 @@ int core_cp0_translate(core_t *c, core_cp0_t *cp0, uint32_t va,
         debug_printf(VM, DETAIL,
                 "translate: %08x => TLB refill (segment=%s)\n",
                 va, seg->name);
+        c->stats.tlb_refills++;
         return core_cp0_except(c, cp0, write ? EXC_TLBL : EXC_TLBS);
     }
 
@@ -186,6 +212,30 @@ out:
     return 0;
 }
 
+/* Like core_cp0_translate, but fails quietly instead of taking exceptions. */
+int core_cp0_probe(core_t *c, core_cp0_t *cp0, uint32_t va, uint32_t *pa_out)
+{
+    struct segment *seg;
+    uint32_t tlb_data;
+
+    seg = find_seg(va, get_mode(c, cp0));
+    if (!seg) {
+        return 1;
+    }
+
+    if (seg->flags & UNMAPPED) {
+        *pa_out = va - seg->base;
+        return 0;
+    }
+
+    if (tlb_search(c, cp0, va & PAGE_MASK, &tlb_data)) {
+        return 1;
+    }
+
+    *pa_out = (tlb_data & PAGE_MASK) | (va & OFF_MASK);
+    return 0;
+}
+
 void core_cp0_dump_regs(core_t *c, core_cp0_t *cp0, FILE *out)
 {
     unsigned i;
@@ -208,6 +258,46 @@ void core_cp0_dump_regs(core_t *c, core_cp0_t *cp0, FILE *out)
     }
 }
 
+/*
+ Appends to p, in the same form as core_cp0_dump_regs, the registers and TLB
+ entries that differ from last; returns the new end of the string.  RANDOM
+ changes on every instruction, so is left out.
+ */
+char *core_cp0_dump_changes(core_t *c, core_cp0_t *cp0, core_cp0_t *last,
+                            char *p)
+{
+    static const struct {
+        int reg;
+        const char *name;
+    } regs[] = {
+        { CP0_STATUS, "STATUS" },
+        { CP0_EPC, "EPC" },
+        { CP0_CAUSE, "CAUSE" },
+        { CP0_BADVADDR, "BADVADDR" },
+        { CP0_INDEX, "INDEX" },
+        { CP0_ENTRYHI, "ENTRYHI" },
+        { CP0_ENTRYLO, "ENTRYLO" }
+    };
+    unsigned i;
+
+    for (i = 0; i < sizeof(regs) / sizeof(regs[0]); i++) {
+        if (cp0->r[regs[i].reg] != last->r[regs[i].reg]) {
+            p += sprintf(p, "  %s=%08x", regs[i].name, cp0->r[regs[i].reg]);
+        }
+    }
+    if (!memcmp(cp0->tlb, last->tlb, sizeof(cp0->tlb))) {
+        return p;
+    }
+    for (i = 0; i < CP0_TLB_SIZE; i++) {
+        if ((cp0->tlb[i].tag != last->tlb[i].tag) ||
+            (cp0->tlb[i].data != last->tlb[i].data)) {
+            p += sprintf(p, "  TLB[%02d]=%08x:%08x",
+                         i, cp0->tlb[i].tag, cp0->tlb[i].data);
+        }
+    }
+    return p;
+}
+
 
 static void tlb_write(core_t *c, core_cp0_t *cp0, uint32_t idx,
                       uint32_t hi, uint32_t lo)
@@ -21,10 +21,21 @@ enum {
 };
 
 enum {
+    STATUS_IM  = 0xFF << 8,
     STATUS_UM  = 1 << 4,
     STATUS_EXL = 1 << 1,
+    STATUS_IE  = 1 << 0,
 };
 
+enum {
+    CAUSE_IP   = 0xFF << 8,
+    CAUSE_EXC  = 0x1F << 2,
+};
+
+/* Hardware interrupt lines 0-5 appear as IP2-IP7 in CAUSE. */
+#define CP0_NUM_IRQS 6
+#define CAUSE_IP_HW(irq) (1 << (10 + (irq)))
+
 #define CP0_TLB_SIZE 32
 
 typedef struct core_cp0 core_cp0_t;
@@ -44,16 +55,22 @@ struct core_cp0 {
 
 void core_cp0_reset(core_t *c, core_cp0_t *cp0);
 int core_cp0_step(core_t *c, core_cp0_t *cp0);
+void core_cp0_skip(core_t *c, core_cp0_t *cp0, uint64_t steps);
 int core_cp0_translate(core_t *c, core_cp0_t *cp0, uint32_t va,
                        uint32_t *pa_out, int write);
+int core_cp0_probe(core_t *c, core_cp0_t *cp0, uint32_t va, uint32_t *pa_out);
 int core_cp0_tlbwi(core_t *c, core_cp0_t *cp0);
 int core_cp0_tlbwr(core_t *c, core_cp0_t *cp0);
 int core_cp0_except(core_t *c, core_cp0_t *cp0, uint8_t exc_code);
 int core_cp0_eret(core_t *c, core_cp0_t *cp0, uint32_t *newpc);
 int core_cp0_user_mode(core_t *c, core_cp0_t *cp0);
+void core_cp0_set_irq(core_t *c, core_cp0_t *cp0, int irq, int level);
+int core_cp0_irq_pending(core_t *c, core_cp0_t *cp0);
 int core_cp0_move_from(core_t *c, core_cp0_t *cp0, uint8_t reg,
                        uint32_t *val_out);
 int core_cp0_move_to(core_t *c, core_cp0_t *cp0, uint8_t reg, uint32_t val);
 void core_cp0_dump_regs(core_t *c, core_cp0_t *cp0, FILE *out);
+char *core_cp0_dump_changes(core_t *c, core_cp0_t *cp0, core_cp0_t *last,
+                            char *p);
 
 #endif
@@ -1,6 +1,72 @@
 #ifndef HAVE_CORE_PRIV_H
 #define HAVE_CORE_PRIV_H
 
+#include <stdint.h>
+
+#include "bbv.h"
+#include "core.h"
+#include "core_cp0.h"
+#include "filter.h"
+#include "mem.h"
+#include "profile.h"
+#include "sched.h"
+#include "stats.h"
+#include "trap.h"
+#include "uarch.h"
+
 #define EXCEPTED (-1)
 
+#define NUM_REGS 32
+
+/* Guest file descriptors the host syscalls know about; see core_sys.c. */
+#define NUM_SYS_FDS 16
+
+/* Architectural state sampled at a backward branch; see check_idle. */
+struct idle {
+    unsigned branches;
+    uint32_t pc;
+    uint32_t r[NUM_REGS];
+    uint32_t hi;
+    uint32_t lo;
+    core_cp0_t cp0;
+    uint64_t nstores;
+};
+
+struct core {
+    mem_t *mem;
+    filter_t *filter;
+    uarch_t *uarch;
+    bbv_t *bbv;
+    profile_t *prof;
+    trap_t *trap;
+    uint32_t r[NUM_REGS];
+    uint32_t hi;
+    uint32_t lo;
+    uint32_t pc;
+
+    core_cp0_t cp0;
+    sched_t sched;
+    uarch_rec_t rec;
+    core_stats_t stats;
+
+    int exc_count;
+
+    uint64_t nstores;
+    struct idle idle;
+    int idle_skip;
+
+    int host_syscalls;
+    int exit_status;
+    int32_t sys_fds[NUM_SYS_FDS];
+
+    /* Lets the instruction at skip_pc, at time skip_now, past its traps. */
+    int skipping;
+    uint32_t skip_pc;
+    uint64_t skip_now;
+
+    /* The access that set off the last watchpoint stop. */
+    uint32_t watch_va;
+    int watch_kinds;
+};
+
 #endif
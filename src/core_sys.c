@@ -0,0 +1,403 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "core_priv.h"
+#include "core_sys.h"
+#include "debug.h"
+#include "err.h"
+#include "rr.h"
+
+enum {
+    REG_V0 = 2,
+    REG_A0 = 4,
+    REG_A1 = 5,
+    REG_A2 = 6
+};
+
+/* MARS's open flags. */
+enum {
+    SYS_O_RDONLY = 0,
+    SYS_O_WRONLY = 1,
+    SYS_O_APPEND = 9
+};
+
+#define PAGE_LEFT(va) (0x1000 - ((va) & 0xFFF))
+#define MAX_PATH 4096
+#define LINE_CHUNK 256
+
+static int host_fd(core_t *c, uint32_t fd);
+static int32_t do_io(core_t *c, int fd, uint32_t va, uint32_t len, int in);
+static int32_t do_print_string(core_t *c, uint32_t va);
+static int32_t do_read_int(core_t *c);
+static int32_t do_read_string(core_t *c, uint32_t va, uint32_t len);
+static int32_t do_open(core_t *c, uint32_t path_va, uint32_t flags,
+                       uint32_t mode);
+static void do_close(core_t *c, uint32_t fd);
+static int copy_out(core_t *c, uint32_t va, const char *buf, uint32_t len);
+static int copy_in_str(core_t *c, uint32_t va, char *buf, uint32_t size);
+static int read_line(char *buf, uint32_t size);
+static int write_all(int fd, const char *buf, size_t len);
+
+/*
+ The guest only gets at host files through sys_fds, which maps its fds to
+ the ones do_open got back from the host (or -1 for unused ones), so it
+ can't touch the simulator's own: disk images, logs, checkpoints, sockets.
+ The first three are always stdin, stdout and stderr.  The table is part of
+ the state core_save copies, so it rewinds along with the record log.
+ */
+void core_sys_reset(core_t *c)
+{
+    int i;
+
+    for (i = 0; i < NUM_SYS_FDS; i++) {
+        c->sys_fds[i] = (i <= 2) ? i : -1;
+    }
+}
+
+int core_sys_call(core_t *c)
+{
+    uint32_t *r = c->r;
+    char buf[16];
+    uint8_t ch;
+
+    debug_printf(CORE, DETAIL, "Host syscall %u (a0=%08x a1=%08x a2=%08x)\n",
+            r[REG_V0], r[REG_A0], r[REG_A1], r[REG_A2]);
+
+    switch (r[REG_V0]) {
+    case SYS_PRINT_INT:
+        sprintf(buf, "%d", (int)(int32_t)r[REG_A0]);
+        write_all(1, buf, strlen(buf));
+        break;
+    case SYS_PRINT_STRING:
+        do_print_string(c, r[REG_A0]);
+        break;
+    case SYS_READ_INT:
+        r[REG_V0] = (uint32_t)do_read_int(c);
+        break;
+    case SYS_READ_STRING:
+        do_read_string(c, r[REG_A0], r[REG_A1]);
+        break;
+    case SYS_EXIT:
+        c->exit_status = 0;
+        return ERR_EXIT;
+    case SYS_PRINT_CHAR:
+        ch = (uint8_t)r[REG_A0];
+        write_all(1, (char *)&ch, 1);
+        break;
+    case SYS_READ_CHAR:
+        r[REG_V0] = (rr_read(RR_STDIN, 0, &ch, 1) == 1) ? ch : (uint32_t)-1;
+        break;
+    case SYS_OPEN:
+        r[REG_V0] = (uint32_t)do_open(c, r[REG_A0], r[REG_A1], r[REG_A2]);
+        break;
+    case SYS_READ:
+        r[REG_V0] = (uint32_t)do_io(c, host_fd(c, r[REG_A0]), r[REG_A1],
+                r[REG_A2], 1);
+        break;
+    case SYS_WRITE:
+        r[REG_V0] = (uint32_t)do_io(c, host_fd(c, r[REG_A0]), r[REG_A1],
+                r[REG_A2], 0);
+        break;
+    case SYS_CLOSE:
+        do_close(c, r[REG_A0]);
+        break;
+    case SYS_EXIT2:
+        c->exit_status = (int32_t)r[REG_A0];
+        return ERR_EXIT;
+    case SYS_ICOUNT:
+        r[REG_A0] = (uint32_t)c->sched.now;
+        r[REG_A1] = (uint32_t)(c->sched.now >> 32);
+        break;
+    default:
+        return SYS_UNHANDLED;
+    }
+
+    return 0;
+}
+
+/* The host fd behind guest fd fd, or -1 if the guest hasn't got one. */
+static int host_fd(core_t *c, uint32_t fd)
+{
+    return (fd < NUM_SYS_FDS) ? c->sys_fds[fd] : -1;
+}
+
+/*
+ Reads or writes guest memory directly from or to the host fd, a page at a
+ time, with no intermediate copy.  Like read(2), stops early on a short
+ transfer.  Returns the number of bytes transferred, or -1 if nothing was
+ transferred because of an error, an unmapped buffer or a bad fd.
+ */
+static int32_t do_io(core_t *c, int fd, uint32_t va, uint32_t len, int in)
+{
+    uint32_t done = 0, chunk;
+    long ret;
+    void *p;
+
+    if (fd < 0) {
+        debug_print(CORE, DETAIL, "Host syscall on a bad fd\n");
+        return -1;
+    }
+    while (done < len) {
+        chunk = PAGE_LEFT(va + done);
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        p = core_map_virt(c, va + done, chunk, in);
+        if (!p) {
+            debug_printf(CORE, DETAIL,
+                    "Host syscall buffer at %08x is not mapped\n", va + done);
+            break;
+        }
+        if (in) {
+            ret = rr_read(fd ? RR_READ : RR_STDIN, fd, p, chunk);
+        } else {
+            ret = rr_write(fd, p, chunk);
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += ret;
+        if ((uint32_t)ret < chunk) {
+            break;
+        }
+    }
+
+    return ((done == 0) && (len != 0)) ? -1 : (int32_t)done;
+}
+
+static int32_t do_print_string(core_t *c, uint32_t va)
+{
+    uint32_t chunk;
+    char *p, *nul;
+
+    for (;;) {
+        chunk = PAGE_LEFT(va);
+        p = core_map_virt(c, va, chunk, 0);
+        if (!p) {
+            return -1;
+        }
+        nul = memchr(p, '\0', chunk);
+        write_all(1, p, nul ? (size_t)(nul - p) : chunk);
+        if (nul) {
+            return 0;
+        }
+        va += chunk;
+    }
+}
+
+static int32_t do_read_int(core_t *c)
+{
+    char buf[64];
+
+    if (read_line(buf, sizeof(buf)) < 0) {
+        return 0;
+    }
+    return (int32_t)strtol(buf, NULL, 10);
+}
+
+/*
+ As fgets: reads at most len - 1 characters, keeping the newline.  len is up
+ to the guest, so the line goes out LINE_CHUNK bytes at a time.
+ */
+static int32_t do_read_string(core_t *c, uint32_t va, uint32_t len)
+{
+    char buf[LINE_CHUNK];
+    uint32_t n = 0, chunk;
+    int got;
+
+    if (len == 0) {
+        return 0;
+    }
+    while (n < len - 1) {
+        chunk = len - 1 - n;
+        if (chunk > sizeof(buf) - 1) {
+            chunk = sizeof(buf) - 1;
+        }
+        got = read_line(buf, chunk + 1);
+        if (got <= 0) {
+            break;
+        }
+        if (copy_out(c, va + n, buf, got)) {
+            return -1;
+        }
+        n += got;
+        if (buf[got - 1] == '\n') {
+            break;
+        }
+    }
+    return copy_out(c, va + n, "", 1) ? -1 : 0;
+}
+
+static int32_t do_open(core_t *c, uint32_t path_va, uint32_t flags,
+                       uint32_t mode)
+{
+    char path[MAX_PATH];
+    int oflags, fd, i;
+
+    switch (flags) {
+    case SYS_O_RDONLY:
+        oflags = O_RDONLY;
+        break;
+    case SYS_O_WRONLY:
+        oflags = O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+    case SYS_O_APPEND:
+        oflags = O_WRONLY | O_CREAT | O_APPEND;
+        break;
+    default:
+        return -1;
+    }
+
+    if (copy_in_str(c, path_va, path, sizeof(path))) {
+        return -1;
+    }
+
+    if (rr_replaying()) {
+        fd = rr_value(RR_OPEN, -1);
+    } else {
+        fd = rr_value(RR_OPEN, open(path, oflags, mode ? (mode_t)mode : 0644));
+    }
+    debug_printf(CORE, DETAIL, "Host syscall open(\"%s\") = %d\n", path, fd);
+    if (fd < 0) {
+        return -1;
+    }
+
+    for (i = 3; i < NUM_SYS_FDS; i++) {
+        if (c->sys_fds[i] < 0) {
+            c->sys_fds[i] = fd;
+            return i;
+        }
+    }
+    debug_print(CORE, WARNING, "Host syscall open: out of guest fds\n");
+    if (!rr_replaying()) {
+        close(fd);
+    }
+    return -1;
+}
+
+/* Stdin, stdout and stderr stay open whatever the guest does. */
+static void do_close(core_t *c, uint32_t fd)
+{
+    int host = host_fd(c, fd);
+
+    if (fd <= 2 || host < 0) {
+        return;
+    }
+    c->sys_fds[fd] = -1;
+    if (!rr_replaying()) {
+        close(host);
+    }
+}
+
+static int copy_out(core_t *c, uint32_t va, const char *buf, uint32_t len)
+{
+    uint32_t chunk;
+    void *p;
+
+    while (len > 0) {
+        chunk = PAGE_LEFT(va);
+        if (chunk > len) {
+            chunk = len;
+        }
+        p = core_map_virt(c, va, chunk, 1);
+        if (!p) {
+            return 1;
+        }
+        memcpy(p, buf, chunk);
+        va += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+
+    return 0;
+}
+
+static int copy_in_str(core_t *c, uint32_t va, char *buf, uint32_t size)
+{
+    uint32_t chunk, n = 0;
+    char *p, *nul;
+
+    while (n < size) {
+        chunk = PAGE_LEFT(va + n);
+        if (chunk > size - n) {
+            chunk = size - n;
+        }
+        p = core_map_virt(c, va + n, chunk, 0);
+        if (!p) {
+            return 1;
+        }
+        nul = memchr(p, '\0', chunk);
+        if (nul) {
+            memcpy(buf + n, p, nul - p + 1);
+            return 0;
+        }
+        memcpy(buf + n, p, chunk);
+        n += chunk;
+    }
+
+    return 1;
+}
+
+/*
+ Reads a line from stdin a byte at a time (so we never consume input past the
+ newline), keeping at most size - 1 characters and NUL-terminating it.
+ Returns the length, or -1 at EOF with nothing read.
+ */
+static int read_line(char *buf, uint32_t size)
+{
+    uint32_t n = 0;
+    char ch;
+
+    while (n + 1 < size) {
+        if (rr_read(RR_STDIN, 0, &ch, 1) != 1) {
+            if (n == 0) {
+                return -1;
+            }
+            break;
+        }
+        buf[n++] = ch;
+        if (ch == '\n') {
+            break;
+        }
+    }
+    buf[n] = '\0';
+
+    return (int)n;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t ret;
+
+    if (rr_silent()) {
+        return 0;
+    }
+    while (len > 0) {
+        ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            debug_printf(CORE, ERROR, "Host syscall write: %s\n",
+                    strerror(errno));
+            return 1;
+        }
+        buf += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef HAVE_CORE_SYS_H
+#define HAVE_CORE_SYS_H
+
+#include "core.h"
+
+/*
+ Host services, requested with SYSCALL and $v0 set to one of these.  The
+ numbering (and argument/result registers) follows SPIM/MARS, except that
+ SYS_ICOUNT replaces SPIM's "time" service with the retired instruction count
+ so that results stay deterministic.
+ */
+enum {
+    SYS_PRINT_INT    =  1,
+    SYS_PRINT_STRING =  4,
+    SYS_READ_INT     =  5,
+    SYS_READ_STRING  =  8,
+    SYS_EXIT         = 10,
+    SYS_PRINT_CHAR   = 11,
+    SYS_READ_CHAR    = 12,
+    SYS_OPEN         = 13,
+    SYS_READ         = 14,
+    SYS_WRITE        = 15,
+    SYS_CLOSE        = 16,
+    SYS_EXIT2        = 17,
+    SYS_ICOUNT       = 30
+};
+
+/* Returned by core_sys_call for services it doesn't provide. */
+#define SYS_UNHANDLED (-2)
+
+void core_sys_reset(core_t *c);
+int core_sys_call(core_t *c);
+
+#endif
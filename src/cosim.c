@@ -0,0 +1,440 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core_priv.h"
+#include "cosim.h"
+#include "debug.h"
+#include "err.h"
+#include "opcode.h"
+#include "ring.h"
+#include "uarch.h"
+#include "util.h"
+
+/*
+ The parser thread reads the trace in large chunks and hands the core one
+ record per line through a ring, so memory use is bounded by the chunk and
+ the ring whatever the size of the trace, and parsing overlaps simulation.
+ */
+#define COSIM_CHUNK (1 << 20)
+#define COSIM_MAX_LINE 4096
+#define COSIM_RING_SIZE 4096
+#define COSIM_HISTORY 8
+
+#define REC_REG (1 << 0)
+#define REC_STORE (1 << 1)
+#define REC_END (1 << 2)        /* End of the trace, or a read error. */
+#define REC_BAD (1 << 3)        /* A line we couldn't parse; stops here. */
+
+typedef struct cosim_rec cosim_rec_t;
+
+struct cosim_rec {
+    uint64_t line;
+    uint32_t pc;
+    uint32_t val;
+    uint32_t addr;
+    uint32_t data;
+    uint8_t reg;
+    uint8_t flags;
+};
+
+struct cosim {
+    core_t *core;
+    char *name;
+    FILE *f;
+    ring_t *ring;
+    pthread_t thread;
+    int stop;               /* Set by the core side to end the parser. */
+    int done;               /* Consumed the END or BAD record. */
+    int diverged;
+    uint64_t checked;
+
+    /* The last instructions that matched, for context at a divergence. */
+    struct {
+        uint64_t line;
+        uint32_t pc;
+        uint32_t ins;
+    } history[COSIM_HISTORY];
+};
+
+static void *cosim_thread(void *arg);
+static int parse_line(cosim_t *cs, char *s, uint64_t line);
+static int parse_hex(char **s, uint32_t *out);
+static void emit(cosim_t *cs, const cosim_rec_t *rec);
+static void commit_rec(core_t *c, uint32_t pc, cosim_rec_t *rec);
+static char *format_rec(char *buf, const cosim_rec_t *rec);
+static void report(cosim_t *cs, const cosim_rec_t *want,
+                   const cosim_rec_t *got);
+
+cosim_t *cosim_create(char *file, core_t *core)
+{
+    cosim_t *cs;
+    FILE *f;
+
+    f = strcmp(file, "-") ? fopen(file, "r") : stdin;
+    if (!f) {
+        debug_printf(COSIM, FATAL, "%s: %s\n", file, strerror(errno));
+        return NULL;
+    }
+
+    cs = xmalloc(sizeof(*cs));
+    memset(cs, 0, sizeof(*cs));
+    cs->core = core;
+    cs->name = file;
+    cs->f = f;
+    cs->ring = ring_create(sizeof(cosim_rec_t), COSIM_RING_SIZE);
+    /* The trace has every iteration of an idle loop, so run them all. */
+    core_set_idle_skip(core, 0);
+    if (pthread_create(&cs->thread, NULL, cosim_thread, cs)) {
+        debug_print(COSIM, FATAL, "Couldn't start trace parser thread.\n");
+        abort();
+    }
+    return cs;
+}
+
+void cosim_destroy(cosim_t *cs)
+{
+    const cosim_rec_t *rec;
+    uint64_t line = 0;
+
+    /* Drain what the parser has queued so it sees the stop and exits. */
+    __atomic_store_n(&cs->stop, 1, __ATOMIC_RELEASE);
+    while (!cs->done) {
+        rec = ring_consume(cs->ring);
+        if (!line && !(rec->flags & REC_END)) {
+            line = rec->line;
+        }
+        cs->done = !!(rec->flags & (REC_END | REC_BAD));
+        ring_consumed(cs->ring);
+    }
+    pthread_join(cs->thread, NULL);
+    if (line && !cs->diverged) {
+        debug_printf(COSIM, WARNING,
+                "Halted with the trace unfinished, at line %llu.\n",
+                (unsigned long long)line);
+    }
+    debug_printf(COSIM, INFO, "Checked %llu instructions against \"%s\".\n",
+            (unsigned long long)cs->checked, cs->name);
+
+    if (cs->f != stdin) {
+        fclose(cs->f);
+    }
+    ring_destroy(cs->ring);
+    core_set_idle_skip(cs->core, 1);
+    free(cs);
+}
+
+/*
+ Steps the core, and if that retired an instruction, checks it against the
+ next line of the trace.  Returns ERR_DIVERGED at the first mismatch (or bad
+ line), ERR_TRACE_END if the trace ran out, and otherwise what core_step
+ did.
+ */
+int cosim_step(cosim_t *cs)
+{
+    core_t *c = cs->core;
+    uint64_t now = c->sched.now;
+    uint32_t pc = c->pc;
+    const cosim_rec_t *want;
+    cosim_rec_t got;
+    unsigned h;
+    int ret;
+
+    if (cs->done) {
+        return ERR_TRACE_END;
+    }
+    /* Look at the next line first, so the core stops where the trace does. */
+    want = ring_consume(cs->ring);
+    if (want->flags & (REC_END | REC_BAD)) {
+        cs->done = 1;
+        ret = ERR_TRACE_END;
+        if (want->flags & REC_BAD) {
+            report(cs, want, NULL);
+            ret = ERR_DIVERGED;
+        }
+        ring_consumed(cs->ring);
+        return ret;
+    }
+
+    ret = core_step(c);
+    if (c->sched.now == now) {
+        /*
+         Took an exception or halted; nothing committed.  The RTL does
+         commit the instruction that exits, though.
+         */
+        if (((ret == ERR_EXIT) || (ret == ERR_TESTDONE)) &&
+            (want->pc == pc)) {
+            cs->checked++;
+            ring_consumed(cs->ring);
+        }
+        return ret;
+    }
+    commit_rec(c, pc, &got);
+    if ((want->pc != got.pc) ||
+        ((want->flags ^ got.flags) & (REC_REG | REC_STORE)) ||
+        ((got.flags & REC_REG) &&
+         ((want->reg != got.reg) || (want->val != got.val))) ||
+        ((got.flags & REC_STORE) &&
+         ((want->addr != got.addr) || (want->data != got.data)))) {
+        report(cs, want, &got);
+        ring_consumed(cs->ring);
+        cs->diverged = 1;
+        return ERR_DIVERGED;
+    }
+
+    h = cs->checked % COSIM_HISTORY;
+    cs->history[h].line = want->line;
+    cs->history[h].pc = pc;
+    cs->history[h].ins = c->rec.ins;
+    cs->checked++;
+    ring_consumed(cs->ring);
+    return ret;
+}
+
+static void *cosim_thread(void *arg)
+{
+    cosim_t *cs = arg;
+    cosim_rec_t rec;
+    char *buf, *start, *nl;
+    size_t have = 0, n, rest;
+    uint64_t line = 0;
+
+    buf = xmalloc(COSIM_CHUNK + COSIM_MAX_LINE + 1);
+    rec.flags = REC_END;
+    for (;;) {
+        n = fread(buf + have, 1, COSIM_CHUNK, cs->f);
+        have += n;
+        start = buf;
+        while ((nl = memchr(start, '\n', have - (start - buf)))) {
+            *nl = '\0';
+            if (parse_line(cs, start, ++line)) {
+                goto out;
+            }
+            start = nl + 1;
+            if (__atomic_load_n(&cs->stop, __ATOMIC_ACQUIRE)) {
+                goto end;
+            }
+        }
+        rest = have - (start - buf);
+        if (n == 0) {
+            /* A last line without a newline. */
+            if (rest) {
+                start[rest] = '\0';
+                if (parse_line(cs, start, ++line)) {
+                    goto out;
+                }
+            }
+            if (ferror(cs->f)) {
+                debug_printf(COSIM, ERROR, "%s: %s\n", cs->name,
+                        strerror(errno));
+            }
+            break;
+        }
+        if (rest > COSIM_MAX_LINE) {
+            rec.line = line + 1;
+            rec.flags = REC_BAD;
+            break;
+        }
+        memmove(buf, start, rest);
+        have = rest;
+    }
+end:
+    emit(cs, &rec);
+out:
+    ring_flush(cs->ring);
+    free(buf);
+    return NULL;
+}
+
+/*
+ Parses a line and queues its record.  Returns nonzero after a bad line,
+ which is queued as REC_BAD and ends the trace.
+ */
+static int parse_line(cosim_t *cs, char *s, uint64_t line)
+{
+    cosim_rec_t rec;
+    uint32_t n;
+    char *end;
+
+    while ((*s == ' ') || (*s == '\t')) {
+        s++;
+    }
+    if (!*s || (*s == '#') || (*s == '\r')) {
+        return 0;
+    }
+
+    rec.line = line;
+    rec.flags = 0;
+    rec.reg = 0;
+    rec.val = rec.addr = rec.data = 0;
+    if (parse_hex(&s, &rec.pc)) {
+        goto bad;
+    }
+    for (;;) {
+        while ((*s == ' ') || (*s == '\t') || (*s == ',')) {
+            s++;
+        }
+        if (!*s || (*s == '\r') || (*s == '#')) {
+            break;
+        }
+        if ((*s == 'r') || (*s == '$')) {
+            n = strtoul(s + 1, &end, 10);
+            if ((end == s + 1) || (*end != '=') || (n >= NUM_REGS)) {
+                goto bad;
+            }
+            s = end + 1;
+            if (parse_hex(&s, &rec.val)) {
+                goto bad;
+            }
+            /* Some RTL reports writes to $0; they don't happen. */
+            if (n) {
+                rec.reg = n;
+                rec.flags |= REC_REG;
+            }
+        } else if (*s == 'm') {
+            s++;
+            if (parse_hex(&s, &rec.addr) || (*s++ != '=') ||
+                parse_hex(&s, &rec.data)) {
+                goto bad;
+            }
+            rec.flags |= REC_STORE;
+        } else {
+            goto bad;
+        }
+    }
+    emit(cs, &rec);
+    return 0;
+
+bad:
+    rec.flags = REC_BAD;
+    emit(cs, &rec);
+    return 1;
+}
+
+/* Reads hex digits, with an optional 0x, advancing *s past them. */
+static int parse_hex(char **s, uint32_t *out)
+{
+    char *p = *s;
+    uint32_t v = 0;
+    int d;
+
+    if ((p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X'))) {
+        p += 2;
+    }
+    *s = p;
+    for (;;) {
+        if ((*p >= '0') && (*p <= '9')) {
+            d = *p - '0';
+        } else if ((*p >= 'a') && (*p <= 'f')) {
+            d = *p - 'a' + 10;
+        } else if ((*p >= 'A') && (*p <= 'F')) {
+            d = *p - 'A' + 10;
+        } else {
+            break;
+        }
+        v = (v << 4) | d;
+        p++;
+    }
+    if ((p == *s) || (p - *s > 8)) {
+        return 1;
+    }
+    *s = p;
+    *out = v;
+    return 0;
+}
+
+static void emit(cosim_t *cs, const cosim_rec_t *rec)
+{
+    *(cosim_rec_t *)ring_produce(cs->ring) = *rec;
+    ring_produced(cs->ring);
+}
+
+/* What the instruction just retired at pc would put in the trace. */
+static void commit_rec(core_t *c, uint32_t pc, cosim_rec_t *rec)
+{
+    uint32_t ins = c->rec.ins;
+    uarch_dec_t d;
+
+    rec->line = 0;
+    rec->pc = pc;
+    rec->flags = 0;
+    rec->reg = 0;
+    rec->val = rec->addr = rec->data = 0;
+
+    uarch_decode(ins, &d);
+    if (d.dst != UARCH_NO_REG) {
+        rec->reg = d.dst;
+        rec->val = c->r[d.dst];
+        rec->flags |= REC_REG;
+    }
+    switch (OP(ins)) {
+    case OP_SB:
+        rec->data = c->r[RT(ins)] & 0xFF;
+        break;
+    case OP_SH:
+        rec->data = c->r[RT(ins)] & 0xFFFF;
+        break;
+    case OP_SW:
+        rec->data = c->r[RT(ins)];
+        break;
+    default:
+        return;
+    }
+    rec->addr = c->r[RS(ins)] + (int16_t)IMMED(ins);
+    rec->flags |= REC_STORE;
+}
+
+static char *format_rec(char *buf, const cosim_rec_t *rec)
+{
+    char *p = buf;
+
+    p += sprintf(p, "%08lx", (unsigned long)rec->pc);
+    if (rec->flags & REC_REG) {
+        p += sprintf(p, " r%u=%08lx", rec->reg, (unsigned long)rec->val);
+    }
+    if (rec->flags & REC_STORE) {
+        p += sprintf(p, " m%08lx=%lx", (unsigned long)rec->addr,
+                     (unsigned long)rec->data);
+    }
+    return buf;
+}
+
+static void report(cosim_t *cs, const cosim_rec_t *want,
+                   const cosim_rec_t *got)
+{
+    char buf[64];
+    uint64_t i;
+    unsigned h;
+
+    if (want->flags & REC_BAD) {
+        debug_printf(COSIM, ERROR, "%s:%llu: can't parse this line.\n",
+                cs->name, (unsigned long long)want->line);
+    } else {
+        debug_printf(COSIM, ERROR,
+                "%s:%llu: diverged at instruction %llu.\n", cs->name,
+                (unsigned long long)want->line,
+                (unsigned long long)cs->checked);
+        debug_printf(COSIM, ERROR, "  trace: %s\n", format_rec(buf, want));
+    }
+    if (got) {
+        debug_printf(COSIM, ERROR, "  tmips: %s (%08lx)\n",
+                format_rec(buf, got), (unsigned long)cs->core->rec.ins);
+    }
+
+    i = (cs->checked > COSIM_HISTORY) ? cs->checked - COSIM_HISTORY : 0;
+    if (i < cs->checked) {
+        debug_print(COSIM, ERROR, "Last instructions that matched:\n");
+    }
+    for (; i < cs->checked; i++) {
+        h = i % COSIM_HISTORY;
+        debug_printf(COSIM, ERROR, "  %s:%llu: %08lx (%08lx)\n", cs->name,
+                (unsigned long long)cs->history[h].line,
+                (unsigned long)cs->history[h].pc,
+                (unsigned long)cs->history[h].ins);
+    }
+}
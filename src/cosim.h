@@ -0,0 +1,27 @@
+#ifndef COSIM_H
+#define COSIM_H
+
+#include "core.h"
+
+/*
+ Lockstep co-simulation against a commit trace from an RTL simulation.  The
+ trace is text, one committed instruction per line:
+
+   <pc> [r<n>=<value>] [m<addr>=<data>]
+
+ in hex (the register number in decimal), giving the register the
+ instruction wrote, if any, and for stores the address and the data stored
+ (the low byte or halfword for SB and SH).  Blank lines and lines starting
+ with '#' are skipped.
+
+ A thread parses the trace as it is read, so it can be any size (or a pipe,
+ e.g. from zcat), and cosim_step runs the core one step and checks each
+ instruction it retires against the next line.
+ */
+typedef struct cosim cosim_t;
+
+cosim_t *cosim_create(char *file, core_t *core);
+void cosim_destroy(cosim_t *cs);
+int cosim_step(cosim_t *cs);
+
+#endif
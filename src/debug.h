@@ -4,12 +4,18 @@
 typedef enum {
     DEBUG_MODULE_CONFIG,
     DEBUG_MODULE_CORE,
+    DEBUG_MODULE_COSIM,
+    DEBUG_MODULE_DISK,
     DEBUG_MODULE_EXC,
     DEBUG_MODULE_MAIN,
     DEBUG_MODULE_MEM,
     DEBUG_MODULE_READMEMH,
     DEBUG_MODULE_RAM,
+    DEBUG_MODULE_REV,
+    DEBUG_MODULE_RR,
     DEBUG_MODULE_SERIAL,
+    DEBUG_MODULE_TIMER,
+    DEBUG_MODULE_TRAP,
     DEBUG_MODULE_UTIL,
     DEBUG_MODULE_VM,
     NUM_DEBUG_MODULES
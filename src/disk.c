@@ -0,0 +1,255 @@
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "disk.h"
+#include "mem.h"
+#include "mem_dev.h"
+#include "util.h"
+
+typedef struct disk_dev disk_dev_t;
+struct disk_dev {
+    mem_dev_t dev;
+    mem_t *mem;
+    char *file;
+    int fd;
+    int writable;
+    uint32_t sectors;
+
+    uint32_t sector;
+    uint32_t count;
+    uint32_t addr;
+    uint32_t status;
+};
+
+struct disk_state {
+    uint32_t sector;
+    uint32_t count;
+    uint32_t addr;
+    uint32_t status;
+};
+
+static int disk_read(mem_dev_t *dev, uint32_t offset, uint32_t *val_out);
+static int disk_write(mem_dev_t *dev, uint32_t offset,
+                      uint32_t val, uint8_t we);
+static void disk_save(mem_dev_t *dev, void *buf);
+static void disk_restore(mem_dev_t *dev, const void *buf);
+static int transfer(disk_dev_t *d, int write);
+
+mem_dev_t *disk_create(mem_t *mem, char *file)
+{
+    disk_dev_t *d;
+    struct stat st;
+    int fd, writable = 1;
+
+    fd = open(file, O_RDWR);
+    if ((fd < 0) && ((errno == EACCES) || (errno == EROFS))) {
+        fd = open(file, O_RDONLY);
+        writable = 0;
+    }
+    if (fd < 0) {
+        debug_printf(DISK, ERROR, "%s: %s\n", file, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0) {
+        debug_printf(DISK, ERROR, "%s: %s\n", file, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    d = xmalloc(sizeof(*d));
+    d->dev.size = DISK_SIZE;
+    d->dev.read = &disk_read;
+    d->dev.write = &disk_write;
+    d->dev.map = NULL;
+    d->dev.state_size = sizeof(struct disk_state);
+    d->dev.save = &disk_save;
+    d->dev.restore = &disk_restore;
+    d->dev.dirty = NULL;
+    d->mem = mem;
+    d->file = file;
+    d->fd = fd;
+    d->writable = writable;
+    d->sectors = (st.st_size / DISK_SECTOR_SIZE > UINT32_MAX)
+            ? UINT32_MAX : (uint32_t)(st.st_size / DISK_SECTOR_SIZE);
+    d->sector = d->count = d->addr = d->status = 0;
+
+    debug_printf(DISK, INFO, "Opened disk \"%s\" (%u sectors%s)\n",
+            file, d->sectors, writable ? "" : ", read-only");
+
+    return (mem_dev_t *)d;
+}
+
+void disk_destroy(mem_dev_t *dev)
+{
+    disk_dev_t *d = (disk_dev_t *)dev;
+    assert(d->dev.read == &disk_read);
+
+    close(d->fd);
+    free(d);
+}
+
+static int disk_read(mem_dev_t *dev, uint32_t offset, uint32_t *val_out)
+{
+    disk_dev_t *d = (disk_dev_t *)dev;
+
+    switch (offset) {
+    case DISK_SECTOR:
+        *val_out = d->sector;
+        break;
+    case DISK_COUNT:
+        *val_out = d->count;
+        break;
+    case DISK_ADDR:
+        *val_out = d->addr;
+        break;
+    case DISK_STATUS:
+        *val_out = d->status;
+        break;
+    case DISK_SECTORS:
+        *val_out = d->sectors;
+        break;
+    default:
+        return 1;
+    }
+
+    return 0;
+}
+
+static int disk_write(mem_dev_t *dev, uint32_t offset,
+                      uint32_t val, uint8_t we)
+{
+    disk_dev_t *d = (disk_dev_t *)dev;
+    uint32_t mask = we_to_mask(we);
+
+    switch (offset) {
+    case DISK_SECTOR:
+        d->sector = (d->sector & ~mask) | (val & mask);
+        break;
+    case DISK_COUNT:
+        d->count = (d->count & ~mask) | (val & mask);
+        break;
+    case DISK_ADDR:
+        d->addr = (d->addr & ~mask) | (val & mask);
+        break;
+    case DISK_CMD:
+        switch (val & mask) {
+        case DISK_CMD_READ:
+            d->status = transfer(d, 0) ? DISK_STATUS_ERROR : 0;
+            break;
+        case DISK_CMD_WRITE:
+            d->status = transfer(d, 1) ? DISK_STATUS_ERROR : 0;
+            break;
+        default:
+            debug_printf(DISK, WARNING,
+                    "%s: unknown command %08x\n", d->file, val & mask);
+            d->status = DISK_STATUS_ERROR;
+            break;
+        }
+        break;
+    default:
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ Only the registers are checkpointed: the image is left as it is, so a guest
+ that writes to its disk sees those writes after going back in time.
+ */
+static void disk_save(mem_dev_t *dev, void *buf)
+{
+    disk_dev_t *d = (disk_dev_t *)dev;
+    struct disk_state *st = buf;
+
+    st->sector = d->sector;
+    st->count = d->count;
+    st->addr = d->addr;
+    st->status = d->status;
+}
+
+static void disk_restore(mem_dev_t *dev, const void *buf)
+{
+    disk_dev_t *d = (disk_dev_t *)dev;
+    const struct disk_state *st = buf;
+
+    d->sector = st->sector;
+    d->count = st->count;
+    d->addr = st->addr;
+    d->status = st->status;
+}
+
+/*
+ The transfer goes straight between the image and the RAM backing the guest
+ buffer with a single pread or pwrite.  RAM holds guest words in host byte
+ order, so this assumes a little-endian host (as the rest of the byte
+ addressing in core.c effectively does).
+ */
+static int transfer(disk_dev_t *d, int write)
+{
+    uint64_t len;
+    off_t off;
+    uint8_t *p;
+    ssize_t ret;
+
+    if ((d->sector > d->sectors) || (d->count > d->sectors - d->sector)) {
+        debug_printf(DISK, DETAIL,
+                "%s: transfer of %u sectors at %u is past end of disk\n",
+                d->file, d->count, d->sector);
+        return 1;
+    }
+    if (write && !d->writable) {
+        debug_printf(DISK, DETAIL, "%s: disk is read-only\n", d->file);
+        return 1;
+    }
+
+    len = (uint64_t)d->count * DISK_SECTOR_SIZE;
+    if (len == 0) {
+        return 0;
+    }
+    if (len > UINT32_MAX) {
+        return 1;
+    }
+    p = mem_map_host(d->mem, d->addr, (uint32_t)len, !write);
+    if (!p) {
+        debug_printf(DISK, DETAIL,
+                "%s: buffer %08x-%08x is not in RAM\n",
+                d->file, d->addr, d->addr + (uint32_t)len);
+        return 1;
+    }
+
+    off = (off_t)d->sector * DISK_SECTOR_SIZE;
+    debug_printf(DISK, DETAIL, "%s: %s %u sectors at %u %s %08x\n",
+            d->file, write ? "writing" : "reading", d->count, d->sector,
+            write ? "from" : "to", d->addr);
+
+    while (len > 0) {
+        ret = write ? pwrite(d->fd, p, len, off) : pread(d->fd, p, len, off);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            debug_printf(DISK, ERROR, "%s: %s\n", d->file, strerror(errno));
+            return 1;
+        } else if (ret == 0) {
+            debug_printf(DISK, ERROR, "%s: unexpected EOF\n", d->file);
+            return 1;
+        }
+        p += ret;
+        off += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
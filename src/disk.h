@@ -0,0 +1,42 @@
+#ifndef DISK_H
+#define DISK_H
+
+#include "mem.h"
+#include "mem_dev.h"
+
+/*
+ Register layout (word offsets from the base address):
+   0x00 SECTOR   (RW) First sector of the transfer.
+   0x04 COUNT    (RW) Number of sectors to transfer.
+   0x08 ADDR     (RW) Physical address of the buffer in guest RAM.
+   0x0C CMD      (W)  DISK_CMD_READ or DISK_CMD_WRITE; starts the transfer.
+        STATUS   (R)  DISK_STATUS_ERROR if the last transfer failed.
+   0x10 SECTORS  (R)  Size of the disk, in sectors.
+
+ Transfers complete before the write to CMD does, so there is no busy state.
+ */
+enum {
+    DISK_SECTOR  = 0x00,
+    DISK_COUNT   = 0x04,
+    DISK_ADDR    = 0x08,
+    DISK_CMD     = 0x0C,
+    DISK_STATUS  = 0x0C,
+    DISK_SECTORS = 0x10,
+    DISK_SIZE    = 0x14
+};
+
+enum {
+    DISK_CMD_READ  = 1,
+    DISK_CMD_WRITE = 2
+};
+
+enum {
+    DISK_STATUS_ERROR = 1 << 0
+};
+
+#define DISK_SECTOR_SIZE 512
+
+mem_dev_t *disk_create(mem_t *mem, char *file);
+void disk_destroy(mem_dev_t *dev);
+
+#endif
@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "dram.h"
+#include "util.h"
+
+/*
+ Each access moves one burst.  Consecutive bursts are interleaved across
+ channels, then banks, so streams spread out; everything above that picks
+ the row.  Timing is per access and doesn't model contention between
+ accesses: a row hit costs tCAS, an access to a precharged bank tRCD + tCAS,
+ and a row conflict tRP + tRCD + tCAS, all plus the burst transfer.
+ */
+#define DRAM_BURST 64
+#define DRAM_BURST_CYCLES 4
+#define DRAM_NO_ROW UINT32_MAX
+
+struct dram {
+    unsigned channels;
+    unsigned banks;
+    uint32_t row;
+    int policy;
+    unsigned trcd, tcas, trp;
+
+    unsigned chan_shift;
+    unsigned bank_shift;
+    unsigned row_shift;
+    uint32_t *open;             /* Open row, by channel * banks + bank. */
+
+    uint64_t reads, writes;
+    uint64_t hits, empties, conflicts;
+    uint64_t *chan_accesses;
+};
+
+static int log2_exact(unsigned long v);
+
+dram_t *dram_create(unsigned channels, unsigned banks, uint32_t row,
+                    int policy, unsigned trcd, unsigned tcas, unsigned trp)
+{
+    dram_t *d;
+    unsigned i;
+
+    assert((log2_exact(channels) >= 0) && (log2_exact(banks) >= 0));
+    assert((log2_exact(row) >= 0) && (row >= DRAM_BURST));
+
+    d = xmalloc(sizeof(*d));
+    d->channels = channels;
+    d->banks = banks;
+    d->row = row;
+    d->policy = policy;
+    d->trcd = trcd;
+    d->tcas = tcas;
+    d->trp = trp;
+
+    d->chan_shift = log2_exact(DRAM_BURST);
+    d->bank_shift = d->chan_shift + log2_exact(channels);
+    d->row_shift = d->bank_shift + log2_exact(banks) +
+                   log2_exact(row / DRAM_BURST);
+
+    d->open = xmalloc(channels * banks * sizeof(*d->open));
+    for (i = 0; i < channels * banks; i++) {
+        d->open[i] = DRAM_NO_ROW;
+    }
+    d->chan_accesses = xmalloc(channels * sizeof(*d->chan_accesses));
+    memset(d->chan_accesses, 0, channels * sizeof(*d->chan_accesses));
+    d->reads = d->writes = 0;
+    d->hits = d->empties = d->conflicts = 0;
+
+    return d;
+}
+
+/*
+ spec is <channels>:<banks>:<policy>:<tRCD>:<tCAS>:<tRP>[:<row>], where
+ policy is open or closed, timings are in core cycles and row is the row
+ size in bytes (default 2k).
+ */
+dram_t *dram_create_spec(char *spec)
+{
+    char buf[64], *field[7], *p, *end;
+    unsigned long v[7];
+    int policy, n = 0, i;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        goto bad;
+    }
+    strcpy(buf, spec);
+    for (p = strtok(buf, ":"); p; p = strtok(NULL, ":")) {
+        if (n == 7) {
+            goto bad;
+        }
+        field[n++] = p;
+    }
+    if (n < 6) {
+        goto bad;
+    }
+
+    if (!strcmp(field[2], "open")) {
+        policy = DRAM_OPEN_PAGE;
+    } else if (!strcmp(field[2], "closed")) {
+        policy = DRAM_CLOSED_PAGE;
+    } else {
+        goto bad;
+    }
+    v[6] = 2048;
+    for (i = 0; i < n; i++) {
+        if (i == 2) {
+            continue;
+        }
+        v[i] = strtoul(field[i], &end, 0);
+        if ((i == 6) && (end != field[i]) && (*end == 'k')) {
+            v[i] *= 1024;
+            end++;
+        }
+        if ((end == field[i]) || *end) {
+            goto bad;
+        }
+    }
+    if ((log2_exact(v[0]) < 0) || (log2_exact(v[1]) < 0) ||
+        (log2_exact(v[6]) < 0) || (v[6] < DRAM_BURST) ||
+        (v[0] * v[1] > 1024) || (v[3] > 1000) || (v[4] > 1000) ||
+        (v[5] > 1000)) {
+        goto bad;
+    }
+
+    return dram_create(v[0], v[1], v[6], policy, v[3], v[4], v[5]);
+
+bad:
+    debug_printf(CONFIG, FATAL,
+            "--dram: invalid spec \"%s\" (expected <channels>:<banks>:"
+            "open|closed:<tRCD>:<tCAS>:<tRP>[:<row>], powers of two)\n",
+            spec);
+    return NULL;
+}
+
+void dram_destroy(dram_t *d)
+{
+    free(d->open);
+    free(d->chan_accesses);
+    free(d);
+}
+
+/* Returns the latency of moving the burst containing addr, in cycles. */
+unsigned dram_access(dram_t *d, uint32_t addr, int write)
+{
+    unsigned chan = (addr >> d->chan_shift) & (d->channels - 1);
+    unsigned bank = (addr >> d->bank_shift) & (d->banks - 1);
+    uint32_t row = addr >> d->row_shift;
+    uint32_t *open = &d->open[chan * d->banks + bank];
+    unsigned lat;
+
+    if (write) {
+        d->writes++;
+    } else {
+        d->reads++;
+    }
+    d->chan_accesses[chan]++;
+
+    if (*open == row) {
+        d->hits++;
+        lat = d->tcas;
+    } else if (*open == DRAM_NO_ROW) {
+        d->empties++;
+        lat = d->trcd + d->tcas;
+    } else {
+        d->conflicts++;
+        lat = d->trp + d->trcd + d->tcas;
+    }
+    *open = (d->policy == DRAM_OPEN_PAGE) ? row : DRAM_NO_ROW;
+
+    return lat + DRAM_BURST_CYCLES;
+}
+
+/* cycles is the run time according to the timing model, or 0 if none. */
+void dram_report(dram_t *d, FILE *out, uint64_t cycles)
+{
+    uint64_t accesses = d->reads + d->writes;
+    uint64_t bytes = accesses * DRAM_BURST;
+    unsigned i;
+
+    fprintf(out, "dram: %u channels, %u banks, %u-byte rows, %s page, "
+            "tRCD %u tCAS %u tRP %u\n",
+            d->channels, d->banks, d->row,
+            (d->policy == DRAM_OPEN_PAGE) ? "open" : "closed",
+            d->trcd, d->tcas, d->trp);
+    fprintf(out, "dram: %llu accesses (%llu reads, %llu writes), "
+            "row hits %llu (%.2f%%), empty %llu, conflicts %llu\n",
+            (unsigned long long)accesses, (unsigned long long)d->reads,
+            (unsigned long long)d->writes, (unsigned long long)d->hits,
+            accesses ? 100.0 * d->hits / accesses : 0.0,
+            (unsigned long long)d->empties,
+            (unsigned long long)d->conflicts);
+    fprintf(out, "dram: %llu bytes", (unsigned long long)bytes);
+    if (cycles) {
+        fprintf(out, " in %llu cycles, %.3f bytes/cycle",
+                (unsigned long long)cycles, (double)bytes / cycles);
+    }
+    fprintf(out, "; per channel:");
+    for (i = 0; i < d->channels; i++) {
+        fprintf(out, " %llu", (unsigned long long)d->chan_accesses[i]);
+    }
+    fprintf(out, "\n");
+}
+
+/* Returns log2(v) if v is a power of two, or -1. */
+static int log2_exact(unsigned long v)
+{
+    int n = 0;
+
+    if (!v || (v & (v - 1))) {
+        return -1;
+    }
+    while (v > 1) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
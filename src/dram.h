@@ -0,0 +1,21 @@
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct dram dram_t;
+
+enum {
+    DRAM_OPEN_PAGE,         /* Rows stay open until a conflict. */
+    DRAM_CLOSED_PAGE        /* Rows are precharged after every access. */
+};
+
+dram_t *dram_create(unsigned channels, unsigned banks, uint32_t row,
+                    int policy, unsigned trcd, unsigned tcas, unsigned trp);
+dram_t *dram_create_spec(char *spec);
+void dram_destroy(dram_t *d);
+unsigned dram_access(dram_t *d, uint32_t addr, int write);
+void dram_report(dram_t *d, FILE *out, uint64_t cycles);
+
+#endif
@@ -0,0 +1,436 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "core_cp0.h"
+#include "core_priv.h"
+#include "dump.h"
+#include "mem.h"
+#include "mem_dev.h"
+#include "util.h"
+
+#define DUMP_MAGIC "TMIPSDP1"
+
+enum {
+    FIELD_PC,
+    FIELD_HI,
+    FIELD_LO,
+    FIELD_R0,
+    FIELD_CP0 = FIELD_R0 + 32,
+    FIELD_TLB = FIELD_CP0 + DUMP_NUM_CP0
+};
+
+static const struct {
+    int reg;
+    const char *name;
+} cp0_fields[DUMP_NUM_CP0] = {
+    { CP0_STATUS, "status" },
+    { CP0_EPC, "epc" },
+    { CP0_CAUSE, "cause" },
+    { CP0_BADVADDR, "badvaddr" },
+    { CP0_INDEX, "index" },
+    { CP0_RANDOM, "random" },
+    { CP0_ENTRYHI, "entryhi" },
+    { CP0_ENTRYLO, "entrylo" }
+};
+
+static char names[DUMP_NUM_FIELDS][12];
+
+static char *read_all(FILE *f, size_t *len_out);
+static int read_bin(dump_t *d, const char *buf, size_t len);
+static int read_json(dump_t *d, const char *p, char *seen);
+static int read_text(dump_t *d, const char *p, char *seen);
+static int set_field(dump_t *d, const char *name, uint32_t val, char *seen);
+static dump_region_t *add_region(dump_t *d);
+static uint64_t parse_hash(const char *p);
+static uint64_t fnv1a(const uint8_t *p, uint32_t len);
+
+/* With mem, also hashes every RAM region. */
+void dump_capture(dump_t *d, core_t *core, mem_t *mem)
+{
+    mem_region_t *r;
+    mem_dev_t *dev;
+    dump_region_t *dr;
+    void *p;
+    int i;
+
+    d->field[FIELD_PC] = core->pc;
+    d->field[FIELD_HI] = core->hi;
+    d->field[FIELD_LO] = core->lo;
+    for (i = 0; i < 32; i++) {
+        d->field[FIELD_R0 + i] = core->r[i];
+    }
+    for (i = 0; i < DUMP_NUM_CP0; i++) {
+        d->field[FIELD_CP0 + i] = core->cp0.r[cp0_fields[i].reg];
+    }
+    for (i = 0; i < CP0_TLB_SIZE; i++) {
+        d->field[FIELD_TLB + 2 * i] = core->cp0.tlb[i].tag;
+        d->field[FIELD_TLB + 2 * i + 1] = core->cp0.tlb[i].data;
+    }
+
+    d->nregions = 0;
+    d->regions = NULL;
+    for (r = mem ? mem_first_region(mem) : NULL; r; r = mem_next_region(r)) {
+        dev = mem_region_dev(r);
+        if (!dev->map) {
+            continue;
+        }
+        p = mem_map_host(mem, mem_region_base(r), dev->size, 0);
+        if (p) {
+            dr = add_region(d);
+            dr->base = mem_region_base(r);
+            dr->size = dev->size;
+            dr->hash = fnv1a(p, dev->size);
+        }
+    }
+}
+
+void dump_free(dump_t *d)
+{
+    free(d->regions);
+    d->regions = NULL;
+    d->nregions = 0;
+}
+
+/*
+ The text format is the one core_dump_regs has always written, plus a line
+ per region hash; JSON is one object with a key per field; and the binary
+ format is the header and then the fields, in host byte order.
+ */
+void dump_write(dump_t *d, FILE *f, int format)
+{
+    uint32_t *v = d->field, hdr[2];
+    unsigned i;
+
+    switch (format) {
+    case DUMP_TEXT:
+        fprintf(f, "PC =%08x  HI =%08x  LO =%08x\n",
+                v[FIELD_PC], v[FIELD_HI], v[FIELD_LO]);
+        for (i = 0; i < 32; i++) {
+            fprintf(f, "R%-2d=%08x  %s", i, v[FIELD_R0 + i],
+                    (i % 4 == 3) ? "\n" : "");
+        }
+        fprintf(f, "STATUS=%08x  EPC=%08x  CAUSE=%08x  BADVADDR=%08x\n",
+                v[FIELD_CP0], v[FIELD_CP0 + 1], v[FIELD_CP0 + 2],
+                v[FIELD_CP0 + 3]);
+        fprintf(f, "INDEX=%08x  RANDOM=%08x  ENTRYHI=%08x  ENTRYLO=%08x\n",
+                v[FIELD_CP0 + 4], v[FIELD_CP0 + 5], v[FIELD_CP0 + 6],
+                v[FIELD_CP0 + 7]);
+        for (i = 0; i < CP0_TLB_SIZE; i += 2) {
+            fprintf(f, "TLB[%02d]=%08x:%08x  TLB[%02d]=%08x:%08x\n",
+                    i, v[FIELD_TLB + 2 * i], v[FIELD_TLB + 2 * i + 1],
+                    i + 1, v[FIELD_TLB + 2 * i + 2], v[FIELD_TLB + 2 * i + 3]);
+        }
+        for (i = 0; i < d->nregions; i++) {
+            fprintf(f, "RAM[%08x+%08x]=%016llx\n", d->regions[i].base,
+                    d->regions[i].size,
+                    (unsigned long long)d->regions[i].hash);
+        }
+        break;
+    case DUMP_JSON:
+        fprintf(f, "{\n");
+        for (i = 0; i < DUMP_NUM_FIELDS; i++) {
+            fprintf(f, "  \"%s\": %lu,\n", dump_field_name(i),
+                    (unsigned long)v[i]);
+        }
+        fprintf(f, "  \"ram\": [");
+        for (i = 0; i < d->nregions; i++) {
+            fprintf(f, "%s\n    {\"base\": %lu, \"size\": %lu, "
+                    "\"hash\": \"%016llx\"}", i ? "," : "",
+                    (unsigned long)d->regions[i].base,
+                    (unsigned long)d->regions[i].size,
+                    (unsigned long long)d->regions[i].hash);
+        }
+        fprintf(f, "%s]\n}\n", d->nregions ? "\n  " : "");
+        break;
+    case DUMP_BIN:
+        hdr[0] = DUMP_NUM_FIELDS;
+        hdr[1] = d->nregions;
+        fwrite(DUMP_MAGIC, 8, 1, f);
+        fwrite(hdr, sizeof(hdr), 1, f);
+        fwrite(v, sizeof(d->field), 1, f);
+        for (i = 0; i < d->nregions; i++) {
+            fwrite(&d->regions[i].base, 4, 1, f);
+            fwrite(&d->regions[i].size, 4, 1, f);
+            fwrite(&d->regions[i].hash, 8, 1, f);
+        }
+        break;
+    }
+}
+
+/*
+ Reads a dump in any of the formats.  Returns nonzero if it isn't one,
+ including a text or JSON dump that is missing any of the fields.
+ */
+int dump_read(dump_t *d, FILE *f)
+{
+    char seen[DUMP_NUM_FIELDS];
+    char *buf;
+    size_t len;
+    unsigned i;
+    int ret;
+
+    memset(d->field, 0, sizeof(d->field));
+    d->nregions = 0;
+    d->regions = NULL;
+
+    buf = read_all(f, &len);
+    if (!buf) {
+        return 1;
+    }
+    memset(seen, 0, sizeof(seen));
+    if ((len >= 8) && !memcmp(buf, DUMP_MAGIC, 8)) {
+        ret = read_bin(d, buf, len);
+        memset(seen, 1, sizeof(seen));
+    } else if (buf[strspn(buf, " \t\r\n")] == '{') {
+        ret = read_json(d, buf, seen);
+    } else {
+        ret = read_text(d, buf, seen);
+    }
+    free(buf);
+    for (i = 0; !ret && (i < DUMP_NUM_FIELDS); i++) {
+        ret = !seen[i];
+    }
+    if (ret) {
+        dump_free(d);
+    }
+    return ret;
+}
+
+const char *dump_field_name(unsigned i)
+{
+    unsigned j;
+
+    if (!names[0][0]) {
+        strcpy(names[FIELD_PC], "pc");
+        strcpy(names[FIELD_HI], "hi");
+        strcpy(names[FIELD_LO], "lo");
+        for (j = 0; j < 32; j++) {
+            sprintf(names[FIELD_R0 + j], "r%u", j);
+        }
+        for (j = 0; j < DUMP_NUM_CP0; j++) {
+            strcpy(names[FIELD_CP0 + j], cp0_fields[j].name);
+        }
+        for (j = 0; j < CP0_TLB_SIZE; j++) {
+            sprintf(names[FIELD_TLB + 2 * j], "tlb%u_hi", j);
+            sprintf(names[FIELD_TLB + 2 * j + 1], "tlb%u_lo", j);
+        }
+    }
+    return (i < DUMP_NUM_FIELDS) ? names[i] : NULL;
+}
+
+int dump_find_field(const char *name)
+{
+    int i;
+
+    for (i = 0; i < DUMP_NUM_FIELDS; i++) {
+        if (!strcmp(name, dump_field_name(i))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Returns the whole file, NUL-terminated, or NULL if it can't be read. */
+static char *read_all(FILE *f, size_t *len_out)
+{
+    size_t len = 0, cap = 4096, n;
+    char *buf = xmalloc(cap);
+
+    while ((n = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (len + 1 == cap) {
+            cap *= 2;
+            buf = xrealloc(buf, cap);
+        }
+    }
+    if (ferror(f)) {
+        free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    *len_out = len;
+    return buf;
+}
+
+static int read_bin(dump_t *d, const char *buf, size_t len)
+{
+    uint32_t hdr[2];
+    dump_region_t *r;
+    size_t need;
+    unsigned i;
+
+    if (len < 8 + sizeof(hdr)) {
+        return 1;
+    }
+    memcpy(hdr, buf + 8, sizeof(hdr));
+    need = 8 + sizeof(hdr) + sizeof(d->field) + (size_t)hdr[1] * 16;
+    if ((hdr[0] != DUMP_NUM_FIELDS) || (len < need)) {
+        return 1;
+    }
+    buf += 8 + sizeof(hdr);
+    memcpy(d->field, buf, sizeof(d->field));
+    buf += sizeof(d->field);
+    for (i = 0; i < hdr[1]; i++, buf += 16) {
+        r = add_region(d);
+        memcpy(&r->base, buf, 4);
+        memcpy(&r->size, buf + 4, 4);
+        memcpy(&r->hash, buf + 8, 8);
+    }
+    return 0;
+}
+
+/*
+ Not a general JSON parser: it takes "key": number pairs for the fields and
+ the objects in the "ram" array for the regions, and skips anything else.
+ */
+static int read_json(dump_t *d, const char *p, char *seen)
+{
+    char key[32];
+    const char *end;
+    dump_region_t *r = NULL;
+    int in_ram = 0;
+    size_t n;
+
+    while (*p) {
+        if (*p == '"') {
+            end = strchr(p + 1, '"');
+            if (!end) {
+                return 1;
+            }
+            n = end - (p + 1);
+            if (n >= sizeof(key)) {
+                n = sizeof(key) - 1;
+            }
+            memcpy(key, p + 1, n);
+            key[n] = '\0';
+            p = end + 1 + strspn(end + 1, " \t\r\n");
+            if (*p != ':') {
+                continue;
+            }
+            p += 1 + strspn(p + 1, " \t\r\n");
+            if (!strcmp(key, "ram")) {
+                in_ram = 1;
+            } else if (in_ram && r && !strcmp(key, "hash")) {
+                r->hash = parse_hash(p + 1);
+            } else if (in_ram && r && !strcmp(key, "base")) {
+                r->base = strtoul(p, NULL, 10);
+            } else if (in_ram && r && !strcmp(key, "size")) {
+                r->size = strtoul(p, NULL, 10);
+            } else if (isdigit((unsigned char)*p)) {
+                set_field(d, key, strtoul(p, NULL, 10), seen);
+            }
+        } else if (*p == '{' && in_ram) {
+            r = add_region(d);
+            r->base = r->size = 0;
+            r->hash = 0;
+            p++;
+        } else if (*p == ']') {
+            in_ram = 0;
+            p++;
+        } else {
+            p++;
+        }
+    }
+    return 0;
+}
+
+/* Takes NAME=value pairs, in upper or lower case, wherever they are. */
+static int read_text(dump_t *d, const char *buf, char *seen)
+{
+    const char *p = buf, *eq, *start;
+    char name[32], field[16];
+    unsigned long tlb, base, size;
+    dump_region_t *r;
+    size_t n;
+    char *end;
+    uint32_t val;
+
+    while ((eq = strchr(p, '=')) != NULL) {
+        /* The name ends at the '=', give or take padding. */
+        for (start = eq; (start > buf) && (start[-1] == ' '); start--)
+            ;
+        n = 0;
+        while ((start > buf) && !isspace((unsigned char)start[-1]) &&
+               (n < sizeof(name) - 1)) {
+            start--;
+            n++;
+        }
+        for (n = 0; (start + n < eq) && (start[n] != ' ') &&
+                    (n < sizeof(name) - 1); n++) {
+            name[n] = (char)tolower((unsigned char)start[n]);
+        }
+        name[n] = '\0';
+        p = eq + 1;
+
+        if (sscanf(name, "ram[%lx+%lx]", &base, &size) == 2) {
+            r = add_region(d);
+            r->base = (uint32_t)base;
+            r->size = (uint32_t)size;
+            r->hash = parse_hash(p);
+            continue;
+        }
+        val = strtoul(p, &end, 16);
+        if (end == p) {
+            continue;
+        }
+        if (sscanf(name, "tlb[%lu]", &tlb) == 1) {
+            sprintf(field, "tlb%lu_hi", tlb);
+            set_field(d, field, val, seen);
+            if (*end == ':') {
+                sprintf(field, "tlb%lu_lo", tlb);
+                set_field(d, field, strtoul(end + 1, &end, 16), seen);
+            }
+        } else {
+            set_field(d, name, val, seen);
+        }
+        p = end;
+    }
+    return 0;
+}
+
+static int set_field(dump_t *d, const char *name, uint32_t val, char *seen)
+{
+    int i = dump_find_field(name);
+
+    if (i < 0) {
+        return 1;
+    }
+    d->field[i] = val;
+    seen[i] = 1;
+    return 0;
+}
+
+static dump_region_t *add_region(dump_t *d)
+{
+    d->regions = xrealloc(d->regions,
+                          (d->nregions + 1) * sizeof(*d->regions));
+    return &d->regions[d->nregions++];
+}
+
+/* Hashes are 16 hex digits, too many for strtoul on 32-bit hosts. */
+static uint64_t parse_hash(const char *p)
+{
+    uint64_t h = 0;
+    int i;
+
+    for (i = 0; i < 16 && isxdigit((unsigned char)p[i]); i++) {
+        h = (h << 4) | (uint64_t)(isdigit((unsigned char)p[i])
+                ? p[i] - '0' : tolower((unsigned char)p[i]) - 'a' + 10);
+    }
+    return h;
+}
+
+static uint64_t fnv1a(const uint8_t *p, uint32_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
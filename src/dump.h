@@ -0,0 +1,50 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "core.h"
+#include "core_cp0.h"
+#include "mem.h"
+
+/*
+ The machine's final state, for graders to check against a reference.  It
+ is a fixed list of 32-bit fields, each with a name that is also its JSON
+ key and what dumpcmp's masks refer to: pc, hi, lo, r0-r31, the CP0
+ registers (status, epc, cause, badvaddr, index, random, entryhi, entrylo),
+ and tlb0_hi, tlb0_lo, ..., tlb31_lo.  Optionally it also holds a hash of
+ each RAM region.
+ */
+enum {
+    DUMP_TEXT,
+    DUMP_JSON,
+    DUMP_BIN
+};
+
+#define DUMP_NUM_CP0 8
+#define DUMP_NUM_FIELDS (3 + 32 + DUMP_NUM_CP0 + 2 * CP0_TLB_SIZE)
+
+typedef struct dump dump_t;
+typedef struct dump_region dump_region_t;
+
+struct dump_region {
+    uint32_t base;
+    uint32_t size;
+    uint64_t hash;          /* 64-bit FNV-1a of the contents. */
+};
+
+struct dump {
+    uint32_t field[DUMP_NUM_FIELDS];
+    unsigned nregions;
+    dump_region_t *regions;
+};
+
+void dump_capture(dump_t *d, core_t *core, mem_t *mem);
+void dump_free(dump_t *d);
+void dump_write(dump_t *d, FILE *f, int format);
+int dump_read(dump_t *d, FILE *f);
+const char *dump_field_name(unsigned i);
+int dump_find_field(const char *name);
+
+#endif
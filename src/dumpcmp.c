@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+
+/*
+ Checks final-state dumps (written by tmips --dump-format, in any format)
+ against a reference.
+
+ usage: dumpcmp [-q] [-x <field>[:<bits>]]... <reference> <dump>...
+
+ -x leaves out a field, or with <bits> (in hex) just those bits of it.  A
+ field is a name from dump.h, or one of the groups "r" (all GPRs), "cp0",
+ "tlb" and "ram" (every region hash).  -q only sets the exit status: 0 if
+ every dump matches, 1 if one doesn't, and 2 on errors.
+ */
+static uint32_t care[DUMP_NUM_FIELDS];
+static int care_ram = 1;
+
+static int ignore(char *spec);
+static int load(char *file, dump_t *d);
+static int compare(char *file, dump_t *ref, dump_t *d, int quiet);
+static void usage(char *progn);
+
+int main(int argc, char *argv[])
+{
+    dump_t ref, d;
+    int i, quiet = 0, ret = 0;
+
+    for (i = 0; i < DUMP_NUM_FIELDS; i++) {
+        care[i] = 0xFFFFFFFF;
+    }
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+        if (!strcmp(argv[i], "-q")) {
+            quiet = 1;
+        } else if (!strcmp(argv[i], "-x") && (i + 1 < argc)) {
+            if (ignore(argv[++i])) {
+                return 2;
+            }
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc - i < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (load(argv[i], &ref)) {
+        return 2;
+    }
+    for (i++; i < argc; i++) {
+        if (load(argv[i], &d)) {
+            ret = 2;
+            continue;
+        }
+        if (compare(argv[i], &ref, &d, quiet) && !ret) {
+            ret = 1;
+        }
+        dump_free(&d);
+    }
+    dump_free(&ref);
+
+    return ret;
+}
+
+static int ignore(char *spec)
+{
+    uint32_t bits = 0xFFFFFFFF;
+    char *colon, *end;
+    int i, first, last;
+
+    colon = strchr(spec, ':');
+    if (colon) {
+        *colon = '\0';
+        bits = strtoul(colon + 1, &end, 16);
+        if ((end == colon + 1) || *end) {
+            fprintf(stderr, "dumpcmp: invalid bits \"%s\"\n", colon + 1);
+            return 1;
+        }
+    }
+
+    if (!strcmp(spec, "ram")) {
+        care_ram = 0;
+        return 0;
+    } else if (!strcmp(spec, "r")) {
+        first = dump_find_field("r0");
+        last = dump_find_field("r31");
+    } else if (!strcmp(spec, "cp0")) {
+        first = dump_find_field("status");
+        last = dump_find_field("entrylo");
+    } else if (!strcmp(spec, "tlb")) {
+        first = dump_find_field("tlb0_hi");
+        last = DUMP_NUM_FIELDS - 1;
+    } else {
+        first = last = dump_find_field(spec);
+        if (first < 0) {
+            fprintf(stderr, "dumpcmp: unknown field \"%s\"\n", spec);
+            return 1;
+        }
+    }
+    for (i = first; i <= last; i++) {
+        care[i] &= ~bits;
+    }
+    return 0;
+}
+
+static int load(char *file, dump_t *d)
+{
+    FILE *f;
+    int ret;
+
+    f = fopen(file, "rb");
+    if (!f) {
+        fprintf(stderr, "dumpcmp: %s: %s\n", file, strerror(errno));
+        return 1;
+    }
+    ret = dump_read(d, f);
+    fclose(f);
+    if (ret) {
+        fprintf(stderr, "dumpcmp: %s: not a tmips dump\n", file);
+    }
+    return ret;
+}
+
+/* Returns nonzero if d differs from ref in any bit we care about. */
+static int compare(char *file, dump_t *ref, dump_t *d, int quiet)
+{
+    unsigned i, j;
+    int diff = 0;
+
+    for (i = 0; i < DUMP_NUM_FIELDS; i++) {
+        if ((ref->field[i] ^ d->field[i]) & care[i]) {
+            if (quiet) {
+                return 1;
+            }
+            printf("%s: %s: %08lx, expected %08lx\n", file,
+                   dump_field_name(i), (unsigned long)d->field[i],
+                   (unsigned long)ref->field[i]);
+            diff = 1;
+        }
+    }
+    if (!care_ram) {
+        return diff;
+    }
+
+    /* Regions are matched up by address and size. */
+    for (i = 0; i < ref->nregions; i++) {
+        for (j = 0; j < d->nregions; j++) {
+            if ((d->regions[j].base == ref->regions[i].base) &&
+                (d->regions[j].size == ref->regions[i].size)) {
+                break;
+            }
+        }
+        if ((j < d->nregions) &&
+            (d->regions[j].hash == ref->regions[i].hash)) {
+            continue;
+        }
+        if (quiet) {
+            return 1;
+        }
+        printf("%s: ram %08lx+%08lx: %s\n", file,
+               (unsigned long)ref->regions[i].base,
+               (unsigned long)ref->regions[i].size,
+               (j < d->nregions) ? "contents differ" : "missing");
+        diff = 1;
+    }
+    return diff;
+}
+
+static void usage(char *progn)
+{
+    fprintf(stderr,
+        "usage: %s [-q] [-x <field>[:<bits>]]... <reference> <dump>...\n"
+        "\n"
+        "Compares tmips final-state dumps (text, JSON or binary) with a\n"
+        "reference dump.  -x leaves out a field (pc, hi, lo, r0-r31, status,\n"
+        "epc, cause, badvaddr, index, random, entryhi, entrylo, tlb0_hi ...\n"
+        "tlb31_lo, or the groups r, cp0, tlb and ram), or only the given\n"
+        "bits of it, in hex.  -q just sets the exit status: 0 if every dump\n"
+        "matches, 1 if any differs and 2 on errors.\n", progn);
+}
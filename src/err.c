@@ -4,4 +4,11 @@ const char *err_text[] = {
     [ERR_TESTDONE] = "TESTDONE called",
     [ERR_EXC] = "Unhandled exception",
     [ERR_EXC_FLOOD] = "Exception flood",
+    [ERR_IDLE] = "Idle loop with no pending events",
+    [ERR_EXIT] = "Program exited",
+    [ERR_BREAK] = "Breakpoint",
+    [ERR_WATCH] = "Watchpoint",
+    [ERR_KILLED] = "Killed by debugger",
+    [ERR_DIVERGED] = "Diverged from commit trace",
+    [ERR_TRACE_END] = "End of commit trace",
 };
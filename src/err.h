@@ -5,9 +5,16 @@ enum {
     ERR_TESTDONE = 1,
     ERR_EXC,
     ERR_EXC_FLOOD,
+    ERR_IDLE,
+    ERR_EXIT,
+    ERR_BREAK,
+    ERR_WATCH,
+    ERR_KILLED,
+    ERR_DIVERGED,
+    ERR_TRACE_END,
     NUM_ERRS
 };
 
-const char *err_text[NUM_ERRS];
+extern const char *err_text[NUM_ERRS];
 
 #endif
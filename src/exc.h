@@ -25,6 +25,6 @@ enum {
     NUM_EXCS
 };
 
-const char *exc_text[NUM_EXCS];
+extern const char *exc_text[NUM_EXCS];
 
 #endif
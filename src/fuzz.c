@@ -0,0 +1,411 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "core_cp0.h"
+#include "core_priv.h"
+#include "debug.h"
+#include "mem.h"
+#include "mem_dev.h"
+#include "opcode.h"
+#include "ram.h"
+#include "util.h"
+
+/*
+ Runs the core on random instructions and register states and checks that
+ $0 stays zero, that the host doesn't crash, and that running the same
+ input twice gives the same registers, CP0 state and memory.
+
+ usage: fuzz [-n <inputs>] [-s <seed>] [-f <first>] [-t <steps>]
+
+ Input i depends only on the seed and i, so "-f i -n 1" runs just it again.
+ Between runs the machine goes back to a snapshot taken once at the start:
+ core_restore for the core, and only the RAM pages the run dirtied, so a
+ reset costs a few page copies rather than a core_reset and ram_create.
+ */
+#define RAM_SIZE 0x10000
+#define RAM_PAGES (RAM_SIZE / MEM_DEV_PAGE)
+#define CODE_VA 0x80001000
+#define CODE_WORDS 32
+#define TESTDONE_INS ((OP_SPECIAL << 26) | FUNCT_TESTDONE)
+
+/*
+ The exception handler steps over the instruction that raised it, so a run
+ carries on past the faults most random instructions cause.
+ */
+static const uint32_t handler[] = {
+    0x401A7000,                 /* mfc0 $k0, $epc */
+    0x275A0004,                 /* addiu $k0, $k0, 4 */
+    0x409A7000,                 /* mtc0 $k0, $epc */
+    0x42000018                  /* eret */
+};
+
+typedef struct fuzz_input fuzz_input_t;
+typedef struct fuzz_result fuzz_result_t;
+
+struct fuzz_input {
+    uint32_t ins[CODE_WORDS];
+    uint32_t r[NUM_REGS];
+    uint32_t hi;
+    uint32_t lo;
+};
+
+struct fuzz_result {
+    int ret;
+    uint32_t r0;                /* What $0 became, if not zero. */
+    unsigned steps;
+    void *state;                /* core_save */
+    uint32_t dirty[(RAM_PAGES + 31) / 32];
+    uint8_t *pages;             /* The dirtied pages' contents. */
+};
+
+static core_t *core;
+static mem_dev_t *ram;
+static uint8_t *ram_data;
+static uint8_t *pristine;
+static void *snapshot;
+static unsigned max_steps = 64;
+static volatile unsigned long current;
+
+static void gen_input(fuzz_input_t *in, uint64_t seed, unsigned long i);
+static uint32_t gen_ins(uint64_t v);
+static uint64_t next_rand(uint64_t *s);
+static void run(const fuzz_input_t *in, fuzz_result_t *res);
+static void reset(void);
+static int same(const fuzz_result_t *a, const fuzz_result_t *b);
+static void print_input(unsigned long i, const fuzz_input_t *in);
+static void on_crash(int sig);
+static double now(void);
+
+int main(int argc, char *argv[])
+{
+    static const int sigs[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+    struct sigaction sa;
+    mem_t *mem;
+    uint32_t *words;
+    fuzz_input_t in;
+    fuzz_result_t res[2];
+    unsigned long i, first = 0, n = 1000000, failed = 0;
+    uint64_t seed = 1;
+    double start, elapsed;
+    int j;
+
+    for (j = 1; j < argc; j++) {
+        if ((j + 1 < argc) && !strcmp(argv[j], "-n")) {
+            n = strtoul(argv[++j], NULL, 0);
+        } else if ((j + 1 < argc) && !strcmp(argv[j], "-s")) {
+            seed = strtoul(argv[++j], NULL, 0);
+        } else if ((j + 1 < argc) && !strcmp(argv[j], "-f")) {
+            first = strtoul(argv[++j], NULL, 0);
+        } else if ((j + 1 < argc) && !strcmp(argv[j], "-t")) {
+            max_steps = strtoul(argv[++j], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-n <inputs>] [-s <seed>] "
+                    "[-f <first>] [-t <steps>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    debug_init();
+    debug_set_level(DEBUG_LEVEL_FATAL);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_crash;
+    sa.sa_flags = SA_RESETHAND;
+    for (j = 0; j < (int)(sizeof(sigs) / sizeof(sigs[0])); j++) {
+        sigaction(sigs[j], &sa, NULL);
+    }
+
+    mem = mem_create();
+    ram = ram_create(RAM_SIZE);
+    mem_map(mem, 0, ram);
+    ram_data = ram->map(ram, 0, RAM_SIZE, 0);
+    core = core_create(mem);
+    core_reset(core);
+
+    /*
+     Runs start in kernel mode.  Anything that strays out of the code hits a
+     TESTDONE, which ends it.
+     */
+    core->cp0.r[CP0_STATUS] = 0;
+    words = (uint32_t *)ram_data;
+    for (j = 0; j < RAM_SIZE / 4; j++) {
+        words[j] = TESTDONE_INS;
+    }
+    memcpy(words, handler, sizeof(handler));
+    memcpy(words + 0x180 / 4, handler, sizeof(handler));
+
+    pristine = xmalloc(RAM_SIZE);
+    memcpy(pristine, ram_data, RAM_SIZE);
+    memset(ram->dirty, 0, sizeof(res[0].dirty));
+    snapshot = xmalloc(core_state_size());
+    core_save(core, snapshot);
+    for (j = 0; j < 2; j++) {
+        res[j].state = xmalloc(core_state_size());
+        memset(res[j].state, 0, core_state_size());
+        res[j].pages = xmalloc(RAM_SIZE);
+    }
+
+    start = now();
+    for (i = first; i < first + n; i++) {
+        current = i;
+        gen_input(&in, seed, i);
+        run(&in, &res[0]);
+        run(&in, &res[1]);
+        if (res[0].r0 || res[1].r0) {
+            printf("input %lu: $0 written (%08lx)\n", i,
+                    (unsigned long)(res[0].r0 | res[1].r0));
+        } else if (!same(&res[0], &res[1])) {
+            printf("input %lu: runs differ\n", i);
+        } else {
+            continue;
+        }
+        print_input(i, &in);
+        failed++;
+    }
+    elapsed = now() - start;
+
+    printf("%lu inputs, %lu failed, %.0f runs/s\n", n, failed,
+            2 * n / elapsed);
+    return failed ? 1 : 0;
+}
+
+/* splitmix64, seeded from (seed, i) so each input stands on its own. */
+static void gen_input(fuzz_input_t *in, uint64_t seed, unsigned long i)
+{
+    uint64_t s = seed * 0x9E3779B97F4A7C15ull + i, v;
+    unsigned j;
+
+    for (j = 0; j < CODE_WORDS; j++) {
+        in->ins[j] = gen_ins(next_rand(&s));
+    }
+    for (j = 0; j < NUM_REGS; j++) {
+        v = next_rand(&s);
+        switch ((v >> 32) & 3) {
+        case 0:
+            in->r[j] = (uint32_t)v;
+            break;
+        case 1:
+        case 2:         /* Somewhere in RAM, through kseg0 or kseg1. */
+            in->r[j] = ((v & (1ull << 40)) ? 0xA0000000 : 0x80000000) |
+                    ((uint32_t)v & (RAM_SIZE - 4));
+            break;
+        default:        /* Small, for shifts, counts and offsets. */
+            in->r[j] = (uint32_t)(int8_t)v;
+            break;
+        }
+    }
+    in->r[0] = 0;
+    in->hi = (uint32_t)next_rand(&s);
+    in->lo = (uint32_t)next_rand(&s);
+}
+
+/*
+ An instruction word from 64 random bits: the low 32 as they are one time
+ in eight, otherwise with a real opcode and fields that mostly keep memory
+ accesses aligned and branches and jumps inside the code.
+ */
+static uint32_t gen_ins(uint64_t v)
+{
+    static const uint8_t ops[] = {
+        OP_SPECIAL, OP_SPECIAL, OP_SPECIAL, OP_SPECIAL, OP_REGIMM, OP_J,
+        OP_JAL, OP_BEQ, OP_BNE, OP_BLEZ, OP_BGTZ, OP_ADDI, OP_ADDIU,
+        OP_SLTI, OP_SLTIU, OP_ANDI, OP_ORI, OP_XORI, OP_LUI, OP_COP0,
+        OP_LB, OP_LH, OP_LW, OP_LBU, OP_LHU, OP_SB, OP_SH, OP_SW
+    };
+    static const uint8_t cop0_functs[] = {
+        CP0_FUNCT_TLBWI, CP0_FUNCT_TLBWR, CP0_FUNCT_ERET
+    };
+    uint32_t ins = (uint32_t)v, op;
+    uint32_t hi = (uint32_t)(v >> 32);
+
+    if (!(hi & 7)) {
+        return ins;
+    }
+    op = ops[(hi >> 3) % sizeof(ops)];
+    ins = (ins & 0x03FFFFFF) | (op << 26);
+    hi >>= 8;
+
+    switch (op) {
+    case OP_SPECIAL:
+        /* Random functs are mostly reserved; keep a few of those. */
+        if (hi & 7) {
+            ins = (ins & ~0x3Fu) | (FUNCT_SLL + (hi >> 3) % 044);
+        }
+        break;
+    case OP_REGIMM:
+    case OP_BEQ:
+    case OP_BNE:
+    case OP_BLEZ:
+    case OP_BGTZ:
+        ins = (ins & 0xFFFF0000) | ((uint16_t)((int)(hi & 15) - 8));
+        break;
+    case OP_J:
+    case OP_JAL:
+        ins = (ins & 0xFC000000) |
+                (((CODE_VA >> 2) + hi % CODE_WORDS) & 0x03FFFFFF);
+        break;
+    case OP_COP0:
+        switch (hi & 3) {
+        case 0:
+            ins = (ins & 0xFC1FFFFF) | (COP_MF << 21);
+            break;
+        case 1:
+            ins = (ins & 0xFC1FFFFF) | (COP_MT << 21);
+            break;
+        default:
+            ins = (op << 26) | (020 << 21) |
+                    cop0_functs[(hi >> 2) % sizeof(cop0_functs)];
+            break;
+        }
+        break;
+    case OP_LB:
+    case OP_LH:
+    case OP_LW:
+    case OP_LBU:
+    case OP_LHU:
+    case OP_SB:
+    case OP_SH:
+    case OP_SW:
+        if (hi & 3) {
+            ins = (ins & 0xFFFF0000) | ((uint16_t)((int)(hi & 0xFC) - 128));
+        }
+        break;
+    }
+    return ins;
+}
+
+static uint64_t next_rand(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/*
+ Runs in from the snapshot until it halts or max_steps, and leaves the
+ outcome in res, stopping early if $0 ever isn't zero.
+ */
+static void run(const fuzz_input_t *in, fuzz_result_t *res)
+{
+    uint32_t *code;
+    unsigned i;
+    int ret = 0;
+
+    reset();
+    code = ram->map(ram, CODE_VA & (RAM_SIZE - 1), sizeof(in->ins), 1);
+    memcpy(code, in->ins, sizeof(in->ins));
+    memcpy(core->r, in->r, sizeof(core->r));
+    core->hi = in->hi;
+    core->lo = in->lo;
+    core_set_pc(core, CODE_VA);
+
+    res->r0 = 0;
+    for (i = 0; (i < max_steps) && !ret; i++) {
+        ret = core_step(core);
+        if (core->r[0]) {
+            res->r0 = core->r[0];
+            break;
+        }
+    }
+    res->ret = ret;
+    res->steps = i;
+    core_save(core, res->state);
+    for (i = 0; i < RAM_PAGES; i++) {
+        if (ram->dirty[i / 32] & (1u << (i % 32))) {
+            memcpy(res->pages + i * MEM_DEV_PAGE,
+                   ram_data + i * MEM_DEV_PAGE, MEM_DEV_PAGE);
+        }
+    }
+    memcpy(res->dirty, ram->dirty, sizeof(res->dirty));
+}
+
+/* Puts back the core and just the pages written since the snapshot. */
+static void reset(void)
+{
+    unsigned i;
+
+    for (i = 0; i < RAM_PAGES; i++) {
+        if (ram->dirty[i / 32] & (1u << (i % 32))) {
+            memcpy(ram_data + i * MEM_DEV_PAGE, pristine + i * MEM_DEV_PAGE,
+                   MEM_DEV_PAGE);
+        }
+    }
+    memset(ram->dirty, 0, sizeof(((fuzz_result_t *)0)->dirty));
+    core_restore(core, snapshot);
+}
+
+static int same(const fuzz_result_t *a, const fuzz_result_t *b)
+{
+    unsigned i;
+
+    if ((a->ret != b->ret) || (a->steps != b->steps) ||
+        memcmp(a->state, b->state, core_state_size()) ||
+        memcmp(a->dirty, b->dirty, sizeof(a->dirty))) {
+        return 0;
+    }
+    for (i = 0; i < RAM_PAGES; i++) {
+        if ((a->dirty[i / 32] & (1u << (i % 32))) &&
+            memcmp(a->pages + i * MEM_DEV_PAGE, b->pages + i * MEM_DEV_PAGE,
+                   MEM_DEV_PAGE)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void print_input(unsigned long i, const fuzz_input_t *in)
+{
+    unsigned j;
+
+    for (j = 0; j < CODE_WORDS; j++) {
+        printf("  %08lx: %08lx", (unsigned long)(CODE_VA + 4 * j),
+                (unsigned long)in->ins[j]);
+        if (j % 4 == 3) {
+            printf("\n");
+        }
+    }
+    for (j = 0; j < NUM_REGS; j++) {
+        printf("  R%-2u=%08lx%s", j, (unsigned long)in->r[j],
+                (j % 4 == 3) ? "\n" : "");
+    }
+    printf("  HI =%08lx  LO =%08lx\n", (unsigned long)in->hi,
+            (unsigned long)in->lo);
+}
+
+/* Says which input crashed, with only async-signal-safe calls. */
+static void on_crash(int sig)
+{
+    char msg[64] = "fuzz: crashed on input ", *p = msg + strlen(msg);
+    char digits[24];
+    unsigned long i = current;
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + i % 10;
+        i /= 10;
+    } while (i);
+    while (n) {
+        *p++ = digits[--n];
+    }
+    *p++ = '\n';
+    write(STDERR_FILENO, msg, p - msg);
+    raise(sig);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,641 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "core_cp0.h"
+#include "debug.h"
+#include "err.h"
+#include "gdb.h"
+#include "rev.h"
+#include "trap.h"
+#include "util.h"
+
+#define PACKET_MAX 4096
+
+/* Steps to run between checks for GDB interrupting us. */
+#define POLL_STEPS 0x10000
+
+/* GDB's MIPS register numbering; we don't provide the FPU ones after PC. */
+enum {
+    GDB_SR = 32,
+    GDB_LO,
+    GDB_HI,
+    GDB_BAD,
+    GDB_CAUSE,
+    GDB_PC,
+    GDB_NUM_REGS
+};
+
+/* Why we stopped, besides the ERR_* codes from core_step. */
+enum {
+    STOP_STEP = 0,
+    STOP_INTERRUPT = -1,
+    STOP_HISTORY = -2
+};
+
+enum {
+    SIGINT_ = 2,
+    SIGTRAP_ = 5,
+    SIGSEGV_ = 11
+};
+
+struct gdb {
+    core_t *core;
+    rev_t *rev;
+    trap_t *trap;
+    int fd;
+    int halted;                 /* The core_step result we halted with. */
+
+    unsigned char buf[1024];
+    size_t len;
+    size_t pos;
+
+    char in[PACKET_MAX + 1];
+    char out[PACKET_MAX + 1];
+};
+
+static int open_socket(char *spec);
+static int get_char(gdb_t *g);
+static int get_packet(gdb_t *g);
+static int put_packet(gdb_t *g, const char *data);
+static int interrupted(gdb_t *g);
+static int handle(gdb_t *g, int *done);
+static int resume(gdb_t *g, int step);
+static int reverse(gdb_t *g, int step);
+static int stop_at_breakpoint(core_t *core, void *arg);
+static void stop_reply(gdb_t *g, int why);
+static int zkinds(int type);
+static int gdb_to_core(int reg);
+static void put_word(char *p, uint32_t val);
+static int get_word(const char *p, uint32_t *val);
+static int hex(int ch);
+
+gdb_t *gdb_create(char *spec, core_t *core, rev_t *rev, trap_t *trap)
+{
+    gdb_t *g;
+    int fd;
+
+    fd = open_socket(spec);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    g = xmalloc(sizeof(*g));
+    g->core = core;
+    g->rev = rev;
+    g->trap = trap;
+    g->fd = fd;
+    g->halted = 0;
+    g->len = g->pos = 0;
+    return g;
+}
+
+void gdb_destroy(gdb_t *g)
+{
+    if (g->fd >= 0) {
+        close(g->fd);
+    }
+    free(g);
+}
+
+int gdb_run(gdb_t *g)
+{
+    int done = 0;
+
+    while (!done) {
+        if (get_packet(g) || handle(g, &done)) {
+            /* Killed, or gone without detaching. */
+            if (!g->halted) {
+                g->halted = ERR_KILLED;
+            }
+            break;
+        }
+    }
+
+    close(g->fd);
+    g->fd = -1;
+    return g->halted;
+}
+
+/* Listens, waits for one connection, and stops listening. */
+static int open_socket(char *spec)
+{
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+    struct stat st;
+    char *end;
+    long port;
+    int lfd, fd, one = 1;
+
+    port = strtol(spec, &end, 10);
+    if ((*spec != '\0') && (*end == '\0')) {
+        if ((port <= 0) || (port > 65535)) {
+            debug_printf(MAIN, FATAL, "--gdb: invalid port \"%s\"\n", spec);
+            return -1;
+        }
+        lfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (lfd < 0) {
+            goto error;
+        }
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&in, 0, sizeof(in));
+        in.sin_family = AF_INET;
+        in.sin_port = htons((uint16_t)port);
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(lfd, (struct sockaddr *)&in, sizeof(in)) < 0) {
+            goto error_close;
+        }
+    } else {
+        if (strlen(spec) >= sizeof(un.sun_path)) {
+            debug_printf(MAIN, FATAL, "--gdb: path too long \"%s\"\n", spec);
+            return -1;
+        }
+        /* Clear away a socket left behind by an earlier run. */
+        if (!stat(spec, &st) && S_ISSOCK(st.st_mode)) {
+            unlink(spec);
+        }
+        lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (lfd < 0) {
+            goto error;
+        }
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strcpy(un.sun_path, spec);
+        if (bind(lfd, (struct sockaddr *)&un, sizeof(un)) < 0) {
+            goto error_close;
+        }
+    }
+
+    if (listen(lfd, 1) < 0) {
+        goto error_close;
+    }
+    debug_printf(MAIN, INFO, "Waiting for GDB on %s\n", spec);
+    do {
+        fd = accept(lfd, NULL, NULL);
+    } while ((fd < 0) && (errno == EINTR));
+    if (fd < 0) {
+        goto error_close;
+    }
+    close(lfd);
+    if (port > 0 && *end == '\0') {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else {
+        unlink(spec);
+    }
+    debug_print(MAIN, INFO, "GDB connected\n");
+    return fd;
+
+error_close:
+    close(lfd);
+error:
+    debug_printf(MAIN, FATAL, "--gdb %s: %s\n", spec, strerror(errno));
+    return -1;
+}
+
+static int get_char(gdb_t *g)
+{
+    ssize_t ret;
+
+    if (g->pos == g->len) {
+        do {
+            ret = read(g->fd, g->buf, sizeof(g->buf));
+        } while ((ret < 0) && (errno == EINTR));
+        if (ret <= 0) {
+            return -1;
+        }
+        g->len = ret;
+        g->pos = 0;
+    }
+    return g->buf[g->pos++];
+}
+
+/* Reads a packet's data into in, acknowledging it.  Nonzero at EOF. */
+static int get_packet(gdb_t *g)
+{
+    unsigned sum;
+    size_t n;
+    int ch, c1, c2;
+
+    for (;;) {
+        /* Anything outside a packet, including a stray interrupt, is noise. */
+        do {
+            ch = get_char(g);
+            if (ch < 0) {
+                return 1;
+            }
+        } while (ch != '$');
+
+        n = 0;
+        sum = 0;
+        while ((ch = get_char(g)) != '#') {
+            if (ch < 0) {
+                return 1;
+            }
+            if (n < PACKET_MAX) {
+                g->in[n++] = (char)ch;
+            }
+            sum += (unsigned char)ch;
+        }
+        g->in[n] = '\0';
+        c1 = get_char(g);
+        c2 = get_char(g);
+        if ((c1 < 0) || (c2 < 0)) {
+            return 1;
+        }
+        if ((hex(c1) << 4 | hex(c2)) == (int)(sum & 0xFF)) {
+            break;
+        }
+        if (write(g->fd, "-", 1) != 1) {
+            return 1;
+        }
+    }
+
+    debug_printf(MAIN, DETAIL, "GDB: <- %s\n", g->in);
+    return write(g->fd, "+", 1) != 1;
+}
+
+static int put_packet(gdb_t *g, const char *data)
+{
+    static const char digits[] = "0123456789abcdef";
+    char *pkt;
+    size_t n = strlen(data);
+    unsigned sum = 0;
+    int ch, ret = 0;
+
+    debug_printf(MAIN, DETAIL, "GDB: -> %s\n", data);
+
+    pkt = xmalloc(n + 4);
+    pkt[0] = '$';
+    memcpy(pkt + 1, data, n);
+    while (*data) {
+        sum += (unsigned char)*data++;
+    }
+    pkt[n + 1] = '#';
+    pkt[n + 2] = digits[(sum >> 4) & 0xF];
+    pkt[n + 3] = digits[sum & 0xF];
+
+    do {
+        if (write(g->fd, pkt, n + 4) != (ssize_t)(n + 4)) {
+            ret = 1;
+            break;
+        }
+        ch = get_char(g);
+    } while (ch == '-');
+    if (ch < 0) {
+        ret = 1;
+    }
+
+    free(pkt);
+    return ret;
+}
+
+/* Checks, without blocking, whether GDB has sent an interrupt (^C). */
+static int interrupted(gdb_t *g)
+{
+    struct pollfd p;
+
+    while (g->pos < g->len) {
+        if (g->buf[g->pos++] == 0x03) {
+            return 1;
+        }
+    }
+    p.fd = g->fd;
+    p.events = POLLIN;
+    if ((poll(&p, 1, 0) == 1) && (get_char(g) == 0x03)) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Handles the packet in in.  Nonzero if the connection has gone. */
+static int handle(gdb_t *g, int *done)
+{
+    char *p = g->in, *out = g->out;
+    uint32_t addr, len, val, pa, word;
+    unsigned long n;
+    int i, kind;
+
+    out[0] = '\0';
+
+    switch (*p++) {
+    case '?':
+        strcpy(out, "S05");
+        break;
+    case 'g':
+        for (i = 0; i < GDB_NUM_REGS; i++) {
+            put_word(out + 8 * i, core_get_reg(g->core, gdb_to_core(i)));
+        }
+        out[8 * GDB_NUM_REGS] = '\0';
+        break;
+    case 'G':
+        for (i = 0; i < GDB_NUM_REGS && !get_word(p + 8 * i, &val); i++) {
+            core_set_reg(g->core, gdb_to_core(i), val);
+        }
+        strcpy(out, "OK");
+        break;
+    case 'p':
+        n = strtoul(p, NULL, 16);
+        if (n < GDB_NUM_REGS) {
+            put_word(out, core_get_reg(g->core, gdb_to_core((int)n)));
+            out[8] = '\0';
+        } else {
+            strcpy(out, "xxxxxxxx");
+        }
+        break;
+    case 'P':
+        n = strtoul(p, &p, 16);
+        if ((*p == '=') && !get_word(p + 1, &val) && (n < GDB_NUM_REGS)) {
+            core_set_reg(g->core, gdb_to_core((int)n), val);
+        }
+        strcpy(out, "OK");
+        break;
+    case 'm':
+        addr = strtoul(p, &p, 16);
+        len = (*p == ',') ? strtoul(p + 1, NULL, 16) : 0;
+        if (len > PACKET_MAX / 2) {
+            len = PACKET_MAX / 2;
+        }
+        for (i = 0; (uint32_t)i < len; i++, addr++) {
+            if (core_read_virt(g->core, addr & ~0x3, &word)) {
+                break;
+            }
+            sprintf(out + 2 * i, "%02x", (word >> (8 * (addr & 0x3))) & 0xFF);
+        }
+        if (i == 0 && len > 0) {
+            strcpy(out, "E01");
+        }
+        break;
+    case 'M':
+        addr = strtoul(p, &p, 16);
+        len = (*p == ',') ? strtoul(p + 1, &p, 16) : 0;
+        p = strchr(p, ':');
+        strcpy(out, "OK");
+        for (i = 0; p && (uint32_t)i < len; i++, addr++) {
+            if ((hex(p[1 + 2 * i]) < 0) || (hex(p[2 + 2 * i]) < 0)) {
+                break;
+            }
+            val = hex(p[1 + 2 * i]) << 4 | hex(p[2 + 2 * i]);
+            if (core_write_virt(g->core, addr & ~0x3,
+                                val << (8 * (addr & 0x3)),
+                                1 << (addr & 0x3))) {
+                strcpy(out, "E01");
+                break;
+            }
+        }
+        break;
+    case 'c':
+    case 's':
+        if (*p) {
+            core_set_reg(g->core, CORE_REG_PC, strtoul(p, NULL, 16));
+        }
+        stop_reply(g, resume(g, g->in[0] == 's'));
+        break;
+    case 'b':
+        if ((*p == 's' || *p == 'c') && g->rev) {
+            stop_reply(g, reverse(g, *p == 's'));
+        }
+        break;
+    case 'Z':
+    case 'z':
+        kind = zkinds(*p);
+        addr = strtoul(p + 2, &p, 16);
+        len = (*p == ',') ? strtoul(p + 1, NULL, 16) : 0;
+        if (!kind) {
+            break;
+        }
+        if (kind == TRAP_EXEC) {
+            len = 4;
+        }
+        if (!len || core_virt_to_phys(g->core, addr, &pa)) {
+            strcpy(out, "E01");
+        } else if (g->in[0] == 'Z') {
+            strcpy(out, trap_add(g->trap, pa, len, kind) ? "E01" : "OK");
+        } else {
+            trap_remove(g->trap, pa, len, kind);
+            strcpy(out, "OK");
+        }
+        break;
+    case 'H':
+        strcpy(out, "OK");
+        break;
+    case 'q':
+        if (!strncmp(p, "Supported", 9)) {
+            sprintf(out, "PacketSize=%x%s", PACKET_MAX,
+                    g->rev ? ";ReverseStep+;ReverseContinue+" : "");
+        } else if (!strcmp(p, "Attached")) {
+            strcpy(out, "1");
+        } else if (!strcmp(p, "C")) {
+            strcpy(out, "QC1");
+        }
+        break;
+    case 'D':
+        strcpy(out, "OK");
+        *done = 1;
+        break;
+    case 'k':
+        debug_print(MAIN, INFO, "Killed by GDB\n");
+        return 1;
+    default:
+        break;
+    }
+
+    if (put_packet(g, out)) {
+        return 1;
+    }
+    if ((g->halted == ERR_EXIT) || (g->halted == ERR_TESTDONE)) {
+        *done = 1;
+    }
+    return 0;
+}
+
+/*
+ Runs until a breakpoint, a watchpoint, a halt or an interrupt from GDB, or
+ for one step.  A trap at the instruction we resume from has already been
+ reported, so it doesn't stop us again.  A core that has halted stays
+ halted.
+ */
+static int resume(gdb_t *g, int step)
+{
+    uint32_t pa;
+    unsigned long n;
+    int ret;
+
+    if (g->halted) {
+        return g->halted;
+    }
+    core_skip_traps(g->core);
+
+    for (n = 1; ; n++) {
+        ret = g->rev ? rev_step(g->rev) : core_step(g->core);
+        if (ret) {
+            break;
+        }
+        if (step) {
+            return STOP_STEP;
+        }
+        if (!(n % POLL_STEPS) && interrupted(g)) {
+            return STOP_INTERRUPT;
+        }
+    }
+
+    if ((ret != ERR_BREAK) && (ret != ERR_WATCH)) {
+        g->halted = ret;
+    }
+    return ret;
+}
+
+/* Reverse-continue only looks for breakpoints, not watchpoints. */
+static int reverse(gdb_t *g, int step)
+{
+    uint64_t now = rev_get_step(g->rev);
+    int ret = STOP_STEP;
+
+    if (step) {
+        if (now == 0) {
+            ret = STOP_HISTORY;
+        } else {
+            rev_goto(g->rev, now - 1);
+        }
+    } else if (!rev_reverse_continue(g->rev, &stop_at_breakpoint, g)) {
+        ret = STOP_HISTORY;
+    }
+
+    g->halted = 0;
+    return ret;
+}
+
+static int stop_at_breakpoint(core_t *core, void *arg)
+{
+    gdb_t *g = arg;
+    uint32_t pa;
+
+    return !core_virt_to_phys(core, core_get_reg(core, CORE_REG_PC), &pa) &&
+           trap_match(g->trap, pa, 4, TRAP_EXEC);
+}
+
+static void stop_reply(gdb_t *g, int why)
+{
+    uint32_t va;
+    int kinds;
+
+    switch (why) {
+    case STOP_STEP:
+    case ERR_BREAK:
+        sprintf(g->out, "S%02x", SIGTRAP_);
+        break;
+    case ERR_WATCH:
+        kinds = core_get_watch(g->core, &va);
+        sprintf(g->out, "T%02x%s:%08lx;", SIGTRAP_,
+                (kinds == TRAP_WRITE) ? "watch" :
+                (kinds == TRAP_READ) ? "rwatch" : "awatch",
+                (unsigned long)va);
+        break;
+    case STOP_INTERRUPT:
+        sprintf(g->out, "S%02x", SIGINT_);
+        break;
+    case STOP_HISTORY:
+        sprintf(g->out, "T%02xreplaylog:begin;", SIGTRAP_);
+        break;
+    case ERR_EXIT:
+        sprintf(g->out, "W%02x", core_get_exit_status(g->core) & 0xFF);
+        break;
+    case ERR_TESTDONE:
+        strcpy(g->out, "W00");
+        break;
+    default:
+        /* Stopped for good, but leave the state there to look at. */
+        debug_printf(MAIN, INFO, "Halted: %s.\n", err_text[why]);
+        sprintf(g->out, "S%02x", SIGSEGV_);
+        break;
+    }
+}
+
+/* The trap kinds for a Z or z packet's type, or 0 for unsupported types. */
+static int zkinds(int type)
+{
+    switch (type) {
+    case '0':
+    case '1':
+        return TRAP_EXEC;
+    case '2':
+        return TRAP_WRITE;
+    case '3':
+        return TRAP_READ;
+    case '4':
+        return TRAP_READ | TRAP_WRITE;
+    default:
+        return 0;
+    }
+}
+
+static int gdb_to_core(int reg)
+{
+    switch (reg) {
+    case GDB_SR:
+        return CORE_REG_CP0(CP0_STATUS);
+    case GDB_LO:
+        return CORE_REG_LO;
+    case GDB_HI:
+        return CORE_REG_HI;
+    case GDB_BAD:
+        return CORE_REG_CP0(CP0_BADVADDR);
+    case GDB_CAUSE:
+        return CORE_REG_CP0(CP0_CAUSE);
+    case GDB_PC:
+        return CORE_REG_PC;
+    default:
+        return reg;
+    }
+}
+
+/* Registers go over the wire in target (little-endian) byte order. */
+static void put_word(char *p, uint32_t val)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        sprintf(p + 2 * i, "%02x", (val >> (8 * i)) & 0xFF);
+    }
+}
+
+static int get_word(const char *p, uint32_t *val)
+{
+    int i, hi, lo;
+
+    *val = 0;
+    for (i = 0; i < 4; i++) {
+        hi = hex(p[2 * i]);
+        lo = (hi < 0) ? -1 : hex(p[2 * i + 1]);
+        if (lo < 0) {
+            return 1;
+        }
+        *val |= (uint32_t)(hi << 4 | lo) << (8 * i);
+    }
+    return 0;
+}
+
+static int hex(int ch)
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
@@ -0,0 +1,21 @@
+#ifndef GDB_H
+#define GDB_H
+
+#include "core.h"
+#include "rev.h"
+#include "trap.h"
+
+/*
+ A GDB remote serial protocol stub.  gdb_create waits for GDB to connect on
+ a TCP port (on the loopback interface) or, if spec isn't a number, a Unix
+ socket at that path.  gdb_run then serves it until it detaches, returning
+ the core_step result the program halted with, or 0 to keep running.
+ rev may be NULL; with it, GDB's reverse-step and reverse-continue work.
+ */
+typedef struct gdb gdb_t;
+
+gdb_t *gdb_create(char *spec, core_t *core, rev_t *rev, trap_t *trap);
+void gdb_destroy(gdb_t *g);
+int gdb_run(gdb_t *g);
+
+#endif
@@ -1,22 +1,48 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "bbv.h"
 #include "config.h"
 #include "core.h"
+#include "cosim.h"
 #include "debug.h"
+#include "dump.h"
 #include "err.h"
 #include "exc.h"
+#include "gdb.h"
 #include "mem.h"
+#include "profile.h"
 #include "ram.h"
 #include "readmemh.h"
+#include "rev.h"
+#include "rr.h"
+#include "sample.h"
+#include "stats.h"
+#include "trap.h"
+#include "uarch.h"
+
+static int step_prompt(config_t *c, rev_t *rev, core_dump_t *dump, int *ret);
+static int stop_at_pc(core_t *core, void *arg);
+static int stop_at_reg(core_t *core, void *arg);
 
 int main(int argc, char *argv[])
 {
     config_t c;
+    bbv_t *bbv = NULL;
+    FILE *bbv_file = NULL;
+    profile_t *prof = NULL;
+    rev_t *rev = NULL;
+    core_dump_t *step_dump = NULL, *trace_dump = NULL;
+    gdb_t *gdb;
+    cosim_t *cosim = NULL;
+    struct timespec start, end;
     int ret;
 
     debug_init();
@@ -26,8 +52,29 @@ int main(int argc, char *argv[])
     c.core = core_create(c.mem);
     c.pc = 0;
     c.dump_file = stdout;
+    c.dump_format = DUMP_TEXT;
+    c.dump_ram = 0;
     c.filter = NULL;
+    c.uarch = NULL;
+    c.icache = NULL;
+    c.dcache = NULL;
+    c.sample = NULL;
+    c.bbv_interval = 0;
+    c.bbv_file = "bb.out";
+    c.profile_period = 0;
+    c.profile_file = "profile.folded";
+    c.syms = NULL;
+    c.stats = 0;
+    c.reverse_interval = 0;
+    c.checkpoint_file = NULL;
+    c.restore_file = NULL;
+    c.restore_index = -1;
+    c.trap = NULL;
+    c.gdb = NULL;
     c.step = 0;
+    c.step_changes = 0;
+    c.trace_file = NULL;
+    c.cosim_file = NULL;
     /* Note: config_parse_args calls debug_set_level itself so it will apply
        to messages output as a result of further configuration options. */
     c.debug = DEBUG_LEVEL_WARNING;
@@ -40,21 +87,256 @@ int main(int argc, char *argv[])
     core_reset(c.core);
     core_set_pc(c.core, c.pc);
     core_set_filter(c.core, c.filter);
+    core_set_trap(c.core, c.trap);
+    core_set_uarch(c.core, c.uarch);
+    if (c.sample) {
+        sample_start(c.sample, c.core, c.uarch);
+    }
+    if (c.bbv_interval) {
+        bbv_file = fopen(c.bbv_file, "w");
+        if (!bbv_file) {
+            debug_printf(MAIN, FATAL, "Couldn't open \"%s\": %s\n",
+                    c.bbv_file, strerror(errno));
+            return 1;
+        }
+        bbv = bbv_create(c.bbv_interval, bbv_file);
+        core_set_bbv(c.core, bbv);
+    }
+    if (c.profile_period) {
+        prof = profile_create(c.profile_period, c.syms);
+        core_set_profile(c.core, prof);
+    }
 
-    do {
-        if (c.step) {
-            core_dump_regs(c.core, stderr);
-            {
-                int ch;
-                do { ch = getchar(); } while ((ch != '\n') && (ch != EOF));
-                if (ch == EOF) { c.step = 0; }
-            }
+    if (c.restore_file &&
+        rev_load(c.core, c.mem, c.restore_file, c.restore_index)) {
+        return 1;
+    }
+    if (c.checkpoint_file && !c.reverse_interval) {
+        debug_print(MAIN, FATAL, "--checkpoint-file needs --reverse\n");
+        return 1;
+    }
+    if (c.reverse_interval) {
+        rev = rev_create(c.core, c.mem, c.reverse_interval, c.checkpoint_file);
+        if (!rev) {
+            return 1;
+        }
+    }
+
+    if (c.cosim_file) {
+        if (rev || c.gdb) {
+            debug_print(MAIN, FATAL,
+                    "--cosim can't be used with --reverse or --gdb\n");
+            return 1;
+        }
+        cosim = cosim_create(c.cosim_file, c.core);
+        if (!cosim) {
+            return 1;
+        }
+    }
+
+    if (c.step_changes) {
+        step_dump = core_dump_create();
+    }
+    if (c.trace_file) {
+        trace_dump = core_dump_create();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = 0;
+    if (c.gdb) {
+        if (!c.trap) {
+            c.trap = trap_create(c.mem);
+            core_set_trap(c.core, c.trap);
+        }
+        gdb = gdb_create(c.gdb, c.core, rev, c.trap);
+        if (!gdb) {
+            return 1;
+        }
+        /* Once GDB detaches (having removed its breakpoints), carry on. */
+        ret = gdb_run(gdb);
+        gdb_destroy(gdb);
+    }
+    for (;;) {
+        if (c.step && step_prompt(&c, rev, step_dump, &ret)) {
+            c.step = 0;
+        }
+        if (ret) {
+            break;
+        }
+        ret = cosim ? cosim_step(cosim)
+              : rev ? rev_step(rev) : core_step(c.core);
+        if (trace_dump) {
+            core_dump_changes(c.core, trace_dump, c.trace_file);
+        }
+        /* A --watch stops at the prompt, before the instruction. */
+        if ((ret == ERR_WATCH) || (ret == ERR_BREAK)) {
+            core_skip_traps(c.core);
+            c.step = 1;
+            ret = 0;
+            continue;
         }
-        ret = core_step(c.core);
-    } while (!ret);
+        /* Stay at the prompt after halting, in case we want to go back. */
+        if (ret && !(c.step && rev)) {
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
     debug_printf(MAIN, INFO, "Halted: %s.\n", err_text[ret]);
-    core_dump_regs(c.core, c.dump_file);
+    if (ret == ERR_EXIT) {
+        debug_printf(MAIN, INFO, "Exit status: %d\n",
+                core_get_exit_status(c.core));
+    }
+    if ((c.dump_format == DUMP_TEXT) && !c.dump_ram) {
+        core_dump_regs(c.core, c.dump_file);
+    } else {
+        dump_t d;
+        dump_capture(&d, c.core, c.dump_ram ? c.mem : NULL);
+        dump_write(&d, c.dump_file, c.dump_format);
+        dump_free(&d);
+    }
+    rr_finish();
+
+    if (bbv) {
+        bbv_finish(bbv);
+        fclose(bbv_file);
+    }
+    if (c.stats) {
+        stats_report(stderr, c.stats == STATS_JSON, core_get_stats(c.core),
+                c.mem, (end.tv_sec - start.tv_sec) +
+                       (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+    if (prof) {
+        FILE *f;
+        profile_report(prof, stderr);
+        f = fopen(c.profile_file, "w");
+        if (f) {
+            profile_write_folded(prof, f);
+            fclose(f);
+        } else {
+            debug_printf(MAIN, ERROR, "Couldn't write \"%s\": %s\n",
+                    c.profile_file, strerror(errno));
+        }
+    }
 
-    return 0;
+    if (c.uarch) {
+        uarch_report(c.uarch, stderr);
+    }
+    if (c.sample) {
+        sample_report(c.sample, stderr);
+    }
+
+    if (rev) {
+        rev_destroy(rev);
+    }
+    if (cosim) {
+        cosim_destroy(cosim);
+    }
+    if (c.trap) {
+        core_set_trap(c.core, NULL);
+        trap_destroy(c.trap);
+    }
+    if (step_dump) {
+        core_dump_destroy(step_dump);
+    }
+    if (trace_dump) {
+        core_dump_destroy(trace_dump);
+        if (c.trace_file != stdout) {
+            fclose(c.trace_file);
+        }
+    }
+
+    /* Pass the guest's exit status on, for scripts. */
+    return (ret == ERR_EXIT) ? core_get_exit_status(c.core) : 0;
+}
+
+/*
+ Dumps the registers and reads commands until told to step.  *ret is the
+ halt reason if the core has halted; going back in time clears it.
+ Returns nonzero at end of input, to stop stepping.
+ */
+static int step_prompt(config_t *c, rev_t *rev, core_dump_t *dump, int *ret)
+{
+    char line[64], cmd[8], word[32];
+    unsigned long arg;
+    uint64_t step;
+    int n;
+
+    for (;;) {
+        if (*ret) {
+            fprintf(stderr, "Halted: %s.\n", err_text[*ret]);
+        }
+        if (rev) {
+            fprintf(stderr, "Step %llu\n",
+                    (unsigned long long)rev_get_step(rev));
+        }
+        if (dump) {
+            core_dump_changes(c->core, dump, stderr);
+        } else {
+            core_dump_regs(c->core, stderr);
+        }
+
+        if (!fgets(line, sizeof(line), stdin)) {
+            return 1;
+        }
+        n = sscanf(line, "%7s %31s", cmd, word);
+        if (n < 1) {
+            return 0;
+        }
+        if (!rev) {
+            /* Any other line steps, as before there were commands. */
+            return !strcmp(cmd, "c");
+        }
+        /* Addresses are in hex, as on the command line. */
+        if (n == 2) {
+            arg = strtoul(word, NULL, strcmp(cmd, "rc") ? 10 : 16);
+        }
+
+        step = rev_get_step(rev);
+        if (!strcmp(cmd, "c")) {
+            while (!*ret) {
+                *ret = rev_step(rev);
+                /* As in main: stop before the instruction, not halt. */
+                if ((*ret == ERR_WATCH) || (*ret == ERR_BREAK)) {
+                    core_skip_traps(c->core);
+                    *ret = 0;
+                    break;
+                }
+            }
+        } else if (!strcmp(cmd, "rs")) {
+            if (n < 2) {
+                arg = 1;
+            }
+            *ret = rev_goto(rev, (arg < step) ? step - arg : 0);
+        } else if (!strcmp(cmd, "rc") && (n == 2)) {
+            uint32_t pc = (uint32_t)arg;
+            if (!rev_reverse_continue(rev, &stop_at_pc, &pc)) {
+                fprintf(stderr, "Not reached; back at the start.\n");
+            }
+            *ret = 0;
+        } else if (!strcmp(cmd, "rw") && (n == 2) && (arg < 32)) {
+            int reg = (int)arg;
+            uint32_t val[2];
+            val[0] = (uint32_t)reg;
+            val[1] = core_get_reg(c->core, reg);
+            if (!rev_reverse_continue(rev, &stop_at_reg, val)) {
+                fprintf(stderr, "Not changed; back at the start.\n");
+            }
+            *ret = 0;
+        } else {
+            fprintf(stderr, "Unknown command \"%s\"\n", cmd);
+        }
+    }
+}
+
+static int stop_at_pc(core_t *core, void *arg)
+{
+    return core_get_pc(core) == *(uint32_t *)arg;
+}
+
+/* arg is the register number and its value now. */
+static int stop_at_reg(core_t *core, void *arg)
+{
+    uint32_t *val = arg;
+    return core_get_reg(core, (int)val[0]) != val[1];
 }
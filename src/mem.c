@@ -17,13 +17,34 @@ struct mem_region {
 
     struct mem_dev *dev;
 
+    uint64_t reads;
+    uint64_t writes;
+
     mem_region_t *prev;
     mem_region_t *next;
 
     mem_t *mem;
+
+    /*
+     The number of traps set on each of the region's pages, or NULL if
+     there are none.  Accesses to a trapped page return MEM_TRAP without
+     being made; the caller then decides what to do and makes the access
+     with mem_read_untrapped or mem_write_untrapped.  So a region without
+     traps costs one test, however many traps are set elsewhere.
+     */
+    unsigned *traps;
+    unsigned ntraps;
 };
 
+/* The index, within r's traps, of the page containing addr. */
+#define PAGE_INDEX(r, addr) \
+        (((addr) >> MEM_DEV_PAGE_SHIFT) - ((r)->base >> MEM_DEV_PAGE_SHIFT))
+
 static mem_region_t *find_region(mem_t *m, uint32_t addr);
+static int trapped(mem_region_t *r, uint32_t addr);
+static int region_read(mem_region_t *r, uint32_t addr, uint32_t *val_out);
+static int region_write(mem_region_t *r, uint32_t addr,
+                        uint32_t val, uint8_t we);
 
 mem_t *mem_create(void)
 {
@@ -48,9 +69,16 @@ mem_region_t *mem_map(mem_t *m, uint32_t base, mem_dev_t *d)
     r->base = base;
     r->dev = d;
     r->mem = m;
+    r->reads = 0;
+    r->writes = 0;
+    r->traps = NULL;
+    r->ntraps = 0;
 
     r->prev = NULL;
     r->next = m->regions;
+    if (r->next) {
+        r->next->prev = r;
+    }
     m->regions = r;
 
     debug_printf(MEM, INFO, "Memory mapped at %08x-%08x (%08x)\n",
@@ -75,22 +103,160 @@ void mem_unmap(mem_t *m, mem_region_t *r)
         r->next->prev = r->prev;
     }
     r->mem = NULL;
+    free(r->traps);
     free(r);
 }
 
+/* Regions are visited most recently mapped first. */
+mem_region_t *mem_first_region(mem_t *m)
+{
+    return m->regions;
+}
+
+mem_region_t *mem_next_region(mem_region_t *r)
+{
+    return r->next;
+}
+
+uint32_t mem_region_base(mem_region_t *r)
+{
+    return r->base;
+}
+
+mem_dev_t *mem_region_dev(mem_region_t *r)
+{
+    return r->dev;
+}
+
+/* Word accesses through mem_read and mem_write; mapped access isn't seen. */
+void mem_region_counts(mem_region_t *r, uint64_t *reads, uint64_t *writes)
+{
+    *reads = r->reads;
+    *writes = r->writes;
+}
+
 int mem_read(mem_t *m, uint32_t addr, uint32_t *val_out)
 {
     mem_region_t *r;
 
     assert(!(addr & 0x3));
+    r = find_region(m, addr);
+    if (r && r->traps && trapped(r, addr)) {
+        return MEM_TRAP;
+    }
+    return region_read(r, addr, val_out);
+}
+
+int mem_write(mem_t *m, uint32_t addr, uint32_t val, uint8_t we)
+{
+    mem_region_t *r;
 
+    assert(!(addr & 0x3));
+    assert(!(we & ~0xF));
     r = find_region(m, addr);
+    if (r && r->traps && trapped(r, addr)) {
+        return MEM_TRAP;
+    }
+    return region_write(r, addr, val, we);
+}
+
+/* As mem_read and mem_write, but going past any traps. */
+int mem_read_untrapped(mem_t *m, uint32_t addr, uint32_t *val_out)
+{
+    assert(!(addr & 0x3));
+    return region_read(find_region(m, addr), addr, val_out);
+}
+
+int mem_write_untrapped(mem_t *m, uint32_t addr, uint32_t val, uint8_t we)
+{
+    assert(!(addr & 0x3));
+    assert(!(we & ~0xF));
+    return region_write(find_region(m, addr), addr, val, we);
+}
+
+/*
+ Returns a host pointer to len bytes of guest physical memory starting at
+ addr, for devices that move data in bulk instead of a word at a time.  The
+ range must lie within a single region whose device can map it.
+ */
+void *mem_map_host(mem_t *m, uint32_t addr, uint32_t len, int write)
+{
+    mem_region_t *r;
+
+    if (len == 0) {
+        return NULL;
+    }
+
+    for (r = mem_first_region(m); r; r = mem_next_region(r)) {
+        if ((r->base <= addr) && (addr - r->base < r->dev->size)) {
+            break;
+        }
+    }
+    if (!r || (len > r->dev->size - (addr - r->base)) || !r->dev->map) {
+        debug_printf(MEM, DETAIL,
+                "Cannot map %08x-%08x for bulk %s\n",
+                addr, addr + len, write ? "write" : "read");
+        return NULL;
+    }
+
+    debug_printf(MEM, TRACE, "Mapping %08x-%08x for bulk %s\n",
+            addr, addr + len, write ? "write" : "read");
+    return (r->dev->map)(r->dev, addr - r->base, len, write);
+}
+
+/*
+ Sets (on nonzero) or clears one trap on the physical page containing addr;
+ the page stays trapped until every trap set on it has been cleared.
+ Returns nonzero if nothing is mapped there.
+ */
+int mem_trap_page(mem_t *m, uint32_t addr, int on)
+{
+    mem_region_t *r;
+    uint32_t page = addr & ~(uint32_t)(MEM_DEV_PAGE - 1), npages;
+
+    r = find_region(m, page);
+    if (!r) {
+        return 1;
+    }
+
+    if (!on) {
+        assert(r->traps && r->traps[PAGE_INDEX(r, page)]);
+        if (--r->traps[PAGE_INDEX(r, page)] == 0) {
+            debug_printf(MEM, DETAIL, "Untrapping page %08x\n", page);
+        }
+        if (--r->ntraps == 0) {
+            free(r->traps);
+            r->traps = NULL;
+        }
+        return 0;
+    }
+
+    if (!r->traps) {
+        npages = PAGE_INDEX(r, r->base + r->dev->size - 1) + 1;
+        r->traps = xmalloc(npages * sizeof(*r->traps));
+        memset(r->traps, 0, npages * sizeof(*r->traps));
+    }
+    if (r->traps[PAGE_INDEX(r, page)]++ == 0) {
+        debug_printf(MEM, DETAIL, "Trapping page %08x\n", page);
+    }
+    r->ntraps++;
+    return 0;
+}
+
+static int trapped(mem_region_t *r, uint32_t addr)
+{
+    return r->traps[PAGE_INDEX(r, addr)] != 0;
+}
+
+static int region_read(mem_region_t *r, uint32_t addr, uint32_t *val_out)
+{
     if (!r) {
         debug_printf(MEM, DETAIL,
                 "Attempt to read unmapped memory at %08x\n", addr);
         return 1;
     } else if (r->dev->read) {
         debug_printf(MEM, TRACE, "Reading %08x\n", addr);
+        r->reads++;
         return (r->dev->read)(r->dev, addr - r->base, val_out);
     } else {
         debug_printf(MEM, DETAIL,
@@ -99,14 +265,9 @@ int mem_read(mem_t *m, uint32_t addr, uint32_t *val_out)
     }
 }
 
-int mem_write(mem_t *m, uint32_t addr, uint32_t val, uint8_t we)
+static int region_write(mem_region_t *r, uint32_t addr,
+                        uint32_t val, uint8_t we)
 {
-    mem_region_t *r;
-
-    assert(!(addr & 0x3));
-    assert(!(we & ~0xF));
-
-    r = find_region(m, addr);
     if (!r) {
         debug_printf(MEM, DETAIL,
                 "Attempt to write to unmapped memory at %08x "
@@ -116,6 +277,7 @@ int mem_write(mem_t *m, uint32_t addr, uint32_t val, uint8_t we)
     } else if (r->dev->write) {
         debug_printf(MEM, TRACE,
                 "Writing %08x (val=%08x, we=%01x)\n", addr, val, we);
+        r->writes++;
         return (r->dev->write)(r->dev, addr - r->base, val, we);
     } else {
         debug_printf(MEM, DETAIL,
@@ -126,8 +288,6 @@ int mem_write(mem_t *m, uint32_t addr, uint32_t val, uint8_t we)
     }
 }
 
-
-
 static mem_region_t *find_region(mem_t *m, uint32_t addr)
 {
     mem_region_t *r;
@@ -5,6 +5,10 @@
 
 #include "mem_dev.h"
 
+/* Returned by mem_read and mem_write, without doing the access, for pages
+   with traps set. */
+#define MEM_TRAP 2
+
 typedef struct mem mem_t;
 typedef struct mem_region mem_region_t;
 
@@ -12,8 +16,17 @@ mem_t *mem_create(void);
 void mem_destroy(mem_t *mem);
 mem_region_t *mem_map(mem_t *mem, uint32_t base, mem_dev_t *dev);
 void mem_unmap(mem_t *mem, mem_region_t *rgn);
+mem_region_t *mem_first_region(mem_t *mem);
+mem_region_t *mem_next_region(mem_region_t *rgn);
+uint32_t mem_region_base(mem_region_t *rgn);
+mem_dev_t *mem_region_dev(mem_region_t *rgn);
+void mem_region_counts(mem_region_t *rgn, uint64_t *reads, uint64_t *writes);
 
 int mem_read(mem_t *mem, uint32_t addr, uint32_t *val_out);
 int mem_write(mem_t *mem, uint32_t addr, uint32_t val, uint8_t we);
+int mem_read_untrapped(mem_t *mem, uint32_t addr, uint32_t *val_out);
+int mem_write_untrapped(mem_t *mem, uint32_t addr, uint32_t val, uint8_t we);
+void *mem_map_host(mem_t *mem, uint32_t addr, uint32_t len, int write);
+int mem_trap_page(mem_t *mem, uint32_t addr, int on);
 
 #endif
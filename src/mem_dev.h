@@ -5,10 +5,26 @@
 
 typedef struct mem_dev mem_dev_t;
 
+#define MEM_DEV_PAGE_SHIFT 12
+#define MEM_DEV_PAGE (1 << MEM_DEV_PAGE_SHIFT)
+
 struct mem_dev {
     uint32_t size;
     int (*read)(mem_dev_t *dev, uint32_t offset, uint32_t *val_out);
     int (*write)(mem_dev_t *dev, uint32_t offset, uint32_t val, uint8_t we);
+    /* Optional: returns host memory backing [offset, offset + len), or NULL
+       if the device has none.  Used for bulk transfers. */
+    void *(*map)(mem_dev_t *dev, uint32_t offset, uint32_t len, int write);
+    /* Optional: copy the device's state_size bytes of internal state out
+       or back in, for checkpoints.  Devices with a map have their
+       contents checkpointed through it instead. */
+    uint32_t state_size;
+    void (*save)(mem_dev_t *dev, void *buf);
+    void (*restore)(mem_dev_t *dev, const void *buf);
+    /* Optional: a bit per MEM_DEV_PAGE bytes, which the device sets when
+       the page is written (directly or through a writable map) and which
+       whoever is tracking changes clears. */
+    uint32_t *dirty;
 };
 
 #endif
@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "core_cp0.h"
+#include "core_priv.h"
+#include "debug.h"
+#include "filter.h"
+#include "mem.h"
+#include "ram.h"
+#include "readmemh.h"
+#include "util.h"
+
+/*
+ Microbenchmarks for the layers under core_step, to pin down which one
+ regressed when overall throughput drops.  Each benchmark runs its body in
+ batches, doubling the batch until a run takes at least MIN_TIME seconds,
+ and reports time and xmalloc calls per operation.
+
+ usage: microbench [name-prefix]
+ */
+#define MIN_TIME 0.2
+#define IMAGE_WORDS (4 * 1024 * 1024)
+
+typedef void (*bench_fn_t)(void *arg, unsigned long n);
+
+static int run(const char *name, bench_fn_t fn, void *arg);
+static double now(void);
+
+static const char *only;
+static volatile uint32_t sink;
+
+
+
+/* mem_read/mem_write, with the target in the last of nregions regions. */
+
+struct mem_arg {
+    mem_t *mem;
+    uint32_t addr;
+};
+
+static void bench_mem_read(void *arg, unsigned long n)
+{
+    struct mem_arg *a = arg;
+    uint32_t v = 0;
+
+    while (n--) {
+        mem_read(a->mem, a->addr + (n & 0xFFC), &v);
+    }
+    sink = v;
+}
+
+static void bench_mem_write(void *arg, unsigned long n)
+{
+    struct mem_arg *a = arg;
+
+    while (n--) {
+        mem_write(a->mem, a->addr + (n & 0xFFC), n, 0xF);
+    }
+}
+
+static void mem_benches(void)
+{
+    static const unsigned counts[] = { 1, 4, 16, 64 };
+    struct mem_arg a;
+    mem_dev_t *devs[64];
+    char name[64];
+    unsigned i, j;
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        a.mem = mem_create();
+        for (j = 0; j < counts[i]; j++) {
+            devs[j] = ram_create(0x10000);
+            mem_map(a.mem, j * 0x10000, devs[j]);
+        }
+        /* Regions are searched most recently mapped first. */
+        a.addr = 0;
+
+        sprintf(name, "mem_read/%u-regions", counts[i]);
+        run(name, bench_mem_read, &a);
+        sprintf(name, "mem_write/%u-regions", counts[i]);
+        run(name, bench_mem_write, &a);
+
+        mem_destroy(a.mem);
+        for (j = 0; j < counts[i]; j++) {
+            ram_destroy(devs[j]);
+        }
+    }
+}
+
+
+
+/* core_cp0_translate: unmapped, TLB hit (last entry) and TLB refill. */
+
+struct translate_arg {
+    core_t *core;
+    uint32_t va;
+};
+
+static void bench_translate(void *arg, unsigned long n)
+{
+    struct translate_arg *a = arg;
+    uint32_t pa = 0;
+
+    while (n--) {
+        core_cp0_translate(a->core, &a->core->cp0, a->va, &pa, 0);
+    }
+    sink = pa;
+}
+
+static void translate_benches(void)
+{
+    struct translate_arg a;
+    mem_t *mem = mem_create();
+    uint32_t i;
+
+    a.core = core_create(mem);
+    core_reset(a.core);
+    for (i = 0; i < CP0_TLB_SIZE; i++) {
+        core_cp0_move_to(a.core, &a.core->cp0, CP0_INDEX, i);
+        core_cp0_move_to(a.core, &a.core->cp0, CP0_ENTRYHI,
+                0x00400000 + i * 0x1000);
+        core_cp0_move_to(a.core, &a.core->cp0, CP0_ENTRYLO, i * 0x1000);
+        core_cp0_tlbwi(a.core, &a.core->cp0);
+    }
+
+    a.va = 0x80001234;
+    run("core_cp0_translate/unmapped", bench_translate, &a);
+    a.va = 0x00400000 + (CP0_TLB_SIZE - 1) * 0x1000 + 0x10;
+    run("core_cp0_translate/tlb-warm", bench_translate, &a);
+    a.va = 0x10000010;
+    run("core_cp0_translate/tlb-cold", bench_translate, &a);
+
+    core_destroy(a.core);
+    mem_destroy(mem);
+}
+
+
+
+/* readmemh_load of a large image. */
+
+struct readmemh_arg {
+    mem_t *mem;
+    char *file;
+};
+
+static void bench_readmemh(void *arg, unsigned long n)
+{
+    struct readmemh_arg *a = arg;
+
+    while (n--) {
+        readmemh_load(a->mem, 0, a->file);
+    }
+}
+
+static void readmemh_benches(void)
+{
+    struct readmemh_arg a;
+    char file[] = "/tmp/microbench-XXXXXX";
+    mem_dev_t *ram;
+    FILE *f;
+    int fd;
+    uint32_t i;
+
+    fd = mkstemp(file);
+    if ((fd < 0) || !(f = fdopen(fd, "w"))) {
+        perror("microbench: temporary image");
+        return;
+    }
+    for (i = 0; i < IMAGE_WORDS; i++) {
+        fprintf(f, "%08x\n", i * 2654435761u);
+    }
+    fclose(f);
+
+    a.mem = mem_create();
+    ram = ram_create(IMAGE_WORDS * 4);
+    mem_map(a.mem, 0, ram);
+    a.file = file;
+    run("readmemh_load/16M", bench_readmemh, &a);
+
+    mem_destroy(a.mem);
+    ram_destroy(ram);
+    unlink(file);
+}
+
+
+
+/* filter_ins_allowed, over a spread of instruction words. */
+
+static void bench_filter(void *arg, unsigned long n)
+{
+    filter_t *filter = arg;
+    uint32_t ins = 0x12345678, ok = 0;
+
+    while (n--) {
+        ok += filter_ins_allowed(filter, ins);
+        ins = ins * 1664525 + 1013904223;
+    }
+    sink = ok;
+}
+
+static void filter_benches(void)
+{
+    static char *names[] = { "lab1", "lab2", "lab3", "lab4", "lab4ec",
+                             "lab5ck2", "lab5" };
+    char name[64];
+    unsigned i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        sprintf(name, "filter_ins_allowed/%s", names[i]);
+        run(name, bench_filter, filter_find(names[i]));
+    }
+}
+
+
+
+/* ram_create (and ram_destroy) of large RAMs. */
+
+static void bench_ram_create(void *arg, unsigned long n)
+{
+    uint32_t size = *(uint32_t *)arg;
+
+    while (n--) {
+        ram_destroy(ram_create(size));
+    }
+}
+
+static void ram_benches(void)
+{
+    static uint32_t sizes[] = { 1 << 20, 16 << 20, 256 << 20 };
+    char name[64];
+    unsigned i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        sprintf(name, "ram_create/%uM", sizes[i] >> 20);
+        run(name, bench_ram_create, &sizes[i]);
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    debug_init();
+    debug_set_level(DEBUG_LEVEL_WARNING);
+
+    only = (argc > 1) ? argv[1] : NULL;
+
+    printf("%-36s %12s %14s %12s\n", "benchmark", "ops", "ns/op", "allocs/op");
+    mem_benches();
+    translate_benches();
+    readmemh_benches();
+    filter_benches();
+    ram_benches();
+
+    return 0;
+}
+
+static int run(const char *name, bench_fn_t fn, void *arg)
+{
+    unsigned long n = 1, allocs;
+    double start, elapsed;
+
+    if (only && strncmp(name, only, strlen(only))) {
+        return 0;
+    }
+
+    for (;;) {
+        allocs = __atomic_load_n(&xmalloc_count, __ATOMIC_RELAXED);
+        start = now();
+        fn(arg, n);
+        elapsed = now() - start;
+        allocs = __atomic_load_n(&xmalloc_count, __ATOMIC_RELAXED) - allocs;
+        if (elapsed >= MIN_TIME) {
+            break;
+        }
+        n *= 2;
+    }
+
+    printf("%-36s %12lu %14.1f %12.2f\n", name, n, elapsed * 1e9 / n,
+            (double)allocs / n);
+    return 0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
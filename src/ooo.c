@@ -0,0 +1,425 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpred.h"
+#include "debug.h"
+#include "ooo.h"
+#include "uarch.h"
+#include "util.h"
+
+/*
+ A superscalar out-of-order core in the style of a trace-driven model: each
+ committed instruction is walked through fetch, dispatch, issue, completion
+ and commit once, in program order, and we compute the cycle of each step
+ from the structures it needs:
+
+  fetch     width per cycle, ending a group at a taken branch; restarts after
+            a mispredicted branch completes or an exception commits
+  dispatch  in order, width per cycle, FRONT_DEPTH after fetch, needing a
+            free ROB entry and a free reservation station
+  issue     out of order once operands are ready (registers are renamed, so
+            only true dependences matter) and a functional unit is free
+  commit    in order, width per cycle, after completion
+
+ Per-cycle issue and functional unit usage is tracked in small rings indexed
+ by cycle, so the cost per instruction is bounded by the RS scan.
+ */
+#define FRONT_DEPTH 3
+#define SLOT_RING 8192
+#define HILO 32
+#define NUM_DEPS 33
+
+enum {
+    FU_ALU,
+    FU_MEM,
+    FU_MUL,
+    FU_DIV,
+    NUM_FUS
+};
+
+enum {
+    PARAM_WIDTH,
+    PARAM_ROB,
+    PARAM_RS,
+    PARAM_ALU,
+    PARAM_MEM,
+    PARAM_MUL,
+    PARAM_DIV,
+    PARAM_LAT_ALU,
+    PARAM_LAT_LOAD,
+    PARAM_LAT_MUL,
+    PARAM_LAT_DIV,
+    NUM_PARAMS
+};
+
+static const char *param_names[] = {
+    [PARAM_WIDTH] = "width",
+    [PARAM_ROB] = "rob",
+    [PARAM_RS] = "rs",
+    [PARAM_ALU] = "alu",
+    [PARAM_MEM] = "mem",
+    [PARAM_MUL] = "mul",
+    [PARAM_DIV] = "div",
+    [PARAM_LAT_ALU] = "lat_alu",
+    [PARAM_LAT_LOAD] = "lat_load",
+    [PARAM_LAT_MUL] = "lat_mul",
+    [PARAM_LAT_DIV] = "lat_div"
+};
+
+static const unsigned param_defaults[] = {
+    [PARAM_WIDTH] = 4,
+    [PARAM_ROB] = 128,
+    [PARAM_RS] = 32,
+    [PARAM_ALU] = 4,
+    [PARAM_MEM] = 2,
+    [PARAM_MUL] = 1,
+    [PARAM_DIV] = 1,
+    [PARAM_LAT_ALU] = 1,
+    [PARAM_LAT_LOAD] = 2,
+    [PARAM_LAT_MUL] = 4,
+    [PARAM_LAT_DIV] = 32
+};
+
+enum {
+    STALL_FRONTEND,         /* Mispredicts and exceptions. */
+    STALL_ICACHE,
+    STALL_ROB,
+    STALL_RS,
+    STALL_OPERANDS,
+    STALL_FU,
+    NUM_STALLS
+};
+
+static const char *stall_names[] = {
+    [STALL_FRONTEND] = "frontend",
+    [STALL_ICACHE] = "icache",
+    [STALL_ROB] = "rob-full",
+    [STALL_RS] = "rs-full",
+    [STALL_OPERANDS] = "operands",
+    [STALL_FU] = "fu-busy"
+};
+
+/* An in-order stage that handles up to width instructions per cycle. */
+struct inorder {
+    uint64_t cycle;
+    unsigned count;
+};
+
+/* Usage of a per-cycle resource, for cycles within SLOT_RING of each other. */
+struct slots {
+    uint64_t cycle[SLOT_RING];
+    uint16_t used[SLOT_RING];
+};
+
+struct ooo {
+    unsigned p[NUM_PARAMS];
+    bpred_t *bp;
+
+    struct inorder fetch;
+    struct inorder dispatch;
+    struct inorder commit;
+    uint64_t redirect;          /* Earliest fetch after a redirect. */
+    int redirect_cause;
+    int end_group;              /* Last fetch was a taken branch. */
+
+    uint64_t *rob;              /* Commit cycle, by instruction % rob. */
+    uint64_t *rs;               /* Cycle each station frees up. */
+    uint64_t ready[NUM_DEPS];
+    uint64_t *div_free;         /* Cycle each divider frees up. */
+    struct slots issue;
+    struct slots fu[NUM_FUS];
+
+    uint64_t seq;
+    uint64_t insts;
+    uint64_t excs;
+    uint64_t mispredicts;
+    uint64_t stalls[NUM_STALLS];
+};
+
+static uint64_t inorder_slot(struct inorder *s, uint64_t earliest,
+                             unsigned width);
+static int slot_free(struct slots *s, uint64_t cycle, unsigned limit);
+static void slot_take(struct slots *s, uint64_t cycle);
+static int fu_of(const uarch_dec_t *d);
+static int parse_params(ooo_t *o, char *spec);
+
+/* spec is a possibly empty list of <param>=<value>, separated by colons. */
+ooo_t *ooo_create_spec(char *spec)
+{
+    ooo_t *o;
+    int i;
+
+    o = xmalloc(sizeof(*o));
+    memset(o, 0, sizeof(*o));
+    for (i = 0; i < NUM_PARAMS; i++) {
+        o->p[i] = param_defaults[i];
+    }
+    if (parse_params(o, spec)) {
+        free(o);
+        return NULL;
+    }
+
+    o->bp = bpred_create_spec("gshare:12");
+    o->rob = xmalloc(o->p[PARAM_ROB] * sizeof(*o->rob));
+    memset(o->rob, 0, o->p[PARAM_ROB] * sizeof(*o->rob));
+    o->rs = xmalloc(o->p[PARAM_RS] * sizeof(*o->rs));
+    memset(o->rs, 0, o->p[PARAM_RS] * sizeof(*o->rs));
+    o->div_free = xmalloc(o->p[PARAM_DIV] * sizeof(*o->div_free));
+    memset(o->div_free, 0, o->p[PARAM_DIV] * sizeof(*o->div_free));
+    o->fetch.cycle = o->dispatch.cycle = o->commit.cycle = 1;
+
+    return o;
+}
+
+void ooo_destroy(ooo_t *o)
+{
+    bpred_destroy(o->bp);
+    free(o->rob);
+    free(o->rs);
+    free(o->div_free);
+    free(o);
+}
+
+void ooo_commit(ooo_t *o, const uarch_rec_t *rec, const uarch_dec_t *d,
+                unsigned ilat, unsigned dlat)
+{
+    unsigned width = o->p[PARAM_WIDTH];
+    uint64_t fetch, dispatch, issue, complete, commit, t, prev;
+    unsigned rs_idx, div_idx = 0, i, lat;
+    int fu, mispredict = 0;
+
+    /* Fetch. */
+    t = o->fetch.cycle + (o->end_group ? 1 : 0);
+    if (o->redirect > t) {
+        o->stalls[o->redirect_cause] += o->redirect - t;
+        t = o->redirect;
+    }
+    o->stalls[STALL_ICACHE] += ilat;
+    fetch = inorder_slot(&o->fetch, t + ilat, width);
+    o->end_group = rec->next_pc != rec->pc + 4;
+
+    /* Dispatch: needs a ROB entry and a reservation station. */
+    prev = o->dispatch.cycle;
+    t = fetch + FRONT_DEPTH;
+    if (o->seq >= o->p[PARAM_ROB]) {
+        uint64_t rob_free = o->rob[o->seq % o->p[PARAM_ROB]] + 1;
+        if (rob_free > t) {
+            /* Only the part past the last dispatch holds anything up. */
+            if (rob_free > prev) {
+                o->stalls[STALL_ROB] += rob_free - (t > prev ? t : prev);
+            }
+            t = rob_free;
+        }
+    }
+    rs_idx = 0;
+    for (i = 1; i < o->p[PARAM_RS]; i++) {
+        if (o->rs[i] < o->rs[rs_idx]) {
+            rs_idx = i;
+        }
+    }
+    if (o->rs[rs_idx] > t) {
+        if (o->rs[rs_idx] > prev) {
+            o->stalls[STALL_RS] += o->rs[rs_idx] - (t > prev ? t : prev);
+        }
+        t = o->rs[rs_idx];
+    }
+    dispatch = inorder_slot(&o->dispatch, t, width);
+
+    /* Issue, once operands and a unit are available. */
+    t = dispatch + 1;
+    prev = t;
+    if (o->ready[d->src1] > t) { t = o->ready[d->src1]; }
+    if (o->ready[d->src2] > t) { t = o->ready[d->src2]; }
+    if (d->reads_hilo && (o->ready[HILO] > t)) { t = o->ready[HILO]; }
+    o->stalls[STALL_OPERANDS] += t - prev;
+
+    fu = fu_of(d);
+    prev = t;
+    if (fu == FU_DIV) {
+        /* Dividers aren't pipelined: take the first to finish. */
+        for (i = 1; i < o->p[PARAM_DIV]; i++) {
+            if (o->div_free[i] < o->div_free[div_idx]) {
+                div_idx = i;
+            }
+        }
+        if (o->div_free[div_idx] > t) {
+            t = o->div_free[div_idx];
+        }
+    }
+    while (!slot_free(&o->issue, t, width) ||
+           !slot_free(&o->fu[fu], t, o->p[PARAM_ALU + fu])) {
+        t++;
+    }
+    o->stalls[STALL_FU] += t - prev;
+    issue = t;
+    slot_take(&o->issue, issue);
+    slot_take(&o->fu[fu], issue);
+    o->rs[rs_idx] = issue;
+
+    switch (d->cls) {
+    case UARCH_CLASS_LOAD:
+        lat = o->p[PARAM_LAT_LOAD] + dlat;
+        break;
+    case UARCH_CLASS_MULT:
+        lat = o->p[PARAM_LAT_MUL];
+        break;
+    case UARCH_CLASS_DIV:
+        lat = o->p[PARAM_LAT_DIV];
+        o->div_free[div_idx] = issue + lat;
+        break;
+    default:
+        lat = o->p[PARAM_LAT_ALU];
+        break;
+    }
+    complete = issue + lat;
+    if (d->dst != UARCH_NO_REG) {
+        o->ready[d->dst] = complete;
+    }
+    if (d->writes_hilo) {
+        o->ready[HILO] = complete;
+    }
+
+    /* Commit, in order. */
+    commit = inorder_slot(&o->commit, complete + 1, width);
+    o->rob[o->seq % o->p[PARAM_ROB]] = commit;
+    o->seq++;
+
+    if (rec->flags & UARCH_EXC) {
+        o->excs++;
+        if (commit + 1 > o->redirect) {
+            o->redirect = commit + 1;
+            o->redirect_cause = STALL_FRONTEND;
+        }
+        return;
+    }
+    o->insts++;
+
+    if ((d->cls == UARCH_CLASS_BRANCH) || (d->cls == UARCH_CLASS_JUMP) ||
+        (d->cls == UARCH_CLASS_JUMP_REG)) {
+        mispredict = bpred_update(o->bp, rec, d);
+    }
+    if (mispredict) {
+        o->mispredicts++;
+        if (complete + 1 > o->redirect) {
+            o->redirect = complete + 1;
+            o->redirect_cause = STALL_FRONTEND;
+        }
+    }
+}
+
+uint64_t ooo_cycles(ooo_t *o)
+{
+    return o->seq ? o->commit.cycle : 0;
+}
+
+void ooo_report(ooo_t *o, FILE *out)
+{
+    uint64_t cycles = ooo_cycles(o);
+    int i;
+
+    fprintf(out, "ooo:");
+    for (i = 0; i < NUM_PARAMS; i++) {
+        fprintf(out, " %s=%u", param_names[i], o->p[i]);
+    }
+    fprintf(out, "\n");
+    fprintf(out, "ooo: %llu instructions, %llu exceptions, %llu cycles, "
+            "IPC %.3f, %llu mispredicts\n",
+            (unsigned long long)o->insts, (unsigned long long)o->excs,
+            (unsigned long long)cycles,
+            cycles ? (double)o->insts / cycles : 0.0,
+            (unsigned long long)o->mispredicts);
+    fprintf(out, "ooo: delay cycles, summed over instructions:");
+    for (i = 0; i < NUM_STALLS; i++) {
+        fprintf(out, " %s %llu", stall_names[i],
+                (unsigned long long)o->stalls[i]);
+    }
+    fprintf(out, "\n");
+}
+
+static uint64_t inorder_slot(struct inorder *s, uint64_t earliest,
+                             unsigned width)
+{
+    if (earliest > s->cycle) {
+        s->cycle = earliest;
+        s->count = 0;
+    } else if (s->count == width) {
+        s->cycle++;
+        s->count = 0;
+    }
+    s->count++;
+    return s->cycle;
+}
+
+static int slot_free(struct slots *s, uint64_t cycle, unsigned limit)
+{
+    unsigned i = cycle % SLOT_RING;
+
+    return (s->cycle[i] != cycle) || (s->used[i] < limit);
+}
+
+static void slot_take(struct slots *s, uint64_t cycle)
+{
+    unsigned i = cycle % SLOT_RING;
+
+    if (s->cycle[i] != cycle) {
+        s->cycle[i] = cycle;
+        s->used[i] = 0;
+    }
+    s->used[i]++;
+}
+
+static int fu_of(const uarch_dec_t *d)
+{
+    switch (d->cls) {
+    case UARCH_CLASS_LOAD:
+    case UARCH_CLASS_STORE:
+        return FU_MEM;
+    case UARCH_CLASS_MULT:
+        return FU_MUL;
+    case UARCH_CLASS_DIV:
+        return FU_DIV;
+    default:
+        return FU_ALU;
+    }
+}
+
+static int parse_params(ooo_t *o, char *spec)
+{
+    char *p, *colon, *eq, *end;
+    unsigned long v;
+    int i;
+
+    for (p = spec; p && *p; p = colon ? colon + 1 : NULL) {
+        colon = strchr(p, ':');
+        eq = strchr(p, '=');
+        if (!eq || (colon && (eq > colon))) {
+            goto bad;
+        }
+        for (i = 0; i < NUM_PARAMS; i++) {
+            if ((strlen(param_names[i]) == (size_t)(eq - p)) &&
+                !strncmp(param_names[i], p, eq - p)) {
+                break;
+            }
+        }
+        if (i == NUM_PARAMS) {
+            goto bad;
+        }
+        v = strtoul(eq + 1, &end, 10);
+        if ((end == eq + 1) || ((*end != ':') && (*end != '\0')) ||
+            (v < 1) || (v > 4096)) {
+            goto bad;
+        }
+        o->p[i] = v;
+    }
+
+    return 0;
+
+bad:
+    debug_printf(CONFIG, FATAL,
+            "--uarch ooo: invalid parameters \"%s\" (expected "
+            "<param>=<value>[:...] with values 1-4096)\n", spec);
+    return 1;
+}
@@ -0,0 +1,18 @@
+#ifndef OOO_H
+#define OOO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "uarch.h"
+
+typedef struct ooo ooo_t;
+
+ooo_t *ooo_create_spec(char *spec);
+void ooo_destroy(ooo_t *o);
+void ooo_commit(ooo_t *o, const uarch_rec_t *rec, const uarch_dec_t *d,
+                unsigned ilat, unsigned dlat);
+uint64_t ooo_cycles(ooo_t *o);
+void ooo_report(ooo_t *o, FILE *out);
+
+#endif
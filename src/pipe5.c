@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe5.h"
+#include "uarch.h"
+#include "util.h"
+
+/*
+ A classic IF/ID/EX/MEM/WB pipeline with full forwarding and no delay slots
+ (matching the functional core).  Rather than moving instructions between
+ stage latches, we compute the cycle each instruction occupies EX from the
+ constraints on it, which is all that is needed for cycle counts:
+
+  - one cycle after the previous instruction's EX;
+  - after any front-end bubbles from the previous instruction (taken
+    branches and JR/JALR resolve in EX, J/JAL in ID, exceptions in MEM);
+  - after an I-cache miss on its own fetch;
+  - when its source registers can be forwarded (loads one cycle late; store
+    data is only needed in MEM);
+  - when the unpipelined multiply/divide unit and HI/LO are ready.
+
+ A D-cache miss holds MEM, and so everything behind it, for the miss latency.
+ */
+#define BRANCH_PENALTY 2
+#define JUMP_PENALTY   1
+#define EXC_PENALTY    3
+#define MULT_LATENCY   4
+#define DIV_LATENCY    32
+
+enum {
+    STALL_LOAD_USE,
+    STALL_BRANCH,
+    STALL_JUMP,
+    STALL_MULDIV,
+    STALL_EXC,
+    STALL_ICACHE,
+    STALL_DCACHE,
+    NUM_STALLS
+};
+
+static const char *stall_names[] = {
+    [STALL_LOAD_USE] = "load-use",
+    [STALL_BRANCH] = "branch",
+    [STALL_JUMP] = "jump",
+    [STALL_MULDIV] = "mult/div",
+    [STALL_EXC] = "exception",
+    [STALL_ICACHE] = "icache",
+    [STALL_DCACHE] = "dcache"
+};
+
+struct pipe5 {
+    uint64_t ex;                /* EX cycle of the last instruction. */
+    uint64_t front;             /* Earliest EX for the next instruction. */
+    int front_cause;
+    uint64_t ready[32];         /* Earliest EX that can consume each reg. */
+    int ready_cause[32];
+    uint64_t hilo_ready;
+    uint64_t muldiv_free;
+
+    uint64_t insts;
+    uint64_t excs;
+    uint64_t stalls[NUM_STALLS];
+};
+
+static uint64_t wait_for(pipe5_t *p, uint64_t t, uint64_t until, int cause);
+static void redirect(pipe5_t *p, uint64_t front, int cause);
+
+pipe5_t *pipe5_create(void)
+{
+    pipe5_t *p = xmalloc(sizeof(*p));
+    memset(p, 0, sizeof(*p));
+    /* So the first instruction is in IF on cycle 1 and EX on cycle 3. */
+    p->ex = 2;
+    return p;
+}
+
+void pipe5_destroy(pipe5_t *p)
+{
+    free(p);
+}
+
+void pipe5_commit(pipe5_t *p, const uarch_rec_t *rec, const uarch_dec_t *d,
+                  unsigned ilat, unsigned dlat)
+{
+    uint64_t t = p->ex + 1;
+
+    t = wait_for(p, t, p->front, p->front_cause);
+    t = wait_for(p, t, t + ilat, STALL_ICACHE);
+
+    t = wait_for(p, t, p->ready[d->src1], p->ready_cause[d->src1]);
+    if ((d->cls == UARCH_CLASS_STORE) && p->ready[d->src2]) {
+        t = wait_for(p, t, p->ready[d->src2] - 1, p->ready_cause[d->src2]);
+    } else {
+        t = wait_for(p, t, p->ready[d->src2], p->ready_cause[d->src2]);
+    }
+
+    if (d->reads_hilo) {
+        t = wait_for(p, t, p->hilo_ready, STALL_MULDIV);
+    }
+    if (d->writes_hilo) {
+        t = wait_for(p, t, p->muldiv_free, STALL_MULDIV);
+        if (d->cls == UARCH_CLASS_MULT) {
+            p->muldiv_free = p->hilo_ready = t + MULT_LATENCY;
+        } else if (d->cls == UARCH_CLASS_DIV) {
+            p->muldiv_free = p->hilo_ready = t + DIV_LATENCY;
+        } else {
+            p->hilo_ready = t + 1;
+        }
+    }
+
+    p->ex = t;
+
+    if (rec->flags & UARCH_EXC) {
+        p->excs++;
+        redirect(p, t + 1 + EXC_PENALTY, STALL_EXC);
+        return;
+    }
+
+    p->insts++;
+    if (d->dst != UARCH_NO_REG) {
+        if (d->cls == UARCH_CLASS_LOAD) {
+            p->ready[d->dst] = t + 2 + dlat;
+            p->ready_cause[d->dst] = STALL_LOAD_USE;
+        } else {
+            p->ready[d->dst] = t + 1;
+        }
+    }
+    if (dlat) {
+        redirect(p, t + 1 + dlat, STALL_DCACHE);
+    }
+
+    if (rec->next_pc != rec->pc + 4) {
+        if (d->cls == UARCH_CLASS_JUMP) {
+            redirect(p, t + 1 + JUMP_PENALTY, STALL_JUMP);
+        } else if ((d->cls == UARCH_CLASS_BRANCH) ||
+                   (d->cls == UARCH_CLASS_JUMP_REG)) {
+            redirect(p, t + 1 + BRANCH_PENALTY, STALL_BRANCH);
+        }
+    }
+}
+
+uint64_t pipe5_cycles(pipe5_t *p)
+{
+    return (p->insts || p->excs) ? p->ex + 2 : 0;
+}
+
+void pipe5_report(pipe5_t *p, FILE *out)
+{
+    uint64_t cycles = pipe5_cycles(p);
+    int i;
+
+    fprintf(out, "pipeline5: %llu instructions, %llu exceptions, "
+            "%llu cycles, CPI %.3f\n",
+            (unsigned long long)p->insts, (unsigned long long)p->excs,
+            (unsigned long long)cycles,
+            p->insts ? (double)cycles / p->insts : 0.0);
+    fprintf(out, "pipeline5: stall cycles:");
+    for (i = 0; i < NUM_STALLS; i++) {
+        fprintf(out, " %s %llu", stall_names[i],
+                (unsigned long long)p->stalls[i]);
+    }
+    fprintf(out, "\n");
+}
+
+static uint64_t wait_for(pipe5_t *p, uint64_t t, uint64_t until, int cause)
+{
+    if (until > t) {
+        p->stalls[cause] += until - t;
+        return until;
+    }
+    return t;
+}
+
+static void redirect(pipe5_t *p, uint64_t front, int cause)
+{
+    if (front > p->front) {
+        p->front = front;
+        p->front_cause = cause;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef PIPE5_H
+#define PIPE5_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "uarch.h"
+
+typedef struct pipe5 pipe5_t;
+
+pipe5_t *pipe5_create(void);
+void pipe5_destroy(pipe5_t *p);
+void pipe5_commit(pipe5_t *p, const uarch_rec_t *rec, const uarch_dec_t *d,
+                  unsigned ilat, unsigned dlat);
+uint64_t pipe5_cycles(pipe5_t *p);
+void pipe5_report(pipe5_t *p, FILE *out);
+
+#endif
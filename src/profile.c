@@ -0,0 +1,341 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "opcode.h"
+#include "profile.h"
+#include "sym.h"
+#include "util.h"
+
+/*
+ A guest profiler.  Every period retired instructions we take a sample: the
+ PC goes into a histogram, and the current node of a calling-context tree
+ gets a hit.  The tree follows calls (JAL, JALR, BLTZAL/BGEZAL when taken,
+ and exceptions) and returns (JR $31 and ERET) on every instruction, not just
+ sampled ones, so it stays in step with the guest.  Nodes are identified by
+ the entry address of the function they stand for.
+
+ At halt we print a flat profile by function and the hottest PCs, and write
+ the tree as collapsed stacks ("a;b;c <samples>" per line) for flame graph
+ tools.
+ */
+#define MAX_DEPTH 1024
+#define NO_NODE UINT32_MAX
+#define HOT_INIT_SIZE 1024
+#define REPORT_FUNCS 20
+#define REPORT_PCS 10
+
+struct node {
+    uint32_t entry;
+    uint32_t parent;
+    uint32_t child;
+    uint32_t sibling;
+    uint64_t self;
+};
+
+struct hot {
+    uint32_t pc;
+    uint64_t count;             /* 0 if the slot is free. */
+};
+
+struct profile {
+    uint64_t period;
+    uint64_t countdown;
+    symtab_t *syms;
+
+    struct node *nodes;
+    uint32_t nnodes, cap;
+    uint32_t cur;
+    unsigned depth;
+    unsigned overflow;          /* Calls past MAX_DEPTH not yet returned. */
+
+    struct hot *hot;
+    uint32_t hot_size, nhot;
+    uint64_t samples;
+};
+
+struct total {
+    uint32_t key;
+    uint64_t count;
+};
+
+static void call(profile_t *p, uint32_t entry);
+static void ret(profile_t *p);
+static uint32_t new_node(profile_t *p, uint32_t entry, uint32_t parent);
+static void sample(profile_t *p, uint32_t pc);
+static void hot_grow(profile_t *p);
+static const char *name_of(profile_t *p, uint32_t addr, char *buf);
+static void write_stack(profile_t *p, FILE *out, uint32_t n);
+static int cmp_total(const void *a, const void *b);
+
+profile_t *profile_create(uint64_t period, symtab_t *syms)
+{
+    profile_t *p = xmalloc(sizeof(*p));
+
+    p->period = p->countdown = period;
+    p->syms = syms;
+    p->nodes = NULL;
+    p->nnodes = p->cap = 0;
+    p->cur = NO_NODE;
+    p->depth = 0;
+    p->overflow = 0;
+    p->hot_size = HOT_INIT_SIZE;
+    p->hot = xmalloc(p->hot_size * sizeof(*p->hot));
+    memset(p->hot, 0, p->hot_size * sizeof(*p->hot));
+    p->nhot = 0;
+    p->samples = 0;
+    return p;
+}
+
+void profile_destroy(profile_t *p)
+{
+    free(p->nodes);
+    free(p->hot);
+    free(p);
+}
+
+/* Called for every retired instruction. */
+void profile_step(profile_t *p, uint32_t pc, uint32_t ins, uint32_t next_pc)
+{
+    if (p->cur == NO_NODE) {
+        p->cur = new_node(p, pc, NO_NODE);
+    }
+    if (!--p->countdown) {
+        p->countdown = p->period;
+        sample(p, pc);
+    }
+
+    switch (OP(ins)) {
+    case OP_JAL:
+        call(p, next_pc);
+        break;
+    case OP_SPECIAL:
+        if (FUNCT(ins) == FUNCT_JALR) {
+            call(p, next_pc);
+        } else if ((FUNCT(ins) == FUNCT_JR) && (RS(ins) == 31)) {
+            ret(p);
+        }
+        break;
+    case OP_REGIMM:
+        if (((RT(ins) == REGIMM_BLTZAL) || (RT(ins) == REGIMM_BGEZAL)) &&
+            (next_pc != pc + 4)) {
+            call(p, next_pc);
+        }
+        break;
+    case OP_COP0:
+        if ((RS(ins) & 020) && (FUNCT(ins) == CP0_FUNCT_ERET)) {
+            ret(p);
+        }
+        break;
+    }
+}
+
+/* Called instead of profile_step when an instruction takes an exception. */
+void profile_except(profile_t *p, uint32_t handler)
+{
+    if (p->cur != NO_NODE) {
+        call(p, handler);
+    }
+}
+
+void profile_report(profile_t *p, FILE *out)
+{
+    struct total *funcs, *pcs;
+    uint32_t i, j, nfuncs = 0, npcs = 0, off;
+    char buf[16];
+    const char *name;
+
+    funcs = xmalloc((p->nnodes + 1) * sizeof(*funcs));
+    for (i = 0; i < p->nnodes; i++) {
+        if (!p->nodes[i].self) {
+            continue;
+        }
+        for (j = 0; j < nfuncs; j++) {
+            if (funcs[j].key == p->nodes[i].entry) {
+                break;
+            }
+        }
+        if (j == nfuncs) {
+            funcs[nfuncs].key = p->nodes[i].entry;
+            funcs[nfuncs++].count = 0;
+        }
+        funcs[j].count += p->nodes[i].self;
+    }
+    qsort(funcs, nfuncs, sizeof(*funcs), cmp_total);
+
+    fprintf(out, "profile: %llu samples, one every %llu instructions\n",
+            (unsigned long long)p->samples, (unsigned long long)p->period);
+    fprintf(out, "profile: flat, by function entry:\n");
+    for (i = 0; (i < nfuncs) && (i < REPORT_FUNCS); i++) {
+        fprintf(out, "  %6.2f%%  %10llu  %s\n",
+                100.0 * funcs[i].count / p->samples,
+                (unsigned long long)funcs[i].count,
+                name_of(p, funcs[i].key, buf));
+    }
+    free(funcs);
+
+    pcs = xmalloc((p->nhot + 1) * sizeof(*pcs));
+    for (i = 0; i < p->hot_size; i++) {
+        if (p->hot[i].count) {
+            pcs[npcs].key = p->hot[i].pc;
+            pcs[npcs++].count = p->hot[i].count;
+        }
+    }
+    qsort(pcs, npcs, sizeof(*pcs), cmp_total);
+
+    fprintf(out, "profile: hottest PCs:\n");
+    for (i = 0; (i < npcs) && (i < REPORT_PCS); i++) {
+        name = p->syms ? sym_lookup(p->syms, pcs[i].key, &off) : NULL;
+        fprintf(out, "  %6.2f%%  %10llu  %08x", 100.0 * pcs[i].count /
+                p->samples, (unsigned long long)pcs[i].count, pcs[i].key);
+        if (name) {
+            fprintf(out, "  %s+0x%x", name, off);
+        }
+        fprintf(out, "\n");
+    }
+    free(pcs);
+}
+
+void profile_write_folded(profile_t *p, FILE *out)
+{
+    uint32_t i;
+
+    for (i = 0; i < p->nnodes; i++) {
+        if (p->nodes[i].self) {
+            write_stack(p, out, i);
+            fprintf(out, " %llu\n", (unsigned long long)p->nodes[i].self);
+        }
+    }
+}
+
+static void call(profile_t *p, uint32_t entry)
+{
+    uint32_t n;
+
+    if (p->depth == MAX_DEPTH) {
+        p->overflow++;
+        return;
+    }
+    for (n = p->nodes[p->cur].child; n != NO_NODE; n = p->nodes[n].sibling) {
+        if (p->nodes[n].entry == entry) {
+            break;
+        }
+    }
+    if (n == NO_NODE) {
+        n = new_node(p, entry, p->cur);
+    }
+    p->cur = n;
+    p->depth++;
+}
+
+static void ret(profile_t *p)
+{
+    if (p->overflow) {
+        p->overflow--;
+    } else if (p->nodes[p->cur].parent != NO_NODE) {
+        p->cur = p->nodes[p->cur].parent;
+        p->depth--;
+    }
+}
+
+static uint32_t new_node(profile_t *p, uint32_t entry, uint32_t parent)
+{
+    struct node *n;
+
+    if (p->nnodes == p->cap) {
+        p->cap = p->cap ? 2 * p->cap : 256;
+        p->nodes = xrealloc(p->nodes, p->cap * sizeof(*p->nodes));
+    }
+    n = &p->nodes[p->nnodes];
+    n->entry = entry;
+    n->parent = parent;
+    n->child = NO_NODE;
+    n->self = 0;
+    if (parent != NO_NODE) {
+        n->sibling = p->nodes[parent].child;
+        p->nodes[parent].child = p->nnodes;
+    } else {
+        n->sibling = NO_NODE;
+    }
+    return p->nnodes++;
+}
+
+static void sample(profile_t *p, uint32_t pc)
+{
+    uint32_t i;
+
+    p->samples++;
+    p->nodes[p->cur].self++;
+
+    for (i = (pc >> 2) * 2654435761u; ; i++) {
+        i &= p->hot_size - 1;
+        if (p->hot[i].pc == pc && p->hot[i].count) {
+            p->hot[i].count++;
+            return;
+        }
+        if (!p->hot[i].count) {
+            break;
+        }
+    }
+    p->hot[i].pc = pc;
+    p->hot[i].count = 1;
+    if (2 * ++p->nhot > p->hot_size) {
+        hot_grow(p);
+    }
+}
+
+static void hot_grow(profile_t *p)
+{
+    struct hot *old = p->hot;
+    uint32_t old_size = p->hot_size, i, j;
+
+    p->hot_size *= 2;
+    p->hot = xmalloc(p->hot_size * sizeof(*p->hot));
+    memset(p->hot, 0, p->hot_size * sizeof(*p->hot));
+    for (i = 0; i < old_size; i++) {
+        if (!old[i].count) {
+            continue;
+        }
+        for (j = (old[i].pc >> 2) * 2654435761u; ; j++) {
+            j &= p->hot_size - 1;
+            if (!p->hot[j].count) {
+                break;
+            }
+        }
+        p->hot[j] = old[i];
+    }
+    free(old);
+}
+
+/* buf must hold at least 11 characters. */
+static const char *name_of(profile_t *p, uint32_t addr, char *buf)
+{
+    const char *name = p->syms ? sym_lookup(p->syms, addr, NULL) : NULL;
+
+    if (name) {
+        return name;
+    }
+    sprintf(buf, "0x%08x", addr);
+    return buf;
+}
+
+static void write_stack(profile_t *p, FILE *out, uint32_t n)
+{
+    char buf[16];
+
+    if (p->nodes[n].parent != NO_NODE) {
+        write_stack(p, out, p->nodes[n].parent);
+        fputc(';', out);
+    }
+    fputs(name_of(p, p->nodes[n].entry, buf), out);
+}
+
+static int cmp_total(const void *a, const void *b)
+{
+    const struct total *x = a, *y = b;
+
+    return (x->count < y->count) - (x->count > y->count);
+}
@@ -0,0 +1,18 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sym.h"
+
+typedef struct profile profile_t;
+
+profile_t *profile_create(uint64_t period, symtab_t *syms);
+void profile_destroy(profile_t *p);
+void profile_step(profile_t *p, uint32_t pc, uint32_t ins, uint32_t next_pc);
+void profile_except(profile_t *p, uint32_t handler);
+void profile_report(profile_t *p, FILE *out);
+void profile_write_folded(profile_t *p, FILE *out);
+
+#endif
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "debug.h"
 #include "ram.h"
@@ -10,8 +11,8 @@
 static int ram_read(mem_dev_t *ram, uint32_t offset, uint32_t *val_out);
 static int ram_write(mem_dev_t *ram, uint32_t offset, uint32_t val,
                      uint8_t we);
-
-static uint32_t we_to_mask(uint8_t we);
+static void *ram_map(mem_dev_t *ram, uint32_t offset, uint32_t len,
+                     int write);
 
 typedef struct ram_dev ram_dev_t;
 struct ram_dev {
@@ -19,10 +20,15 @@ struct ram_dev {
     void *data;
 };
 
+#define MARK_DIRTY(ram, offset) \
+        ((ram)->dev.dirty[(offset) >> (MEM_DEV_PAGE_SHIFT + 5)] |= \
+         1u << (((offset) >> MEM_DEV_PAGE_SHIFT) & 31))
+
 mem_dev_t *ram_create(uint32_t size)
 {
     ram_dev_t *d;
     uint32_t i, *p;
+    size_t dirty_size;
 
     assert(!(size & 0x3));
 
@@ -32,6 +38,14 @@ mem_dev_t *ram_create(uint32_t size)
     d->dev.size = size;
     d->dev.read = &ram_read;
     d->dev.write = &ram_write;
+    d->dev.map = &ram_map;
+    d->dev.state_size = 0;
+    d->dev.save = NULL;
+    d->dev.restore = NULL;
+    dirty_size = (((size_t)size >> MEM_DEV_PAGE_SHIFT) / 32 + 1) *
+                 sizeof(uint32_t);
+    d->dev.dirty = xmalloc(dirty_size);
+    memset(d->dev.dirty, 0, dirty_size);
     d->data = xmalloc(size);
 
     p = (uint32_t *)d->data;
@@ -48,6 +62,7 @@ void ram_destroy(mem_dev_t *dev)
     assert(ram->dev.read == &ram_read);
 
     free(ram->data);
+    free(ram->dev.dirty);
     free(ram);
 }
 
@@ -71,14 +86,21 @@ static int ram_write(mem_dev_t *dev, uint32_t offset, uint32_t val, uint8_t we)
     w = (uint32_t *)((uint8_t *)ram->data + offset);
     mask = we_to_mask(we);
     *w = (*w & ~mask) | (val & mask);
+    MARK_DIRTY(ram, offset);
 
     return 0;
 }
 
-static uint32_t we_to_mask(uint8_t we)
+static void *ram_map(mem_dev_t *dev, uint32_t offset, uint32_t len, int write)
 {
-    return ((we & 8) ? 0xFF000000 : 0) |
-           ((we & 4) ? 0x00FF0000 : 0) |
-           ((we & 2) ? 0x0000FF00 : 0) |
-           ((we & 1) ? 0x000000FF : 0);
+    ram_dev_t *ram = (ram_dev_t *)dev;
+    uint32_t page;
+
+    if (write && len) {
+        for (page = offset & ~(MEM_DEV_PAGE - 1); page < offset + len;
+             page += MEM_DEV_PAGE) {
+            MARK_DIRTY(ram, page);
+        }
+    }
+    return (uint8_t *)ram->data + offset;
 }
@@ -58,6 +58,19 @@ int readmemh_load(mem_t *mem, uint32_t base, char *file)
             at++;
         } else if (isspace(c)) {
             ret = 0;
+        } else if (c == '/') {
+            /* A // comment, running to the end of the line. */
+            if ((fread(&c, 1, 1, ctx.f) != 1) || (c != '/')) {
+                debug_printf(READMEMH, ERROR, "%s:%d: expected \"//\"\n",
+                        file, ctx.line);
+                return 1;
+            }
+            while (((ret = fread(&c, 1, 1, ctx.f)) == 1) && (c != '\n'))
+                ;
+            if (ret == 1) {
+                ctx.line++;
+            }
+            ret = 0;
         } else {
             debug_printf(READMEMH, ERROR, "%s:%d: invalid character '%c'\n",
                     file, ctx.line, c);
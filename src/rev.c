@@ -0,0 +1,624 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "debug.h"
+#include "err.h"
+#include "mem.h"
+#include "mem_dev.h"
+#include "rev.h"
+#include "rr.h"
+#include "util.h"
+
+/*
+ The checkpoint file is a header followed by one record per checkpoint, all
+ in host byte order:
+
+   header:  "TMIPSCK1", u32 core state size, u32 device state size,
+            u32 number of memory regions, then u32 base and u32 size of each
+   record:  u64 step, core state, device state, then for each region
+            u32 page count and that many u32 page index + page contents
+
+ The first record has every page; later ones only those changed since the
+ record before, so a checkpoint is restored by applying every record up to
+ and including it, in order.
+ */
+#define CKPT_MAGIC "TMIPSCK1"
+
+/* A RAM page as it was at some checkpoint. */
+struct rev_page {
+    uint32_t index;
+    uint8_t *data;
+};
+
+/* The pages of one memory region that changed since the last checkpoint. */
+struct rev_delta {
+    unsigned npages;
+    struct rev_page *pages;
+};
+
+struct rev_mem {
+    mem_dev_t *dev;
+    uint32_t base;
+    uint8_t *data;
+    uint32_t size;
+    uint32_t npages;
+    uint32_t *dirty;            /* The device's, or NULL to compare pages. */
+    uint8_t **latest;           /* Each page as of the last checkpoint. */
+    uint8_t *need;              /* Scratch for restore. */
+};
+
+struct ckpt {
+    uint64_t step;
+    long mark;                  /* Position in the rr log. */
+    uint8_t *core;
+    uint8_t *devs;
+    struct rev_delta *deltas;   /* One per memory region. */
+};
+
+/* The checkpointable parts of a machine. */
+struct machine {
+    struct rev_mem *mems;
+    unsigned nmems;
+    mem_dev_t **devs;
+    unsigned ndevs;
+    size_t devs_size;
+};
+
+struct rev {
+    core_t *core;
+    uint64_t interval;
+    uint64_t step;
+    uint64_t frontier;          /* Furthest step ever reached. */
+    struct machine m;
+    FILE *out;
+    char *out_name;
+
+    struct ckpt *ckpts;
+    unsigned nckpts;
+    unsigned cap;
+    uint64_t saved_pages;
+};
+
+static void find_machine(struct machine *m, mem_t *mem);
+static void free_machine(struct machine *m);
+static void save_devs(struct machine *m, uint8_t *buf);
+static void restore_devs(struct machine *m, const uint8_t *buf);
+static void checkpoint(rev_t *r);
+static void write_header(rev_t *r);
+static void write_ckpt(rev_t *r, struct ckpt *ck);
+static void restore(rev_t *r, unsigned k);
+static unsigned find_ckpt(rev_t *r, uint64_t step);
+static uint32_t page_len(struct rev_mem *m, uint32_t index);
+
+/*
+ Memory regions are found once, here, so map everything before creating
+ this.  Without a record or replay log, input is recorded to a temporary
+ one so that it can be replayed.  If file isn't NULL, checkpoints are also
+ written to it, for rev_load.
+ */
+rev_t *rev_create(core_t *core, mem_t *mem, uint64_t interval, char *file)
+{
+    rev_t *r;
+    FILE *out = NULL;
+
+    assert(interval > 0);
+
+    if (file) {
+        out = fopen(file, "wb");
+        if (!out) {
+            debug_printf(REV, FATAL, "Couldn't create \"%s\": %s\n",
+                    file, strerror(errno));
+            return NULL;
+        }
+    }
+    if (!rr_active() && rr_record(NULL, core_get_sched(core))) {
+        if (out) {
+            fclose(out);
+        }
+        return NULL;
+    }
+
+    r = xmalloc(sizeof(*r));
+    r->core = core;
+    r->interval = interval;
+    r->step = r->frontier = 0;
+    r->out = out;
+    r->out_name = file;
+    r->ckpts = NULL;
+    r->nckpts = r->cap = 0;
+    r->saved_pages = 0;
+    find_machine(&r->m, mem);
+
+    if (r->out) {
+        write_header(r);
+    }
+    checkpoint(r);
+    return r;
+}
+
+void rev_destroy(rev_t *r)
+{
+    unsigned i, j, k;
+
+    for (i = 0; i < r->nckpts; i++) {
+        for (j = 0; j < r->m.nmems; j++) {
+            for (k = 0; k < r->ckpts[i].deltas[j].npages; k++) {
+                free(r->ckpts[i].deltas[j].pages[k].data);
+            }
+            free(r->ckpts[i].deltas[j].pages);
+        }
+        free(r->ckpts[i].deltas);
+        free(r->ckpts[i].core);
+        free(r->ckpts[i].devs);
+    }
+    free(r->ckpts);
+    free_machine(&r->m);
+    if (r->out) {
+        fclose(r->out);
+    }
+    free(r);
+}
+
+/*
+ Steps the core, quietly if this is a re-execution of steps we've already
+ shown, and takes a checkpoint if one is due.  Checkpoints are only ever
+ added past the last one: re-execution is exact, so the later ones stay
+ valid when we go back.
+ */
+int rev_step(rev_t *r)
+{
+    int ret;
+
+    rr_set_silent(r->step < r->frontier);
+    ret = core_step(r->core);
+    /* Traps stop before the instruction, which then runs next time. */
+    if ((ret == ERR_BREAK) || (ret == ERR_WATCH)) {
+        return ret;
+    }
+    r->step++;
+    if (r->step > r->frontier) {
+        r->frontier = r->step;
+    }
+    if (r->step >= r->ckpts[r->nckpts - 1].step + r->interval) {
+        checkpoint(r);
+    }
+
+    return ret;
+}
+
+uint64_t rev_get_step(rev_t *r)
+{
+    return r->step;
+}
+
+/*
+ Goes to the given step, backwards or forwards.  Returns whatever the last
+ core_step did, so nonzero if the core halts first.  Breakpoints and
+ watchpoints don't go off on the way.
+ */
+int rev_goto(rev_t *r, uint64_t step)
+{
+    trap_t *trap = core_get_trap(r->core);
+    int ret = 0;
+
+    core_set_trap(r->core, NULL);
+    if (step < r->step) {
+        restore(r, find_ckpt(r, step));
+    }
+    while (!ret && (r->step < step)) {
+        ret = rev_step(r);
+    }
+    rr_set_silent(0);
+    core_set_trap(r->core, trap);
+
+    return ret;
+}
+
+/*
+ Goes back to the last step before this one at which stop returns nonzero,
+ searching one checkpoint interval at a time, most recent first.  Returns
+ 1 if there was one, or 0 (having gone back to the start) if not.
+ */
+int rev_reverse_continue(rev_t *r, rev_stop_fn stop, void *arg)
+{
+    trap_t *trap = core_get_trap(r->core);
+    uint64_t end = r->step, seg_end, found = 0;
+    int hit = 0;
+    unsigned k;
+
+    if (end == 0) {
+        return 0;
+    }
+    core_set_trap(r->core, NULL);
+    for (k = find_ckpt(r, end - 1) + 1; !hit && k-- > 0; ) {
+        restore(r, k);
+        seg_end = (k + 1 < r->nckpts && r->ckpts[k + 1].step < end)
+                ? r->ckpts[k + 1].step : end;
+        while (r->step < seg_end) {
+            if (stop(r->core, arg)) {
+                found = r->step;
+                hit = 1;
+            }
+            if (rev_step(r)) {
+                break;
+            }
+        }
+    }
+    core_set_trap(r->core, trap);
+
+    rev_goto(r, found);
+    return hit;
+}
+
+/*
+ Loads checkpoint n (or the last one, if n is negative or past the end)
+ from a file written by rev_create into a machine mapped the same way.
+ */
+int rev_load(core_t *core, mem_t *mem, char *file, long n)
+{
+    struct machine m;
+    struct rev_mem *rm;
+    FILE *f;
+    char magic[8];
+    uint32_t hdr[3], region[2], npages, index;
+    uint64_t step = 0, this_step;
+    uint8_t *core_buf, *devs_buf;
+    size_t core_size = core_state_size();
+    unsigned j;
+    long i;
+    int ret = 1;
+
+    f = fopen(file, "rb");
+    if (!f) {
+        debug_printf(REV, FATAL, "Couldn't open \"%s\": %s\n",
+                file, strerror(errno));
+        return 1;
+    }
+    find_machine(&m, mem);
+    core_buf = xmalloc(core_size);
+    devs_buf = xmalloc(m.devs_size + 1);
+
+    if ((fread(magic, sizeof(magic), 1, f) != 1) ||
+        memcmp(magic, CKPT_MAGIC, sizeof(magic)) ||
+        (fread(hdr, sizeof(hdr), 1, f) != 1)) {
+        debug_printf(REV, FATAL, "\"%s\" is not a tmips checkpoint file\n",
+                file);
+        goto out;
+    }
+    if ((hdr[0] != core_size) || (hdr[1] != m.devs_size) ||
+        (hdr[2] != m.nmems)) {
+        debug_printf(REV, FATAL, "\"%s\" was written by a differently "
+                "configured machine\n", file);
+        goto out;
+    }
+    for (j = 0; j < m.nmems; j++) {
+        if ((fread(region, sizeof(region), 1, f) != 1) ||
+            (region[0] != m.mems[j].base) || (region[1] != m.mems[j].size)) {
+            debug_printf(REV, FATAL, "\"%s\" has a different memory map\n",
+                    file);
+            goto out;
+        }
+    }
+
+    for (i = 0; (n < 0) || (i <= n); i++) {
+        if (fread(&this_step, sizeof(this_step), 1, f) != 1) {
+            break;
+        }
+        if ((fread(core_buf, core_size, 1, f) != 1) ||
+            (m.devs_size && (fread(devs_buf, m.devs_size, 1, f) != 1))) {
+            goto truncated;
+        }
+        for (j = 0; j < m.nmems; j++) {
+            rm = &m.mems[j];
+            if (fread(&npages, sizeof(npages), 1, f) != 1) {
+                goto truncated;
+            }
+            while (npages--) {
+                if ((fread(&index, sizeof(index), 1, f) != 1) ||
+                    (index >= rm->npages) ||
+                    (fread(rm->data + index * MEM_DEV_PAGE,
+                           page_len(rm, index), 1, f) != 1)) {
+                    goto truncated;
+                }
+            }
+        }
+        step = this_step;
+    }
+    if (i == 0) {
+        debug_printf(REV, FATAL, "\"%s\" has no checkpoints\n", file);
+        goto out;
+    }
+    if ((n >= 0) && (i <= n)) {
+        debug_printf(REV, WARNING, "\"%s\" only has %ld checkpoints\n",
+                file, i);
+    }
+
+    core_restore(core, core_buf);
+    restore_devs(&m, devs_buf);
+    debug_printf(REV, INFO, "Restored checkpoint %ld (step %llu) from "
+            "\"%s\"\n", i - 1, (unsigned long long)step, file);
+    ret = 0;
+    goto out;
+
+truncated:
+    debug_printf(REV, FATAL, "\"%s\" is truncated\n", file);
+out:
+    free(core_buf);
+    free(devs_buf);
+    free_machine(&m);
+    fclose(f);
+    return ret;
+}
+
+static void find_machine(struct machine *m, mem_t *mem)
+{
+    mem_region_t *rgn;
+    mem_dev_t *dev;
+    struct rev_mem *rm;
+
+    m->mems = NULL;
+    m->nmems = 0;
+    m->devs = NULL;
+    m->ndevs = 0;
+    m->devs_size = 0;
+
+    for (rgn = mem_first_region(mem); rgn; rgn = mem_next_region(rgn)) {
+        dev = mem_region_dev(rgn);
+        if (dev->map) {
+            m->mems = xrealloc(m->mems, (m->nmems + 1) * sizeof(*m->mems));
+            rm = &m->mems[m->nmems++];
+            rm->dev = dev;
+            rm->base = mem_region_base(rgn);
+            rm->data = dev->map(dev, 0, dev->size, 0);
+            rm->size = dev->size;
+            rm->npages = (dev->size + MEM_DEV_PAGE - 1) / MEM_DEV_PAGE;
+            rm->dirty = dev->dirty;
+            rm->latest = xmalloc(rm->npages * sizeof(*rm->latest));
+            memset(rm->latest, 0, rm->npages * sizeof(*rm->latest));
+            rm->need = xmalloc(rm->npages);
+        } else if (dev->save) {
+            m->devs = xrealloc(m->devs, (m->ndevs + 1) * sizeof(*m->devs));
+            m->devs[m->ndevs++] = dev;
+            m->devs_size += dev->state_size;
+        }
+    }
+}
+
+static void free_machine(struct machine *m)
+{
+    unsigned j;
+
+    for (j = 0; j < m->nmems; j++) {
+        free(m->mems[j].latest);
+        free(m->mems[j].need);
+    }
+    free(m->mems);
+    free(m->devs);
+}
+
+static void save_devs(struct machine *m, uint8_t *buf)
+{
+    unsigned j;
+
+    for (j = 0; j < m->ndevs; j++) {
+        m->devs[j]->save(m->devs[j], buf);
+        buf += m->devs[j]->state_size;
+    }
+}
+
+static void restore_devs(struct machine *m, const uint8_t *buf)
+{
+    unsigned j;
+
+    for (j = 0; j < m->ndevs; j++) {
+        m->devs[j]->restore(m->devs[j], buf);
+        buf += m->devs[j]->state_size;
+    }
+}
+
+/*
+ Keeps the pages written since the last checkpoint (or, for memory that
+ doesn't track writes, every page) that actually differ from their copy at
+ the last checkpoint.
+ */
+static void checkpoint(rev_t *r)
+{
+    struct ckpt *ck;
+    struct rev_mem *m;
+    struct rev_delta *d;
+    uint8_t *p, *copy;
+    uint32_t i, len;
+    unsigned j;
+
+    if (r->nckpts == r->cap) {
+        r->cap = r->cap ? 2 * r->cap : 64;
+        r->ckpts = xrealloc(r->ckpts, r->cap * sizeof(*r->ckpts));
+    }
+    ck = &r->ckpts[r->nckpts++];
+    ck->step = r->step;
+    ck->mark = rr_mark();
+    ck->core = xmalloc(core_state_size());
+    core_save(r->core, ck->core);
+    ck->devs = r->m.devs_size ? xmalloc(r->m.devs_size) : NULL;
+    save_devs(&r->m, ck->devs);
+
+    ck->deltas = xmalloc(r->m.nmems * sizeof(*ck->deltas));
+    for (j = 0; j < r->m.nmems; j++) {
+        m = &r->m.mems[j];
+        d = &ck->deltas[j];
+        d->npages = 0;
+        d->pages = NULL;
+        for (i = 0; i < m->npages; i++) {
+            if (m->dirty && m->latest[i]) {
+                if (!m->dirty[i / 32]) {
+                    i |= 31;
+                    continue;
+                }
+                if (!(m->dirty[i / 32] & (1u << (i % 32)))) {
+                    continue;
+                }
+            }
+            p = m->data + i * MEM_DEV_PAGE;
+            len = page_len(m, i);
+            if (m->latest[i] && !memcmp(m->latest[i], p, len)) {
+                continue;
+            }
+            copy = xmalloc(len);
+            memcpy(copy, p, len);
+            m->latest[i] = copy;
+            d->pages = xrealloc(d->pages, (d->npages + 1) * sizeof(*d->pages));
+            d->pages[d->npages].index = i;
+            d->pages[d->npages].data = copy;
+            d->npages++;
+            r->saved_pages++;
+        }
+        if (m->dirty) {
+            memset(m->dirty, 0, ((m->npages + 31) / 32) * sizeof(uint32_t));
+        }
+    }
+
+    if (r->out) {
+        write_ckpt(r, ck);
+    }
+
+    debug_printf(REV, DETAIL,
+            "Checkpoint %u at step %llu (%llu pages saved in all)\n",
+            r->nckpts - 1, (unsigned long long)ck->step,
+            (unsigned long long)r->saved_pages);
+}
+
+static void write_header(rev_t *r)
+{
+    uint32_t hdr[3], region[2];
+    unsigned j;
+
+    hdr[0] = (uint32_t)core_state_size();
+    hdr[1] = (uint32_t)r->m.devs_size;
+    hdr[2] = r->m.nmems;
+    fwrite(CKPT_MAGIC, 8, 1, r->out);
+    fwrite(hdr, sizeof(hdr), 1, r->out);
+    for (j = 0; j < r->m.nmems; j++) {
+        region[0] = r->m.mems[j].base;
+        region[1] = r->m.mems[j].size;
+        fwrite(region, sizeof(region), 1, r->out);
+    }
+}
+
+/* Flushed each time, so that the file is usable after a crash. */
+static void write_ckpt(rev_t *r, struct ckpt *ck)
+{
+    struct rev_delta *d;
+    uint32_t npages;
+    unsigned j, n;
+
+    fwrite(&ck->step, sizeof(ck->step), 1, r->out);
+    fwrite(ck->core, core_state_size(), 1, r->out);
+    if (r->m.devs_size) {
+        fwrite(ck->devs, r->m.devs_size, 1, r->out);
+    }
+    for (j = 0; j < r->m.nmems; j++) {
+        d = &ck->deltas[j];
+        npages = d->npages;
+        fwrite(&npages, sizeof(npages), 1, r->out);
+        for (n = 0; n < d->npages; n++) {
+            fwrite(&d->pages[n].index, sizeof(uint32_t), 1, r->out);
+            fwrite(d->pages[n].data, page_len(&r->m.mems[j],
+                   d->pages[n].index), 1, r->out);
+        }
+    }
+    if (fflush(r->out)) {
+        debug_printf(REV, ERROR, "Couldn't write \"%s\": %s\n",
+                r->out_name, strerror(errno));
+    }
+}
+
+/*
+ Only pages that may differ from checkpoint k are copied back: those saved
+ by a later checkpoint and those written since the last one.  Each comes
+ from the newest checkpoint at or before k that saved it (the first saved
+ them all), and is marked written again, since it may now differ from the
+ last checkpoint.
+ */
+static void restore(rev_t *r, unsigned k)
+{
+    struct ckpt *ck = &r->ckpts[k];
+    struct rev_mem *m;
+    struct rev_delta *d;
+    uint32_t idx, left = 0;
+    unsigned i, j, n;
+
+    core_restore(r->core, ck->core);
+    restore_devs(&r->m, ck->devs);
+
+    for (j = 0; j < r->m.nmems; j++) {
+        m = &r->m.mems[j];
+        if (!m->dirty) {
+            memset(m->need, 1, m->npages);
+            left = m->npages;
+        } else {
+            memset(m->need, 0, m->npages);
+            left = 0;
+            for (idx = 0; idx < m->npages; idx++) {
+                if (m->dirty[idx / 32] & (1u << (idx % 32))) {
+                    m->need[idx] = 1;
+                    left++;
+                }
+            }
+            for (i = k + 1; i < r->nckpts; i++) {
+                d = &r->ckpts[i].deltas[j];
+                for (n = 0; n < d->npages; n++) {
+                    idx = d->pages[n].index;
+                    if (!m->need[idx]) {
+                        m->need[idx] = 1;
+                        left++;
+                    }
+                }
+            }
+        }
+
+        for (i = k + 1; left && i-- > 0; ) {
+            d = &r->ckpts[i].deltas[j];
+            for (n = 0; n < d->npages; n++) {
+                idx = d->pages[n].index;
+                if (m->need[idx]) {
+                    memcpy(m->data + idx * MEM_DEV_PAGE, d->pages[n].data,
+                           page_len(m, idx));
+                    if (m->dirty) {
+                        m->dirty[idx / 32] |= 1u << (idx % 32);
+                    }
+                    m->need[idx] = 0;
+                    left--;
+                }
+            }
+        }
+    }
+
+    rr_rewind(ck->mark);
+    r->step = ck->step;
+
+    debug_printf(REV, DETAIL, "Restored checkpoint %u (step %llu)\n",
+            k, (unsigned long long)ck->step);
+}
+
+/* Returns the last checkpoint at or before step. */
+static unsigned find_ckpt(rev_t *r, uint64_t step)
+{
+    unsigned k = r->nckpts - 1;
+
+    while (k > 0 && r->ckpts[k].step > step) {
+        k--;
+    }
+    return k;
+}
+
+static uint32_t page_len(struct rev_mem *m, uint32_t index)
+{
+    uint32_t left = m->size - index * MEM_DEV_PAGE;
+
+    return (left < MEM_DEV_PAGE) ? left : MEM_DEV_PAGE;
+}
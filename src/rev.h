@@ -0,0 +1,35 @@
+#ifndef REV_H
+#define REV_H
+
+#include <stdint.h>
+
+#include "core.h"
+#include "mem.h"
+
+/*
+ Reverse execution.  While the core runs through rev_step, a checkpoint of
+ the core, the devices and whichever RAM pages changed is taken every
+ interval steps; going back to an earlier step restores the nearest
+ checkpoint before it and re-executes from there, with host input replayed
+ through rr so that the re-execution is exact.
+
+ Checkpoints can also be written to a file as they are taken, and any one of
+ them loaded into a fresh run with rev_load.
+
+ Positions are counted in calls to core_step, which (unlike the retired
+ instruction count) also advance when an instruction takes an exception.
+ */
+typedef struct rev rev_t;
+
+/* Returns nonzero at the step a reverse search should stop at. */
+typedef int (*rev_stop_fn)(core_t *c, void *arg);
+
+rev_t *rev_create(core_t *core, mem_t *mem, uint64_t interval, char *file);
+void rev_destroy(rev_t *r);
+int rev_step(rev_t *r);
+uint64_t rev_get_step(rev_t *r);
+int rev_goto(rev_t *r, uint64_t step);
+int rev_reverse_continue(rev_t *r, rev_stop_fn stop, void *arg);
+int rev_load(core_t *core, mem_t *mem, char *file, long n);
+
+#endif
@@ -0,0 +1,171 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "ring.h"
+#include "util.h"
+
+/* How many slots each side fills or drains before publishing. */
+#define RING_BATCH 64
+/*
+ How many times a side polls before yielding the host CPU, and how many
+ times it yields before going to sleep until the other side publishes.
+ */
+#define RING_SPINS 1024
+#define RING_YIELDS 64
+
+/*
+ head and tail are free-running counts of produced and consumed slots, each
+ written by one side with release stores and read by the other with acquire
+ loads.  Each side also keeps a private copy of its own count and a cached
+ copy of the other's, and keeps them on separate cache lines so the shared
+ counters are only touched once per batch.
+
+ A side that has waited long enough counts itself in sleepers and sleeps
+ on wake; publishing checks sleepers after the store, and the sleeper
+ rechecks the counter after adding itself, so one of them always sees the
+ other.  With nobody asleep, publishing costs one more load.
+ */
+struct ring {
+    unsigned char *buf;
+    size_t elem_size;
+    unsigned mask;
+    char pad0[64];
+
+    unsigned head;              /* Shared. */
+    char pad1[64];
+    unsigned tail;              /* Shared. */
+    char pad2[64];
+
+    unsigned p_head;            /* Producer's. */
+    unsigned p_tail;
+    char pad3[64];
+
+    unsigned c_tail;            /* Consumer's. */
+    unsigned c_head;
+    char pad4[64];
+
+    unsigned sleepers;          /* Shared. */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+};
+
+static void ring_publish(ring_t *r, unsigned *shared, unsigned val);
+static void ring_wait(ring_t *r, const unsigned *shared, unsigned seen,
+                      unsigned *spins);
+
+ring_t *ring_create(size_t elem_size, unsigned nelems)
+{
+    ring_t *r;
+
+    assert(nelems && !(nelems & (nelems - 1)) && (nelems >= 2 * RING_BATCH));
+
+    r = xmalloc(sizeof(*r));
+    r->buf = xmalloc(elem_size * nelems);
+    r->elem_size = elem_size;
+    r->mask = nelems - 1;
+    r->head = r->tail = 0;
+    r->p_head = r->p_tail = 0;
+    r->c_tail = r->c_head = 0;
+    r->sleepers = 0;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->wake, NULL);
+    return r;
+}
+
+void ring_destroy(ring_t *r)
+{
+    pthread_cond_destroy(&r->wake);
+    pthread_mutex_destroy(&r->lock);
+    free(r->buf);
+    free(r);
+}
+
+/* Returns the next free slot, waiting for the consumer if necessary. */
+void *ring_produce(ring_t *r)
+{
+    unsigned spins = 0;
+
+    while (r->p_head - r->p_tail > r->mask) {
+        r->p_tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (r->p_head - r->p_tail > r->mask) {
+            ring_flush(r);
+            ring_wait(r, &r->tail, r->p_tail, &spins);
+        }
+    }
+    return r->buf + (size_t)(r->p_head & r->mask) * r->elem_size;
+}
+
+void ring_produced(ring_t *r)
+{
+    r->p_head++;
+    if (!(r->p_head % RING_BATCH)) {
+        ring_flush(r);
+    }
+}
+
+void ring_flush(ring_t *r)
+{
+    ring_publish(r, &r->head, r->p_head);
+}
+
+/* Returns the oldest unconsumed slot, waiting for the producer if needed. */
+const void *ring_consume(ring_t *r)
+{
+    unsigned spins = 0;
+
+    while (r->c_tail == r->c_head) {
+        r->c_head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (r->c_tail == r->c_head) {
+            ring_publish(r, &r->tail, r->c_tail);
+            ring_wait(r, &r->head, r->c_head, &spins);
+        }
+    }
+    return r->buf + (size_t)(r->c_tail & r->mask) * r->elem_size;
+}
+
+void ring_consumed(ring_t *r)
+{
+    r->c_tail++;
+    if (!(r->c_tail % RING_BATCH)) {
+        ring_publish(r, &r->tail, r->c_tail);
+    }
+}
+
+static void ring_publish(ring_t *r, unsigned *shared, unsigned val)
+{
+    __atomic_store_n(shared, val, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->sleepers, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&r->lock);
+        pthread_cond_broadcast(&r->wake);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+/*
+ Called each time a side finds *shared still at seen: polls for a while,
+ then yields for a while, then sleeps until the other side publishes.
+ */
+static void ring_wait(ring_t *r, const unsigned *shared, unsigned seen,
+                      unsigned *spins)
+{
+    if (++*spins < RING_SPINS) {
+        return;
+    } else if (*spins < RING_SPINS + RING_YIELDS) {
+        sched_yield();
+        return;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    __atomic_add_fetch(&r->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(shared, __ATOMIC_SEQ_CST) == seen) {
+        pthread_cond_wait(&r->wake, &r->lock);
+    }
+    __atomic_sub_fetch(&r->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&r->lock);
+    *spins = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+
+typedef struct ring ring_t;
+
+/*
+ A single-producer, single-consumer queue of fixed-size elements, for
+ handing data between exactly two threads without locks on the fast path.
+ Each side fills or drains slots in place and publishes its progress in
+ batches; a side that has to wait publishes first, so the other can always
+ make progress, and one that waits for long sleeps until the other
+ publishes, so an idle side doesn't burn a host CPU.
+ */
+ring_t *ring_create(size_t elem_size, unsigned nelems);
+void ring_destroy(ring_t *r);
+
+/* Producer side. */
+void *ring_produce(ring_t *r);
+void ring_produced(ring_t *r);
+void ring_flush(ring_t *r);
+
+/* Consumer side. */
+const void *ring_consume(ring_t *r);
+void ring_consumed(ring_t *r);
+
+#endif
@@ -0,0 +1,407 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "rr.h"
+#include "util.h"
+
+/*
+ The log is text, one event per line:
+
+   <icount> <source> <result>[ <data>][ e<errno>]
+
+ where <data> is the bytes read, in hex, present only for reads that
+ returned something, and <errno> is the host's errno, present only for
+ calls that failed, so that callers checking for EINTR see it again.  The
+ first line is a header so that a log can't be confused with some other
+ file.
+ */
+#define RR_MAGIC "tmips-rr 1"
+
+enum {
+    RR_OFF,
+    RR_RECORDING,
+    RR_REPLAYING
+};
+
+static const char *source_name[NUM_RR_SOURCES] = {
+    [RR_SERIAL] = "serial",
+    [RR_STDIN] = "stdin",
+    [RR_READ] = "read",
+    [RR_WRITE] = "write",
+    [RR_OPEN] = "open"
+};
+
+static int mode = RR_OFF;
+static FILE *log_file;
+static char *log_name;
+static sched_t *now_clock;
+static unsigned long nevents;
+
+/* The next logged event, read ahead while replaying, and where it starts. */
+static int have_next;
+static long next_pos;
+static unsigned long long next_when;
+static int next_src;
+static long next_ret;
+static int next_errno;
+static int replay_errno;         /* The errno of the event just replayed. */
+static unsigned char *next_data;
+static size_t next_cap;
+
+/* Set while replaying our own recording after a rewind: where it ends. */
+static int resume_recording;
+static long record_end;
+
+/* Only warn once per run. */
+static int warned_skew;
+static int diverged;
+
+static int silent;
+
+static void put_event(rr_source_t src, long ret, const void *data);
+static int get_event(void);
+static int replay_event(rr_source_t src);
+static long replayed(long ret);
+
+/* With no file, records to an anonymous temporary one, for rr_rewind. */
+int rr_record(char *file, sched_t *s)
+{
+    assert(mode == RR_OFF);
+
+    log_file = file ? fopen(file, "w+") : tmpfile();
+    if (!log_file) {
+        debug_printf(RR, FATAL, "Couldn't create \"%s\": %s\n",
+                file ? file : "temporary file", strerror(errno));
+        return 1;
+    }
+    fprintf(log_file, "%s\n", RR_MAGIC);
+
+    mode = RR_RECORDING;
+    log_name = file;
+    now_clock = s;
+    return 0;
+}
+
+int rr_replay(char *file, sched_t *s)
+{
+    char line[32];
+
+    assert(mode == RR_OFF);
+
+    log_file = fopen(file, "r");
+    if (!log_file) {
+        debug_printf(RR, FATAL, "Couldn't open \"%s\": %s\n",
+                file, strerror(errno));
+        return 1;
+    }
+    if (!fgets(line, sizeof(line), log_file) ||
+        strncmp(line, RR_MAGIC "\n", sizeof(line))) {
+        debug_printf(RR, FATAL, "\"%s\" is not a tmips record log\n", file);
+        fclose(log_file);
+        return 1;
+    }
+
+    mode = RR_REPLAYING;
+    log_name = file;
+    now_clock = s;
+    have_next = get_event();
+    return 0;
+}
+
+int rr_active(void)
+{
+    return mode != RR_OFF;
+}
+
+int rr_replaying(void)
+{
+    return mode == RR_REPLAYING;
+}
+
+/* Returns the log position of the next event the guest will see. */
+long rr_mark(void)
+{
+    switch (mode) {
+    case RR_RECORDING:
+        return ftell(log_file);
+    case RR_REPLAYING:
+        return have_next ? next_pos : ftell(log_file);
+    default:
+        return 0;
+    }
+}
+
+void rr_rewind(long mark)
+{
+    if (mode == RR_OFF) {
+        return;
+    }
+    if (mode == RR_RECORDING) {
+        record_end = ftell(log_file);
+        resume_recording = 1;
+        mode = RR_REPLAYING;
+    }
+    fseek(log_file, mark, SEEK_SET);
+    diverged = 0;
+    have_next = get_event();
+}
+
+void rr_set_silent(int s)
+{
+    silent = s;
+}
+
+int rr_silent(void)
+{
+    return silent;
+}
+
+long rr_read(rr_source_t src, int fd, void *buf, size_t len)
+{
+    long ret;
+
+    switch (mode) {
+    case RR_RECORDING:
+        ret = read(fd, buf, len);
+        put_event(src, ret, buf);
+        return ret;
+    case RR_REPLAYING:
+        if (!replay_event(src)) {
+            return 0;
+        }
+        ret = next_ret;
+        if (ret > (long)len) {
+            /* Can only happen with a hand-edited or mismatched log. */
+            debug_printf(RR, WARNING,
+                    "Replayed %s of %ld bytes truncated to %lu\n",
+                    source_name[src], ret, (unsigned long)len);
+            ret = (long)len;
+        }
+        if (ret > 0) {
+            memcpy(buf, next_data, ret);
+        }
+        have_next = get_event();
+        return replayed(ret);
+    default:
+        return read(fd, buf, len);
+    }
+}
+
+/*
+ Writes to stdout and stderr are repeated during replay; writes to host files
+ are not.  Either way the guest sees the recorded result.
+ */
+long rr_write(int fd, const void *buf, size_t len)
+{
+    long ret;
+
+    switch (mode) {
+    case RR_RECORDING:
+        ret = write(fd, buf, len);
+        put_event(RR_WRITE, ret, NULL);
+        return ret;
+    case RR_REPLAYING:
+        if (fd <= 2 && !silent) {
+            ret = write(fd, buf, len);
+        }
+        if (!replay_event(RR_WRITE)) {
+            return -1;
+        }
+        ret = next_ret;
+        have_next = get_event();
+        return replayed(ret);
+    default:
+        return write(fd, buf, len);
+    }
+}
+
+/*
+ Logs, or while replaying substitutes, the result of a host call that the
+ caller has made (or, when replaying, skipped).
+ */
+int32_t rr_value(rr_source_t src, int32_t live)
+{
+    int32_t ret;
+
+    switch (mode) {
+    case RR_RECORDING:
+        put_event(src, live, NULL);
+        return live;
+    case RR_REPLAYING:
+        if (!replay_event(src)) {
+            return -1;
+        }
+        ret = (int32_t)next_ret;
+        have_next = get_event();
+        return (int32_t)replayed(ret);
+    default:
+        return live;
+    }
+}
+
+void rr_finish(void)
+{
+    switch (mode) {
+    case RR_REPLAYING:
+        if (!resume_recording) {
+            debug_printf(RR, INFO, "Replayed %lu events from \"%s\".\n",
+                    nevents, log_name);
+            if (have_next && !diverged) {
+                debug_printf(RR, WARNING, "Halted before the end of the log "
+                        "(next event at %llu)\n", next_when);
+            }
+            break;
+        }
+        /* Fall through. */
+    case RR_RECORDING:
+        if (log_name) {
+            debug_printf(RR, INFO, "Recorded %lu events to \"%s\".\n",
+                    nevents, log_name);
+        }
+        break;
+    default:
+        return;
+    }
+
+    fclose(log_file);
+    free(next_data);
+    mode = RR_OFF;
+}
+
+static void put_event(rr_source_t src, long ret, const void *data)
+{
+    const unsigned char *p = data;
+    int err = errno;
+    long i;
+
+    fprintf(log_file, "%llu %s %ld", (unsigned long long)now_clock->now,
+            source_name[src], ret);
+    if (ret < 0) {
+        fprintf(log_file, " e%d", err);
+    }
+    if (p) {
+        if (ret > 0) {
+            fputc(' ', log_file);
+        }
+        for (i = 0; i < ret; i++) {
+            fprintf(log_file, "%02x", p[i]);
+        }
+    }
+    fputc('\n', log_file);
+    nevents++;
+    errno = err;
+}
+
+/*
+ Reads the next event into next_*.  Returns 0 at the end of the log, or on
+ reaching the end of our own recording, in which case we go back to
+ recording.
+ */
+static int get_event(void)
+{
+    char name[16];
+    unsigned x;
+    long i;
+    int src;
+
+    next_pos = ftell(log_file);
+    if (resume_recording && next_pos >= record_end) {
+        fseek(log_file, 0, SEEK_END);
+        resume_recording = 0;
+        mode = RR_RECORDING;
+        return 0;
+    }
+    if (fscanf(log_file, "%llu %15s %ld", &next_when, name, &next_ret) != 3) {
+        return 0;
+    }
+    /* Logs written before errno was recorded don't have it. */
+    if ((next_ret < 0) && (fscanf(log_file, " e%d", &next_errno) != 1)) {
+        next_errno = 0;
+    }
+    for (src = 0; src < NUM_RR_SOURCES; src++) {
+        if (!strcmp(name, source_name[src])) {
+            break;
+        }
+    }
+    if (src == NUM_RR_SOURCES) {
+        debug_printf(RR, ERROR, "Unknown event \"%s\" in \"%s\"\n",
+                name, log_name);
+        return 0;
+    }
+    next_src = src;
+
+    if ((src == RR_SERIAL || src == RR_STDIN || src == RR_READ) &&
+        next_ret > 0) {
+        if ((size_t)next_ret > next_cap) {
+            next_cap = next_ret;
+            next_data = xrealloc(next_data, next_cap);
+        }
+        for (i = 0; i < next_ret; i++) {
+            if (fscanf(log_file, "%2x", &x) != 1) {
+                debug_printf(RR, ERROR, "Truncated event at %llu in \"%s\"\n",
+                        next_when, log_name);
+                return 0;
+            }
+            next_data[i] = (unsigned char)x;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ Checks that the guest is asking for the event the log has next.  If it
+ isn't, replay has diverged from the recording and everything after this
+ point is meaningless, so we stop handing out events and the guest sees end
+ of file.
+ */
+static int replay_event(rr_source_t src)
+{
+    if (diverged) {
+        return 0;
+    }
+    if (!have_next) {
+        debug_printf(RR, WARNING,
+                "Log exhausted at instruction %llu; guest sees end of file\n",
+                (unsigned long long)now_clock->now);
+        diverged = 1;
+        return 0;
+    }
+    if (next_src != (int)src) {
+        debug_printf(RR, ERROR,
+                "Replay diverged at instruction %llu: guest did a %s, "
+                "log has a %s at %llu\n", (unsigned long long)now_clock->now,
+                source_name[src], source_name[next_src], next_when);
+        diverged = 1;
+        return 0;
+    }
+    if (next_when != now_clock->now && !warned_skew) {
+        debug_printf(RR, WARNING,
+                "Replayed %s at instruction %llu was recorded at %llu\n",
+                source_name[src], (unsigned long long)now_clock->now,
+                next_when);
+        warned_skew = 1;
+    }
+    if (!resume_recording) {
+        nevents++;
+    }
+    replay_errno = next_errno;
+    return 1;
+}
+
+/* Sets errno as it was recorded for a failed call, after reading ahead. */
+static long replayed(long ret)
+{
+    if (ret < 0) {
+        errno = replay_errno;
+    }
+    return ret;
+}
@@ -0,0 +1,46 @@
+#ifndef RR_H
+#define RR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sched.h"
+
+/*
+ Record and replay of everything the guest learns from the host.  While
+ recording, each input (and the result of each host call whose outcome
+ depends on the host) is logged along with the retired instruction count at
+ which it happened; while replaying, the same values are handed back from the
+ log and host files and stdin are never touched.  Console and stdout output
+ still happen during replay so that the session can be watched.
+
+ There is only ever one log, so this is global state like the debug levels.
+
+ Checkpointing (see rev.h) rewinds the log along with the machine: after
+ rr_rewind, events already in the log are replayed again, and recording
+ picks up where it left off once they run out.  Output is suppressed while
+ rr_set_silent is in effect so that re-executed code doesn't repeat itself.
+ */
+typedef enum {
+    RR_SERIAL,              /* Serial console byte. */
+    RR_STDIN,               /* Host syscall read from stdin. */
+    RR_READ,                /* Host syscall read from a host file. */
+    RR_WRITE,               /* Result of a host syscall write. */
+    RR_OPEN,                /* Result of a host syscall open. */
+    NUM_RR_SOURCES
+} rr_source_t;
+
+int rr_record(char *file, sched_t *clock);
+int rr_replay(char *file, sched_t *clock);
+int rr_active(void);
+int rr_replaying(void);
+long rr_mark(void);
+void rr_rewind(long mark);
+void rr_set_silent(int silent);
+int rr_silent(void);
+long rr_read(rr_source_t src, int fd, void *buf, size_t len);
+long rr_write(int fd, const void *buf, size_t len);
+int32_t rr_value(rr_source_t src, int32_t live);
+void rr_finish(void);
+
+#endif
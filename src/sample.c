@@ -0,0 +1,249 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "debug.h"
+#include "sample.h"
+#include "sched.h"
+#include "uarch.h"
+#include "util.h"
+
+/*
+ Sampled simulation: every period instructions, the core runs without the
+ timing models except for the last warmup + window instructions.  The
+ warmup refills caches, predictors and pipeline state, and the window is
+ measured.  Phase changes are scheduler events, and the window boundaries
+ travel to the model thread as marks in the record stream, so each window
+ is measured exactly.  Results are the mean over windows, with a 95%
+ confidence interval from the spread between them.
+ */
+enum {
+    PHASE_FAST,
+    PHASE_WARM,
+    PHASE_WINDOW
+};
+
+struct sample {
+    uint64_t period;
+    uint64_t warmup;
+    uint64_t window;
+
+    core_t *core;
+    uarch_t *uarch;
+    sched_t *sched;
+    sched_event_t ev;
+    int phase;
+    uint64_t period_start;
+};
+
+static void sample_fire(sched_t *sched, sched_event_t *ev);
+static int parse_count(char *s, uint64_t *out);
+static void report_stat(FILE *out, const char *name, const double *v,
+                        unsigned n, const char *unit);
+
+/* spec is <period>:<warmup>:<window>, in instructions, k and M allowed. */
+sample_t *sample_create_spec(char *spec)
+{
+    char buf[64], *field[3], *p;
+    uint64_t v[3];
+    sample_t *s;
+    int n = 0, i;
+
+    if (strlen(spec) >= sizeof(buf)) {
+        goto bad;
+    }
+    strcpy(buf, spec);
+    for (p = strtok(buf, ":"); p; p = strtok(NULL, ":")) {
+        if (n == 3) {
+            goto bad;
+        }
+        field[n++] = p;
+    }
+    if (n != 3) {
+        goto bad;
+    }
+    for (i = 0; i < 3; i++) {
+        if (parse_count(field[i], &v[i])) {
+            goto bad;
+        }
+    }
+    if (!v[2] || (v[1] + v[2] > v[0])) {
+        goto bad;
+    }
+
+    s = xmalloc(sizeof(*s));
+    s->period = v[0];
+    s->warmup = v[1];
+    s->window = v[2];
+    s->core = NULL;
+    s->uarch = NULL;
+    s->sched = NULL;
+    sched_event_init(&s->ev, &sample_fire, s);
+    s->ev.observer = 1;
+    return s;
+
+bad:
+    debug_printf(CONFIG, FATAL,
+            "--sample: invalid spec \"%s\" (expected <period>:<warmup>:"
+            "<window> with warmup + window <= period)\n", spec);
+    return NULL;
+}
+
+void sample_destroy(sample_t *s)
+{
+    if (s->sched) {
+        sched_cancel(s->sched, &s->ev);
+    }
+    free(s);
+}
+
+/* Takes over attaching u to core; call after everything else is set up. */
+void sample_start(sample_t *s, core_t *core, uarch_t *u)
+{
+    s->core = core;
+    s->uarch = u;
+    s->sched = core_get_sched(core);
+    s->phase = PHASE_FAST;
+    s->period_start = s->sched->now;
+
+    core_set_uarch(core, NULL);
+    sched_add(s->sched, &s->ev,
+              s->period_start + s->period - s->warmup - s->window);
+}
+
+void sample_report(sample_t *s, FILE *out)
+{
+    const uarch_window_t *w;
+    double *cpi, *imiss, *dmiss;
+    unsigned nw, n = 0, ni = 0, nd = 0, i;
+    uint64_t insts = s->sched->now;
+
+    uarch_flush(s->uarch);
+    w = uarch_windows(s->uarch, &nw);
+
+    cpi = xmalloc((nw + 1) * sizeof(*cpi));
+    imiss = xmalloc((nw + 1) * sizeof(*imiss));
+    dmiss = xmalloc((nw + 1) * sizeof(*dmiss));
+    for (i = 0; i < nw; i++) {
+        /* A window an idle skip jumped over saw nothing. */
+        if (!w[i].insts) {
+            continue;
+        }
+        if (w[i].cycles) {
+            cpi[n++] = (double)w[i].cycles / w[i].insts;
+        }
+        if (w[i].iaccesses) {
+            imiss[ni++] = 100.0 * w[i].imisses / w[i].iaccesses;
+        }
+        if (w[i].daccesses) {
+            dmiss[nd++] = 100.0 * w[i].dmisses / w[i].daccesses;
+        }
+    }
+
+    fprintf(out, "sample: period %llu, warmup %llu, window %llu; "
+            "%u windows over %llu instructions\n",
+            (unsigned long long)s->period, (unsigned long long)s->warmup,
+            (unsigned long long)s->window, nw, (unsigned long long)insts);
+    report_stat(out, "CPI", cpi, n, "");
+    report_stat(out, "icache miss rate", imiss, ni, "%");
+    report_stat(out, "dcache miss rate", dmiss, nd, "%");
+    if (n) {
+        double mean = 0;
+        for (i = 0; i < n; i++) {
+            mean += cpi[i];
+        }
+        mean /= n;
+        fprintf(out, "sample: projected %.0f cycles for %llu instructions\n",
+                mean * insts, (unsigned long long)insts);
+    }
+
+    free(cpi);
+    free(imiss);
+    free(dmiss);
+}
+
+static void sample_fire(sched_t *sched, sched_event_t *ev)
+{
+    sample_t *s = ev->arg;
+    uint64_t when;
+
+    switch (s->phase) {
+    case PHASE_FAST:
+        core_set_uarch(s->core, s->uarch);
+        s->phase = PHASE_WARM;
+        when = s->period_start + s->period - s->window;
+        break;
+    case PHASE_WARM:
+        uarch_mark(s->uarch, UARCH_MARK_BEGIN);
+        s->phase = PHASE_WINDOW;
+        when = s->period_start + s->period;
+        break;
+    default:
+        uarch_mark(s->uarch, UARCH_MARK_END);
+        s->period_start += s->period;
+        if (s->warmup + s->window < s->period) {
+            core_set_uarch(s->core, NULL);
+            s->phase = PHASE_FAST;
+            when = s->period_start + s->period - s->warmup - s->window;
+        } else {
+            s->phase = PHASE_WARM;
+            when = s->period_start + s->period - s->window;
+        }
+        break;
+    }
+
+    sched_add(sched, ev, when);
+}
+
+static int parse_count(char *s, uint64_t *out)
+{
+    char *end;
+    unsigned long v;
+
+    v = strtoul(s, &end, 0);
+    if (end == s) {
+        return 1;
+    }
+    if (*end == 'k') {
+        v *= 1000;
+        end++;
+    } else if (*end == 'M') {
+        v *= 1000000;
+        end++;
+    }
+    if (*end) {
+        return 1;
+    }
+    *out = v;
+    return 0;
+}
+
+/* Prints the mean of v with a 95% confidence interval (normal approx.). */
+static void report_stat(FILE *out, const char *name, const double *v,
+                        unsigned n, const char *unit)
+{
+    double mean = 0, var = 0;
+    unsigned i;
+
+    if (!n) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        mean += v[i];
+    }
+    mean /= n;
+    for (i = 0; i < n; i++) {
+        var += (v[i] - mean) * (v[i] - mean);
+    }
+    if (n > 1) {
+        var /= n - 1;
+        fprintf(out, "sample: %s %.3f%s +/- %.3f%s (95%%, %u windows)\n",
+                name, mean, unit, 1.96 * sqrt(var / n), unit, n);
+    } else {
+        fprintf(out, "sample: %s %.3f%s (1 window, no interval)\n",
+                name, mean, unit);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdio.h>
+
+#include "core.h"
+#include "uarch.h"
+
+typedef struct sample sample_t;
+
+sample_t *sample_create_spec(char *spec);
+void sample_destroy(sample_t *s);
+void sample_start(sample_t *s, core_t *core, uarch_t *u);
+void sample_report(sample_t *s, FILE *out);
+
+#endif
@@ -0,0 +1,84 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sched.h"
+
+static void update_next(sched_t *s);
+
+void sched_init(sched_t *s)
+{
+    s->now = 0;
+    s->next = SCHED_NEVER;
+    s->events = NULL;
+}
+
+void sched_event_init(sched_event_t *ev, sched_fn_t fn, void *arg)
+{
+    ev->when = SCHED_NEVER;
+    ev->fn = fn;
+    ev->arg = arg;
+    ev->observer = 0;
+    ev->queued = 0;
+    ev->next = NULL;
+}
+
+void sched_add(sched_t *s, sched_event_t *ev, uint64_t when)
+{
+    sched_event_t **p;
+
+    assert(!ev->queued);
+
+    ev->when = when;
+    for (p = &s->events; *p && (*p)->when <= when; p = &(*p)->next)
+        ;
+    ev->next = *p;
+    *p = ev;
+    ev->queued = 1;
+
+    if (when < s->next) {
+        s->next = when;
+    }
+}
+
+void sched_cancel(sched_t *s, sched_event_t *ev)
+{
+    sched_event_t **p;
+
+    if (!ev->queued) {
+        return;
+    }
+
+    for (p = &s->events; *p != ev; p = &(*p)->next) {
+        assert(*p);
+    }
+    *p = ev->next;
+    ev->next = NULL;
+    ev->queued = 0;
+
+    /* Leaving next early is harmless; sched_run will recompute it. */
+}
+
+void sched_kick(sched_t *s)
+{
+    s->next = s->now;
+}
+
+void sched_run(sched_t *s)
+{
+    sched_event_t *ev;
+
+    while ((ev = s->events) && ev->when <= s->now) {
+        s->events = ev->next;
+        ev->next = NULL;
+        ev->queued = 0;
+        (ev->fn)(s, ev);
+    }
+
+    update_next(s);
+}
+
+static void update_next(sched_t *s)
+{
+    s->next = s->events ? s->events->when : SCHED_NEVER;
+}
@@ -0,0 +1,42 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+/* Time is measured in retired instructions. */
+#define SCHED_NEVER UINT64_MAX
+
+typedef struct sched sched_t;
+typedef struct sched_event sched_event_t;
+typedef void (*sched_fn_t)(sched_t *s, sched_event_t *ev);
+
+struct sched_event {
+    uint64_t when;
+    sched_fn_t fn;
+    void *arg;
+    int observer;           /* Never changes guest state; set after init. */
+    int queued;
+    sched_event_t *next;
+};
+
+/*
+ The core increments now as instructions retire and only calls sched_run once
+ now reaches next, so next must always be a lower bound on the time of the
+ earliest queued event.  sched_kick forces a check on the next step; the core
+ uses it when something other than an event (e.g. an MTC0) might have made an
+ interrupt deliverable.
+ */
+struct sched {
+    uint64_t now;
+    uint64_t next;
+    sched_event_t *events;
+};
+
+void sched_init(sched_t *s);
+void sched_event_init(sched_event_t *ev, sched_fn_t fn, void *arg);
+void sched_add(sched_t *s, sched_event_t *ev, uint64_t when);
+void sched_cancel(sched_t *s, sched_event_t *ev);
+void sched_kick(sched_t *s);
+void sched_run(sched_t *s);
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "debug.h"
 #include "mem_dev.h"
+#include "rr.h"
 #include "util.h"
 
 typedef struct serial_dev serial_dev_t;
@@ -28,6 +29,11 @@ mem_dev_t *serial_create(int infd, int outfd)
     ser->dev.size = 0x4;
     ser->dev.read = &serial_read;
     ser->dev.write = &serial_write;
+    ser->dev.map = NULL;
+    ser->dev.state_size = 0;
+    ser->dev.save = NULL;
+    ser->dev.restore = NULL;
+    ser->dev.dirty = NULL;
     ser->infd = infd;
     ser->outfd = outfd;
 
@@ -53,7 +59,7 @@ static int serial_read(mem_dev_t *dev, uint32_t offset, uint32_t *val_out)
 
     assert(offset == 0);
 
-    ret = read(ser->infd, &c, 1);
+    ret = rr_read(RR_SERIAL, ser->infd, &c, 1);
     if (ret > 0) {
         *val_out = 0x100 | c;
     } else {
@@ -72,7 +78,7 @@ static int serial_write(mem_dev_t *dev, uint32_t offset,
 
     assert(offset == 0);
 
-    if (!(we & 1)) {
+    if (!(we & 1) || rr_silent()) {
         return 0;
     }
 
@@ -0,0 +1,161 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "exc.h"
+#include "mem.h"
+#include "opcode.h"
+#include "stats.h"
+#include "uarch.h"
+
+static const char *op_names[NUM_OPS] = {
+    [OP_REGIMM] = "regimm", [OP_J] = "j", [OP_JAL] = "jal",
+    [OP_BEQ] = "beq", [OP_BNE] = "bne", [OP_BLEZ] = "blez",
+    [OP_BGTZ] = "bgtz", [OP_ADDI] = "addi", [OP_ADDIU] = "addiu",
+    [OP_SLTI] = "slti", [OP_SLTIU] = "sltiu", [OP_ANDI] = "andi",
+    [OP_ORI] = "ori", [OP_XORI] = "xori", [OP_LUI] = "lui",
+    [OP_COP0] = "cop0", [OP_LB] = "lb", [OP_LH] = "lh", [OP_LW] = "lw",
+    [OP_LBU] = "lbu", [OP_LHU] = "lhu", [OP_SB] = "sb", [OP_SH] = "sh",
+    [OP_SW] = "sw"
+};
+
+static const char *funct_names[NUM_FUNCTS] = {
+    [FUNCT_SLL] = "sll", [FUNCT_SRL] = "srl", [FUNCT_SRA] = "sra",
+    [FUNCT_SLLV] = "sllv", [FUNCT_SRLV] = "srlv", [FUNCT_SRAV] = "srav",
+    [FUNCT_JR] = "jr", [FUNCT_JALR] = "jalr", [FUNCT_SYSCALL] = "syscall",
+    [FUNCT_TESTDONE] = "testdone", [FUNCT_MFHI] = "mfhi",
+    [FUNCT_MTHI] = "mthi", [FUNCT_MFLO] = "mflo", [FUNCT_MTLO] = "mtlo",
+    [FUNCT_MULT] = "mult", [FUNCT_MULTU] = "multu", [FUNCT_DIV] = "div",
+    [FUNCT_DIVU] = "divu", [FUNCT_ADD] = "add", [FUNCT_ADDU] = "addu",
+    [FUNCT_SUB] = "sub", [FUNCT_SUBU] = "subu", [FUNCT_AND] = "and",
+    [FUNCT_OR] = "or", [FUNCT_XOR] = "xor", [FUNCT_NOR] = "nor",
+    [FUNCT_SLT] = "slt", [FUNCT_SLTU] = "sltu"
+};
+
+static const char *class_names[NUM_UARCH_CLASSES] = {
+    [UARCH_CLASS_ALU] = "alu",
+    [UARCH_CLASS_LOAD] = "load",
+    [UARCH_CLASS_STORE] = "store",
+    [UARCH_CLASS_BRANCH] = "branch",
+    [UARCH_CLASS_JUMP] = "jump",
+    [UARCH_CLASS_JUMP_REG] = "jump-reg",
+    [UARCH_CLASS_MULT] = "mult",
+    [UARCH_CLASS_DIV] = "div",
+    [UARCH_CLASS_HILO] = "hilo",
+    [UARCH_CLASS_SYSTEM] = "system"
+};
+
+static const char *ins_name(unsigned i, char *buf);
+
+/*
+ Prints the counters in s, memory traffic per region of mem, and wall (the
+ host time the run took, in seconds), as text or as one JSON object.
+ */
+void stats_report(FILE *out, int json, const core_stats_t *s, mem_t *mem,
+                  double wall)
+{
+    uint64_t classes[NUM_UARCH_CLASSES], total = 0, reads, writes;
+    mem_region_t *r;
+    uarch_dec_t d;
+    unsigned i;
+    char buf[16];
+    const char *sep;
+
+    memset(classes, 0, sizeof(classes));
+    for (i = 0; i < NUM_OPS + NUM_FUNCTS; i++) {
+        /* The class only depends on the fields the index covers. */
+        uarch_decode((i < NUM_OPS) ? (i << 26) : (i - NUM_OPS), &d);
+        classes[d.cls] += s->ins[i];
+        total += s->ins[i];
+    }
+
+    if (!json) {
+        fprintf(out, "stats: %llu instructions retired in %.3f s, "
+                "%.2f MIPS\n", (unsigned long long)total, wall,
+                wall > 0 ? total / wall / 1e6 : 0.0);
+        fprintf(out, "stats: by class:");
+        for (i = 0; i < NUM_UARCH_CLASSES; i++) {
+            fprintf(out, " %s %llu", class_names[i],
+                    (unsigned long long)classes[i]);
+        }
+        fprintf(out, "\nstats: by opcode:");
+        for (i = 0; i < NUM_OPS + NUM_FUNCTS; i++) {
+            if (s->ins[i]) {
+                fprintf(out, " %s %llu", ins_name(i, buf),
+                        (unsigned long long)s->ins[i]);
+            }
+        }
+        fprintf(out, "\n");
+        for (i = 0; i < NUM_EXCS; i++) {
+            if (s->excs[i]) {
+                fprintf(out, "stats: %s: %llu\n", exc_text[i],
+                        (unsigned long long)s->excs[i]);
+            }
+        }
+        fprintf(out, "stats: TLB refills: %llu\n",
+                (unsigned long long)s->tlb_refills);
+        for (r = mem_first_region(mem); r; r = mem_next_region(r)) {
+            mem_region_counts(r, &reads, &writes);
+            fprintf(out, "stats: memory %08x-%08x: %llu reads "
+                    "(including fetches), %llu writes\n",
+                    mem_region_base(r),
+                    mem_region_base(r) + mem_region_dev(r)->size,
+                    (unsigned long long)reads, (unsigned long long)writes);
+        }
+        return;
+    }
+
+    fprintf(out, "{\"instructions\": %llu, \"wall_seconds\": %.6f, "
+            "\"mips\": %.3f,\n", (unsigned long long)total, wall,
+            wall > 0 ? total / wall / 1e6 : 0.0);
+    fprintf(out, " \"classes\": {");
+    for (i = 0, sep = ""; i < NUM_UARCH_CLASSES; i++, sep = ", ") {
+        fprintf(out, "%s\"%s\": %llu", sep, class_names[i],
+                (unsigned long long)classes[i]);
+    }
+    fprintf(out, "},\n \"opcodes\": {");
+    for (i = 0, sep = ""; i < NUM_OPS + NUM_FUNCTS; i++) {
+        if (s->ins[i]) {
+            fprintf(out, "%s\"%s\": %llu", sep, ins_name(i, buf),
+                    (unsigned long long)s->ins[i]);
+            sep = ", ";
+        }
+    }
+    fprintf(out, "},\n \"exceptions\": {");
+    for (i = 0, sep = ""; i < NUM_EXCS; i++) {
+        if (s->excs[i]) {
+            fprintf(out, "%s\"%s\": %llu", sep, exc_text[i],
+                    (unsigned long long)s->excs[i]);
+            sep = ", ";
+        }
+    }
+    fprintf(out, "},\n \"tlb_refills\": %llu,\n \"regions\": [",
+            (unsigned long long)s->tlb_refills);
+    for (r = mem_first_region(mem), sep = ""; r;
+         r = mem_next_region(r), sep = ", ") {
+        mem_region_counts(r, &reads, &writes);
+        fprintf(out, "%s{\"base\": %u, \"size\": %u, \"reads\": %llu, "
+                "\"writes\": %llu}", sep, mem_region_base(r),
+                mem_region_dev(r)->size, (unsigned long long)reads,
+                (unsigned long long)writes);
+    }
+    fprintf(out, "]}\n");
+}
+
+static const char *ins_name(unsigned i, char *buf)
+{
+    const char *name;
+
+    if (i < NUM_OPS) {
+        name = op_names[i];
+        if (!name) {
+            sprintf(buf, "op%02o", i);
+        }
+    } else {
+        name = funct_names[i - NUM_OPS];
+        if (!name) {
+            sprintf(buf, "funct%02o", i - NUM_OPS);
+        }
+    }
+    return name ? name : buf;
+}
@@ -0,0 +1,30 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "exc.h"
+#include "mem.h"
+#include "opcode.h"
+
+/*
+ Per-core counters, always kept.  Retired instructions are counted by
+ primary opcode, except SPECIAL, which is counted by funct instead, so that
+ each retirement is a single increment of ins[STATS_INDEX(ins)].
+ */
+#define STATS_INDEX(ins) \
+    ((OP(ins) == OP_SPECIAL) ? NUM_OPS + FUNCT(ins) : OP(ins))
+
+typedef struct core_stats core_stats_t;
+
+struct core_stats {
+    uint64_t ins[NUM_OPS + NUM_FUNCTS];
+    uint64_t excs[NUM_EXCS];
+    uint64_t tlb_refills;
+};
+
+void stats_report(FILE *out, int json, const core_stats_t *s, mem_t *mem,
+                  double wall);
+
+#endif
@@ -0,0 +1,244 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "sym.h"
+#include "util.h"
+
+/*
+ Function symbols, from either an ELF32 file's symbol table or a text map
+ with one symbol per line: an address in hex, then the name as the last
+ word (so "nm" output works as is).  Lookups find the closest symbol at or
+ below an address, bounded by its size when the ELF file gives one.
+ */
+
+struct sym {
+    uint32_t addr;
+    uint32_t size;              /* 0 if unknown. */
+    char *name;
+};
+
+struct symtab {
+    struct sym *syms;
+    unsigned nsyms;
+    unsigned cap;
+};
+
+/* ELF32 layout, just what we need. */
+#define EI_DATA 5
+#define ELFDATA2MSB 2
+#define SHT_SYMTAB 2
+#define STT_FUNC 2
+#define SHDR_SIZE 40
+#define SYM_SIZE 16
+
+static int load_elf(symtab_t *st, FILE *f, char *file);
+static int load_map(symtab_t *st, FILE *f, char *file);
+static void add(symtab_t *st, uint32_t addr, uint32_t size, const char *name);
+static int cmp_sym(const void *a, const void *b);
+static uint32_t get32(const unsigned char *p, int msb);
+static uint32_t get16(const unsigned char *p, int msb);
+
+symtab_t *sym_load(char *file)
+{
+    unsigned char magic[4];
+    symtab_t *st;
+    FILE *f;
+    int ret;
+
+    f = fopen(file, "rb");
+    if (!f) {
+        debug_printf(CONFIG, FATAL, "%s: %s\n", file, strerror(errno));
+        return NULL;
+    }
+
+    st = xmalloc(sizeof(*st));
+    st->syms = NULL;
+    st->nsyms = st->cap = 0;
+
+    if ((fread(magic, 1, 4, f) == 4) && !memcmp(magic, "\177ELF", 4)) {
+        ret = load_elf(st, f, file);
+    } else {
+        rewind(f);
+        ret = load_map(st, f, file);
+    }
+    fclose(f);
+    if (ret) {
+        sym_destroy(st);
+        return NULL;
+    }
+
+    qsort(st->syms, st->nsyms, sizeof(*st->syms), cmp_sym);
+    debug_printf(CONFIG, INFO, "Loaded %u symbols from \"%s\"\n",
+            st->nsyms, file);
+    return st;
+}
+
+void sym_destroy(symtab_t *st)
+{
+    unsigned i;
+
+    for (i = 0; i < st->nsyms; i++) {
+        free(st->syms[i].name);
+    }
+    free(st->syms);
+    free(st);
+}
+
+/* Returns the name of the symbol containing addr, or NULL. */
+const char *sym_lookup(symtab_t *st, uint32_t addr, uint32_t *offset_out)
+{
+    unsigned lo = 0, hi = st->nsyms, mid;
+    struct sym *s;
+
+    /* Find the first symbol above addr. */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (st->syms[mid].addr <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return NULL;
+    }
+    s = &st->syms[lo - 1];
+    if (s->size && (addr - s->addr >= s->size)) {
+        return NULL;
+    }
+    if (offset_out) {
+        *offset_out = addr - s->addr;
+    }
+    return s->name;
+}
+
+static int load_elf(symtab_t *st, FILE *f, char *file)
+{
+    unsigned char ehdr[52], shdr[SHDR_SIZE], link[SHDR_SIZE], sym[SYM_SIZE];
+    uint32_t shoff, shnum, i, j, off, size, stroff, strsize, name;
+    char *strs = NULL;
+    int msb;
+
+    rewind(f);
+    if (fread(ehdr, 1, sizeof(ehdr), f) != sizeof(ehdr) || (ehdr[4] != 1)) {
+        goto bad;
+    }
+    msb = ehdr[EI_DATA] == ELFDATA2MSB;
+    shoff = get32(ehdr + 32, msb);
+    shnum = get16(ehdr + 48, msb);
+
+    for (i = 0; i < shnum; i++) {
+        if (fseek(f, shoff + i * SHDR_SIZE, SEEK_SET) ||
+            (fread(shdr, 1, SHDR_SIZE, f) != SHDR_SIZE)) {
+            goto bad;
+        }
+        if (get32(shdr + 4, msb) != SHT_SYMTAB) {
+            continue;
+        }
+
+        /* sh_link names the string table. */
+        if (fseek(f, shoff + get32(shdr + 24, msb) * SHDR_SIZE, SEEK_SET) ||
+            (fread(link, 1, SHDR_SIZE, f) != SHDR_SIZE)) {
+            goto bad;
+        }
+        stroff = get32(link + 16, msb);
+        strsize = get32(link + 20, msb);
+        strs = xmalloc(strsize + 1);
+        if (fseek(f, stroff, SEEK_SET) ||
+            (fread(strs, 1, strsize, f) != strsize)) {
+            goto bad;
+        }
+        strs[strsize] = '\0';
+
+        off = get32(shdr + 16, msb);
+        size = get32(shdr + 20, msb);
+        for (j = 0; j < size / SYM_SIZE; j++) {
+            if (fseek(f, off + j * SYM_SIZE, SEEK_SET) ||
+                (fread(sym, 1, SYM_SIZE, f) != SYM_SIZE)) {
+                goto bad;
+            }
+            name = get32(sym, msb);
+            if (((sym[12] & 0xF) != STT_FUNC) || (name >= strsize) ||
+                !strs[name]) {
+                continue;
+            }
+            add(st, get32(sym + 4, msb), get32(sym + 8, msb), strs + name);
+        }
+        free(strs);
+        return 0;
+    }
+
+    debug_printf(CONFIG, FATAL, "%s: no symbol table\n", file);
+    return 1;
+
+bad:
+    free(strs);
+    debug_printf(CONFIG, FATAL, "%s: malformed ELF32 file\n", file);
+    return 1;
+}
+
+static int load_map(symtab_t *st, FILE *f, char *file)
+{
+    char line[256], *p, *end, *name;
+    unsigned long addr;
+    unsigned n = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        n++;
+        for (p = line + strlen(line); (p > line) && (p[-1] <= ' '); p--)
+            ;
+        *p = '\0';
+        if (!line[0] || (line[0] == '#')) {
+            continue;
+        }
+        addr = strtoul(line, &end, 16);
+        name = strrchr(line, ' ');
+        if ((end == line) || !name || (name < end)) {
+            debug_printf(CONFIG, FATAL, "%s:%u: expected <addr> ... <name>\n",
+                    file, n);
+            return 1;
+        }
+        add(st, addr, 0, name + 1);
+    }
+    return 0;
+}
+
+static void add(symtab_t *st, uint32_t addr, uint32_t size, const char *name)
+{
+    if (st->nsyms == st->cap) {
+        st->cap = st->cap ? 2 * st->cap : 64;
+        st->syms = xrealloc(st->syms, st->cap * sizeof(*st->syms));
+    }
+    st->syms[st->nsyms].addr = addr;
+    st->syms[st->nsyms].size = size;
+    st->syms[st->nsyms].name = xmalloc(strlen(name) + 1);
+    strcpy(st->syms[st->nsyms].name, name);
+    st->nsyms++;
+}
+
+static int cmp_sym(const void *a, const void *b)
+{
+    const struct sym *x = a, *y = b;
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static uint32_t get32(const unsigned char *p, int msb)
+{
+    if (msb) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | p[3];
+    }
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint32_t get16(const unsigned char *p, int msb)
+{
+    return msb ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+}
@@ -0,0 +1,12 @@
+#ifndef SYM_H
+#define SYM_H
+
+#include <stdint.h>
+
+typedef struct symtab symtab_t;
+
+symtab_t *sym_load(char *file);
+void sym_destroy(symtab_t *st);
+const char *sym_lookup(symtab_t *st, uint32_t addr, uint32_t *offset_out);
+
+#endif
@@ -0,0 +1,180 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "core.h"
+#include "debug.h"
+#include "mem_dev.h"
+#include "sched.h"
+#include "timer.h"
+#include "util.h"
+
+typedef struct timer_dev timer_dev_t;
+struct timer_dev {
+    mem_dev_t dev;
+    core_t *core;
+    sched_t *sched;
+    int irq;
+
+    uint32_t interval;
+    uint32_t ctrl;
+    uint32_t status;
+
+    sched_event_t ev;
+};
+
+/* What a checkpoint needs, including when (if at all) we're due to fire. */
+struct timer_state {
+    uint32_t interval;
+    uint32_t ctrl;
+    uint32_t status;
+    int queued;
+    uint64_t when;
+};
+
+static int timer_read(mem_dev_t *dev, uint32_t offset, uint32_t *val_out);
+static int timer_write(mem_dev_t *dev, uint32_t offset,
+                       uint32_t val, uint8_t we);
+static void timer_save(mem_dev_t *dev, void *buf);
+static void timer_restore(mem_dev_t *dev, const void *buf);
+static void timer_fire(sched_t *s, sched_event_t *ev);
+static void timer_arm(timer_dev_t *t, uint64_t from);
+
+mem_dev_t *timer_create(core_t *core, int irq)
+{
+    timer_dev_t *t;
+
+    t = xmalloc(sizeof(*t));
+    t->dev.size = TIMER_SIZE;
+    t->dev.read = &timer_read;
+    t->dev.write = &timer_write;
+    t->dev.map = NULL;
+    t->dev.state_size = sizeof(struct timer_state);
+    t->dev.save = &timer_save;
+    t->dev.restore = &timer_restore;
+    t->dev.dirty = NULL;
+    t->core = core;
+    t->sched = core_get_sched(core);
+    t->irq = irq;
+    t->interval = 0;
+    t->ctrl = 0;
+    t->status = 0;
+    sched_event_init(&t->ev, &timer_fire, t);
+
+    return (mem_dev_t *)t;
+}
+
+void timer_destroy(mem_dev_t *dev)
+{
+    timer_dev_t *t = (timer_dev_t *)dev;
+    assert(t->dev.read == &timer_read);
+
+    sched_cancel(t->sched, &t->ev);
+    free(t);
+}
+
+static int timer_read(mem_dev_t *dev, uint32_t offset, uint32_t *val_out)
+{
+    timer_dev_t *t = (timer_dev_t *)dev;
+
+    switch (offset) {
+    case TIMER_COUNT:
+        *val_out = (uint32_t)t->sched->now;
+        break;
+    case TIMER_INTERVAL:
+        *val_out = t->interval;
+        break;
+    case TIMER_CTRL:
+        *val_out = t->ctrl;
+        break;
+    case TIMER_STATUS:
+        *val_out = t->status;
+        break;
+    default:
+        return 1;
+    }
+
+    return 0;
+}
+
+static int timer_write(mem_dev_t *dev, uint32_t offset,
+                       uint32_t val, uint8_t we)
+{
+    timer_dev_t *t = (timer_dev_t *)dev;
+    uint32_t mask = we_to_mask(we);
+
+    switch (offset) {
+    case TIMER_COUNT:
+        return 1;
+    case TIMER_INTERVAL:
+        t->interval = (t->interval & ~mask) | (val & mask);
+        break;
+    case TIMER_CTRL:
+        t->ctrl = (t->ctrl & ~mask) | (val & mask);
+        break;
+    case TIMER_STATUS:
+        if (val & mask & TIMER_STATUS_PENDING) {
+            t->status &= ~TIMER_STATUS_PENDING;
+            core_set_irq(t->core, t->irq, 0);
+        }
+        return 0;
+    default:
+        return 1;
+    }
+
+    sched_cancel(t->sched, &t->ev);
+    timer_arm(t, t->sched->now);
+
+    return 0;
+}
+
+static void timer_save(mem_dev_t *dev, void *buf)
+{
+    timer_dev_t *t = (timer_dev_t *)dev;
+    struct timer_state *st = buf;
+
+    st->interval = t->interval;
+    st->ctrl = t->ctrl;
+    st->status = t->status;
+    st->queued = t->ev.queued;
+    st->when = t->ev.when;
+}
+
+/* The IRQ line itself is part of CAUSE, which the core restores. */
+static void timer_restore(mem_dev_t *dev, const void *buf)
+{
+    timer_dev_t *t = (timer_dev_t *)dev;
+    const struct timer_state *st = buf;
+
+    t->interval = st->interval;
+    t->ctrl = st->ctrl;
+    t->status = st->status;
+    sched_cancel(t->sched, &t->ev);
+    if (st->queued) {
+        sched_add(t->sched, &t->ev, st->when);
+    }
+}
+
+static void timer_fire(sched_t *s, sched_event_t *ev)
+{
+    timer_dev_t *t = (timer_dev_t *)ev->arg;
+
+    debug_printf(TIMER, DETAIL, "Timer fired at %lu\n",
+            (unsigned long)s->now);
+
+    t->status |= TIMER_STATUS_PENDING;
+    core_set_irq(t->core, t->irq, 1);
+
+    if (t->ctrl & TIMER_CTRL_PERIODIC) {
+        timer_arm(t, ev->when);
+    } else {
+        t->ctrl &= ~TIMER_CTRL_ENABLE;
+    }
+}
+
+static void timer_arm(timer_dev_t *t, uint64_t from)
+{
+    if ((t->ctrl & TIMER_CTRL_ENABLE) && t->interval) {
+        sched_add(t->sched, &t->ev, from + t->interval);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "core.h"
+#include "mem_dev.h"
+
+/*
+ Register layout (word offsets from the base address):
+   0x0 COUNT     (R)  Low 32 bits of the retired instruction count.
+   0x4 INTERVAL  (RW) Instructions between arming and firing.
+   0x8 CTRL      (RW) TIMER_CTRL_* bits; writing it (re)arms the timer.
+   0xC STATUS    (RW) TIMER_STATUS_PENDING; write 1 to acknowledge.
+ */
+enum {
+    TIMER_COUNT    = 0x0,
+    TIMER_INTERVAL = 0x4,
+    TIMER_CTRL     = 0x8,
+    TIMER_STATUS   = 0xC,
+    TIMER_SIZE     = 0x10
+};
+
+enum {
+    TIMER_CTRL_ENABLE   = 1 << 0,
+    TIMER_CTRL_PERIODIC = 1 << 1
+};
+
+enum {
+    TIMER_STATUS_PENDING = 1 << 0
+};
+
+mem_dev_t *timer_create(core_t *core, int irq);
+void timer_destroy(mem_dev_t *dev);
+
+#endif
@@ -0,0 +1,128 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "mem.h"
+#include "mem_dev.h"
+#include "trap.h"
+#include "util.h"
+
+struct trap_range {
+    uint32_t addr;
+    uint32_t len;
+    int kinds;
+};
+
+struct trap {
+    mem_t *mem;
+    struct trap_range *ranges;
+    unsigned nranges;
+    unsigned cap;
+};
+
+static void unmark_pages(trap_t *t, uint32_t first, uint32_t last);
+
+trap_t *trap_create(mem_t *mem)
+{
+    trap_t *t = xmalloc(sizeof(*t));
+
+    t->mem = mem;
+    t->ranges = NULL;
+    t->nranges = t->cap = 0;
+    return t;
+}
+
+void trap_destroy(trap_t *t)
+{
+    while (t->nranges) {
+        trap_remove(t, t->ranges[0].addr, t->ranges[0].len,
+                    t->ranges[0].kinds);
+    }
+    free(t->ranges);
+    free(t);
+}
+
+/* Returns nonzero if some of the range isn't mapped. */
+int trap_add(trap_t *t, uint32_t addr, uint32_t len, int kinds)
+{
+    struct trap_range *r;
+    uint32_t first, last, page;
+
+    assert(len > 0);
+
+    first = addr >> MEM_DEV_PAGE_SHIFT;
+    last = (addr + len - 1) >> MEM_DEV_PAGE_SHIFT;
+    for (page = first; page <= last; page++) {
+        if (mem_trap_page(t->mem, page << MEM_DEV_PAGE_SHIFT, 1)) {
+            if (page > first) {
+                unmark_pages(t, first, page - 1);
+            }
+            return 1;
+        }
+    }
+
+    if (t->nranges == t->cap) {
+        t->cap = t->cap ? 2 * t->cap : 16;
+        t->ranges = xrealloc(t->ranges, t->cap * sizeof(*t->ranges));
+    }
+    r = &t->ranges[t->nranges++];
+    r->addr = addr;
+    r->len = len;
+    r->kinds = kinds;
+    return 0;
+}
+
+/* Removes a trap added with the same arguments; nonzero if there isn't one. */
+int trap_remove(trap_t *t, uint32_t addr, uint32_t len, int kinds)
+{
+    unsigned i;
+
+    for (i = 0; i < t->nranges; i++) {
+        if ((t->ranges[i].addr == addr) && (t->ranges[i].len == len) &&
+            (t->ranges[i].kinds == kinds)) {
+            break;
+        }
+    }
+    if (i == t->nranges) {
+        return 1;
+    }
+
+    t->ranges[i] = t->ranges[--t->nranges];
+    unmark_pages(t, addr >> MEM_DEV_PAGE_SHIFT,
+                 (addr + len - 1) >> MEM_DEV_PAGE_SHIFT);
+    return 0;
+}
+
+/*
+ Returns the kinds of a trap of the given kind that overlaps
+ [addr, addr + len), or 0 if there isn't one.  Traps that stop take
+ precedence over ones that only log.
+ */
+int trap_match(trap_t *t, uint32_t addr, uint32_t len, int kind)
+{
+    struct trap_range *r;
+    unsigned i;
+    int found = 0;
+
+    for (i = 0; i < t->nranges; i++) {
+        r = &t->ranges[i];
+        if ((r->kinds & kind) && (addr - r->addr < r->len ||
+                                  r->addr - addr < len)) {
+            if (!(r->kinds & TRAP_LOG)) {
+                return r->kinds;
+            }
+            found = r->kinds;
+        }
+    }
+    return found;
+}
+
+static void unmark_pages(trap_t *t, uint32_t first, uint32_t last)
+{
+    uint32_t page;
+
+    for (page = first; page <= last; page++) {
+        mem_trap_page(t->mem, page << MEM_DEV_PAGE_SHIFT, 0);
+    }
+}
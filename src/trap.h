@@ -0,0 +1,28 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+#include <stdint.h>
+
+#include "mem.h"
+
+/*
+ Breakpoints and watchpoints on physical address ranges.  Each page that a
+ trap covers is marked in the memory map (see mem_trap_page), so the core
+ only asks us about accesses to those pages.
+ */
+enum {
+    TRAP_EXEC  = 1 << 0,
+    TRAP_READ  = 1 << 1,
+    TRAP_WRITE = 1 << 2,
+    TRAP_LOG   = 1 << 3     /* Report accesses, but don't stop. */
+};
+
+typedef struct trap trap_t;
+
+trap_t *trap_create(mem_t *mem);
+void trap_destroy(trap_t *t);
+int trap_add(trap_t *t, uint32_t addr, uint32_t len, int kinds);
+int trap_remove(trap_t *t, uint32_t addr, uint32_t len, int kinds);
+int trap_match(trap_t *t, uint32_t addr, uint32_t len, int kind);
+
+#endif
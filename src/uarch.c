@@ -0,0 +1,549 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpred.h"
+#include "cache.h"
+#include "debug.h"
+#include "dram.h"
+#include "mem.h"
+#include "ooo.h"
+#include "opcode.h"
+#include "pipe5.h"
+#include "ring.h"
+#include "uarch.h"
+#include "util.h"
+
+/* Extra cycles for a cache miss that --dram doesn't model. */
+#define MISS_LATENCY 20
+
+/*
+ The models run on their own thread, fed through a ring of records, so the
+ functional core only pays for filling in a slot per step and the timing
+ work costs wall-clock time only when it is the slower half.  The thread is
+ started on the first record and stopped by an end marker when the results
+ are wanted.
+ */
+#define UARCH_RING_SIZE 65536
+#define UARCH_END (1u << 31)
+#define UARCH_MARK (1u << 30)   /* pc holds a UARCH_MARK_* value. */
+
+/* A mapped region, as seen when the model thread started. */
+typedef struct uarch_region uarch_region_t;
+struct uarch_region {
+    uint32_t base;
+    uint32_t size;
+    int ram;
+};
+
+struct uarch {
+    cache_t *icache;
+    cache_t *dcache;
+    dram_t *dram;
+    mem_t *mem;
+    pipe5_t *pipe5;
+    ooo_t *ooo;
+    bpred_set_t *bpreds;
+    ring_t *ring;
+    pthread_t thread;
+    int running;
+
+    /* Copied from mem on the main thread, as the model thread must never
+       look at mem itself while the core is changing it. */
+    uarch_region_t *regions;
+    unsigned nregions;
+
+    /* Owned by the model thread. */
+    uint64_t insts;
+    uarch_window_t start;
+    uarch_window_t *windows;
+    unsigned nwindows;
+};
+
+static void uarch_push(uarch_t *u, const uarch_rec_t *rec);
+static void copy_regions(uarch_t *u);
+static void *uarch_thread(void *arg);
+static void do_mark(uarch_t *u, int mark);
+static void snapshot(uarch_t *u, uarch_window_t *w);
+static void uarch_process(uarch_t *u, const uarch_rec_t *rec);
+static unsigned access_latency(uarch_t *u, cache_t *c, uint32_t addr,
+                               int write, int uncached);
+static unsigned mem_latency(uarch_t *u, uint32_t addr, int write);
+static uarch_region_t *find_region(uarch_t *u, uint32_t addr);
+
+/* mem is only looked at to see which regions are RAM and which devices. */
+uarch_t *uarch_create(mem_t *mem)
+{
+    uarch_t *u = xmalloc(sizeof(*u));
+    u->icache = NULL;
+    u->dcache = NULL;
+    u->dram = NULL;
+    u->mem = mem;
+    u->pipe5 = NULL;
+    u->ooo = NULL;
+    u->bpreds = NULL;
+    u->ring = ring_create(sizeof(uarch_rec_t), UARCH_RING_SIZE);
+    u->running = 0;
+    u->regions = NULL;
+    u->nregions = 0;
+    u->insts = 0;
+    u->windows = NULL;
+    u->nwindows = 0;
+    return u;
+}
+
+void uarch_destroy(uarch_t *u)
+{
+    uarch_flush(u);
+    ring_destroy(u->ring);
+    free(u->windows);
+    free(u->regions);
+    if (u->pipe5) {
+        pipe5_destroy(u->pipe5);
+    }
+    if (u->ooo) {
+        ooo_destroy(u->ooo);
+    }
+    if (u->bpreds) {
+        bpred_set_destroy(u->bpreds);
+    }
+    free(u);
+}
+
+void uarch_set_caches(uarch_t *u, cache_t *icache, cache_t *dcache)
+{
+    u->icache = icache;
+    u->dcache = dcache;
+}
+
+/* DRAM serves cache misses, or every access without caches, to RAM. */
+void uarch_set_dram(uarch_t *u, dram_t *dram)
+{
+    u->dram = dram;
+}
+
+/* name is a model, followed by :<params> for the models that take them. */
+int uarch_set_model(uarch_t *u, char *name)
+{
+    if (!strcmp(name, "pipeline5")) {
+        if (!u->pipe5) {
+            u->pipe5 = pipe5_create();
+        }
+        return 0;
+    }
+    if (!strcmp(name, "ooo") || !strncmp(name, "ooo:", 4)) {
+        if (u->ooo) {
+            ooo_destroy(u->ooo);
+        }
+        u->ooo = ooo_create_spec(name[3] ? name + 4 : NULL);
+        return !u->ooo;
+    }
+    return 1;
+}
+
+/* spec is a comma-separated list of predictors, each <type>[:<bits>]. */
+int uarch_add_bpred(uarch_t *u, char *spec)
+{
+    char *p, *comma;
+    int ret;
+
+    if (!u->bpreds) {
+        u->bpreds = bpred_set_create();
+    }
+
+    for (p = spec; p; p = comma ? comma + 1 : NULL) {
+        comma = strchr(p, ',');
+        if (comma) { *comma = '\0'; }
+        ret = bpred_set_add(u->bpreds, p);
+        if (comma) { *comma = ','; }
+        if (ret) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void uarch_commit(uarch_t *u, const uarch_rec_t *rec)
+{
+    uarch_push(u, rec);
+}
+
+/* Marks a point in the record stream, for measuring windows of it. */
+void uarch_mark(uarch_t *u, int mark)
+{
+    uarch_rec_t rec;
+
+    rec.pc = mark;
+    rec.flags = UARCH_MARK;
+    uarch_push(u, &rec);
+}
+
+/* Returns the completed windows; only valid after uarch_flush. */
+const uarch_window_t *uarch_windows(uarch_t *u, unsigned *n)
+{
+    *n = u->nwindows;
+    return u->windows;
+}
+
+/* Waits for the models to catch up with every record committed so far. */
+void uarch_flush(uarch_t *u)
+{
+    uarch_rec_t *end;
+
+    if (!u->running) {
+        return;
+    }
+    end = ring_produce(u->ring);
+    end->flags = UARCH_END;
+    ring_produced(u->ring);
+    ring_flush(u->ring);
+    pthread_join(u->thread, NULL);
+    u->running = 0;
+}
+
+void uarch_report(uarch_t *u, FILE *out)
+{
+    uarch_flush(u);
+    if (u->icache) {
+        cache_report(u->icache, out);
+    }
+    if (u->dcache) {
+        cache_report(u->dcache, out);
+    }
+    if (u->dram) {
+        dram_report(u->dram, out, u->ooo ? ooo_cycles(u->ooo)
+                                  : u->pipe5 ? pipe5_cycles(u->pipe5) : 0);
+    }
+    if (u->pipe5) {
+        pipe5_report(u->pipe5, out);
+    }
+    if (u->ooo) {
+        ooo_report(u->ooo, out);
+    }
+    if (u->bpreds) {
+        bpred_set_report(u->bpreds, out);
+    }
+}
+
+static void uarch_push(uarch_t *u, const uarch_rec_t *rec)
+{
+    if (!u->running) {
+        copy_regions(u);
+        if (pthread_create(&u->thread, NULL, uarch_thread, u)) {
+            debug_print(CORE, FATAL, "Couldn't start uarch thread.\n");
+            abort();
+        }
+        u->running = 1;
+    }
+    *(uarch_rec_t *)ring_produce(u->ring) = *rec;
+    ring_produced(u->ring);
+}
+
+static void copy_regions(uarch_t *u)
+{
+    mem_region_t *r;
+    unsigned n = 0;
+
+    if (!u->dram && !u->icache && !u->dcache) {
+        return;
+    }
+    for (r = mem_first_region(u->mem); r; r = mem_next_region(r)) {
+        n++;
+    }
+    free(u->regions);
+    u->regions = xmalloc((n + 1) * sizeof(*u->regions));
+    u->nregions = 0;
+    for (r = mem_first_region(u->mem); r; r = mem_next_region(r)) {
+        u->regions[u->nregions].base = mem_region_base(r);
+        u->regions[u->nregions].size = mem_region_dev(r)->size;
+        u->regions[u->nregions].ram = !!mem_region_dev(r)->map;
+        u->nregions++;
+    }
+}
+
+static void *uarch_thread(void *arg)
+{
+    uarch_t *u = arg;
+    const uarch_rec_t *rec;
+
+    for (;;) {
+        rec = ring_consume(u->ring);
+        if (rec->flags & UARCH_END) {
+            ring_consumed(u->ring);
+            return NULL;
+        }
+        if (rec->flags & UARCH_MARK) {
+            do_mark(u, rec->pc);
+        } else {
+            uarch_process(u, rec);
+        }
+        ring_consumed(u->ring);
+    }
+}
+
+static void do_mark(uarch_t *u, int mark)
+{
+    uarch_window_t now, *w;
+
+    if (mark == UARCH_MARK_BEGIN) {
+        snapshot(u, &u->start);
+        return;
+    }
+
+    snapshot(u, &now);
+    if (!(u->nwindows & (u->nwindows - 1))) {
+        u->windows = xrealloc(u->windows,
+                (u->nwindows ? 2 * u->nwindows : 1) * sizeof(*u->windows));
+    }
+    w = &u->windows[u->nwindows++];
+    w->insts = now.insts - u->start.insts;
+    w->cycles = now.cycles - u->start.cycles;
+    w->iaccesses = now.iaccesses - u->start.iaccesses;
+    w->imisses = now.imisses - u->start.imisses;
+    w->daccesses = now.daccesses - u->start.daccesses;
+    w->dmisses = now.dmisses - u->start.dmisses;
+}
+
+static void snapshot(uarch_t *u, uarch_window_t *w)
+{
+    memset(w, 0, sizeof(*w));
+    w->insts = u->insts;
+    if (u->ooo) {
+        w->cycles = ooo_cycles(u->ooo);
+    } else if (u->pipe5) {
+        w->cycles = pipe5_cycles(u->pipe5);
+    }
+    if (u->icache) {
+        cache_counts(u->icache, &w->iaccesses, &w->imisses);
+    }
+    if (u->dcache) {
+        cache_counts(u->dcache, &w->daccesses, &w->dmisses);
+    }
+}
+
+static void uarch_process(uarch_t *u, const uarch_rec_t *rec)
+{
+    unsigned ilat = 0, dlat = 0;
+    uarch_dec_t d;
+
+    if (!(rec->flags & UARCH_EXC)) {
+        u->insts++;
+    }
+    if (rec->flags & UARCH_FETCH) {
+        ilat = access_latency(u, u->icache, rec->ipa, 0,
+                              rec->flags & UARCH_IUNCACHED);
+    }
+    if (rec->flags & (UARCH_LOAD | UARCH_STORE)) {
+        dlat = access_latency(u, u->dcache, rec->maddr,
+                              rec->flags & UARCH_STORE,
+                              rec->flags & UARCH_DUNCACHED);
+    }
+
+    if (!u->pipe5 && !u->ooo && !u->bpreds) {
+        return;
+    }
+
+    uarch_decode(rec->ins, &d);
+    if (u->bpreds && !(rec->flags & UARCH_EXC) &&
+        ((d.cls == UARCH_CLASS_BRANCH) || (d.cls == UARCH_CLASS_JUMP) ||
+         (d.cls == UARCH_CLASS_JUMP_REG))) {
+        bpred_set_update(u->bpreds, rec, &d);
+    }
+    if (u->pipe5) {
+        pipe5_commit(u->pipe5, rec, &d, ilat, dlat);
+    }
+    if (u->ooo) {
+        ooo_commit(u->ooo, rec, &d, ilat, dlat);
+    }
+}
+
+/*
+ The extra latency of an access through cache c (or NULL), which is
+ bypassed for uncached (kseg1) accesses and for device registers, so that
+ polling a device doesn't count as cache hits.
+ */
+static unsigned access_latency(uarch_t *u, cache_t *c, uint32_t addr,
+                               int write, int uncached)
+{
+    uarch_region_t *r;
+    uint32_t wb_addr;
+    unsigned lat = 0;
+    int ret;
+
+    if (c && !uncached) {
+        r = find_region(u, addr);
+        uncached = r && !r->ram;
+    }
+    if (!c || uncached) {
+        return (c || u->dram) ? mem_latency(u, addr, write) : 0;
+    }
+
+    ret = cache_access(c, addr, write, &wb_addr);
+    if (!(ret & CACHE_HIT)) {
+        /* Only a write that doesn't allocate goes to memory as a write. */
+        lat = mem_latency(u, addr, write && !(ret & CACHE_FILL));
+    }
+    /*
+     The dirty line goes to DRAM after the fill, as if from a write buffer:
+     it takes DRAM time and bandwidth, but the access doesn't wait for it.
+     */
+    if ((ret & CACHE_WRITEBACK) && u->dram) {
+        mem_latency(u, wb_addr, 1);
+    }
+    return lat;
+}
+
+static unsigned mem_latency(uarch_t *u, uint32_t addr, int write)
+{
+    uarch_region_t *r;
+
+    if (!u->dram) {
+        return MISS_LATENCY;
+    }
+    r = find_region(u, addr);
+    if (r && r->ram) {
+        return dram_access(u->dram, addr, write);
+    }
+    return MISS_LATENCY;
+}
+
+/* Regions are in mem's order, so the first that holds addr is it. */
+static uarch_region_t *find_region(uarch_t *u, uint32_t addr)
+{
+    unsigned i;
+
+    for (i = 0; i < u->nregions; i++) {
+        if ((u->regions[i].base <= addr) &&
+            (addr - u->regions[i].base < u->regions[i].size)) {
+            return &u->regions[i];
+        }
+    }
+    return NULL;
+}
+
+void uarch_decode(uint32_t ins, uarch_dec_t *d)
+{
+    d->cls = UARCH_CLASS_ALU;
+    d->src1 = d->src2 = d->dst = UARCH_NO_REG;
+    d->reads_hilo = d->writes_hilo = 0;
+
+    switch (OP(ins)) {
+    case OP_SPECIAL:
+        switch (FUNCT(ins)) {
+        case FUNCT_SLL:
+        case FUNCT_SRL:
+        case FUNCT_SRA:
+            d->src1 = RT(ins);
+            d->dst = RD(ins);
+            break;
+        case FUNCT_JR:
+            d->cls = UARCH_CLASS_JUMP_REG;
+            d->src1 = RS(ins);
+            break;
+        case FUNCT_JALR:
+            d->cls = UARCH_CLASS_JUMP_REG;
+            d->src1 = RS(ins);
+            d->dst = RD(ins);
+            break;
+        case FUNCT_SYSCALL:
+        case FUNCT_TESTDONE:
+            d->cls = UARCH_CLASS_SYSTEM;
+            break;
+        case FUNCT_MFHI:
+        case FUNCT_MFLO:
+            d->cls = UARCH_CLASS_HILO;
+            d->reads_hilo = 1;
+            d->dst = RD(ins);
+            break;
+        case FUNCT_MTHI:
+        case FUNCT_MTLO:
+            d->cls = UARCH_CLASS_HILO;
+            d->writes_hilo = 1;
+            d->src1 = RS(ins);
+            break;
+        case FUNCT_MULT:
+        case FUNCT_MULTU:
+            d->cls = UARCH_CLASS_MULT;
+            d->src1 = RS(ins);
+            d->src2 = RT(ins);
+            d->writes_hilo = 1;
+            break;
+        case FUNCT_DIV:
+        case FUNCT_DIVU:
+            d->cls = UARCH_CLASS_DIV;
+            d->src1 = RS(ins);
+            d->src2 = RT(ins);
+            d->writes_hilo = 1;
+            break;
+        default:
+            /* Includes the variable shifts, which read rs and rt too. */
+            d->src1 = RS(ins);
+            d->src2 = RT(ins);
+            d->dst = RD(ins);
+            break;
+        }
+        break;
+    case OP_REGIMM:
+        d->cls = UARCH_CLASS_BRANCH;
+        d->src1 = RS(ins);
+        if ((RT(ins) == REGIMM_BLTZAL) || (RT(ins) == REGIMM_BGEZAL)) {
+            d->dst = 31;
+        }
+        break;
+    case OP_J:
+        d->cls = UARCH_CLASS_JUMP;
+        break;
+    case OP_JAL:
+        d->cls = UARCH_CLASS_JUMP;
+        d->dst = 31;
+        break;
+    case OP_BEQ:
+    case OP_BNE:
+        d->cls = UARCH_CLASS_BRANCH;
+        d->src1 = RS(ins);
+        d->src2 = RT(ins);
+        break;
+    case OP_BLEZ:
+    case OP_BGTZ:
+        d->cls = UARCH_CLASS_BRANCH;
+        d->src1 = RS(ins);
+        break;
+    case OP_LUI:
+        d->dst = RT(ins);
+        break;
+    case OP_LB:
+    case OP_LH:
+    case OP_LW:
+    case OP_LBU:
+    case OP_LHU:
+        d->cls = UARCH_CLASS_LOAD;
+        d->src1 = RS(ins);
+        d->dst = RT(ins);
+        break;
+    case OP_SB:
+    case OP_SH:
+    case OP_SW:
+        d->cls = UARCH_CLASS_STORE;
+        d->src1 = RS(ins);
+        d->src2 = RT(ins);
+        break;
+    case OP_COP0:
+        d->cls = UARCH_CLASS_SYSTEM;
+        if (RS(ins) == COP_MF) {
+            d->dst = RT(ins);
+        } else if (RS(ins) == COP_MT) {
+            d->src1 = RT(ins);
+        }
+        break;
+    default:
+        d->src1 = RS(ins);
+        d->dst = RT(ins);
+        break;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef UARCH_H
+#define UARCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "dram.h"
+#include "mem.h"
+
+typedef struct uarch uarch_t;
+typedef struct uarch_rec uarch_rec_t;
+typedef struct uarch_dec uarch_dec_t;
+
+enum {
+    UARCH_FETCH = 1 << 0,   /* ipa is valid. */
+    UARCH_LOAD  = 1 << 1,   /* maddr is valid. */
+    UARCH_STORE = 1 << 2,   /* maddr is valid. */
+    UARCH_EXC   = 1 << 3,   /* Took an exception instead of retiring. */
+    UARCH_IUNCACHED = 1 << 4,   /* The fetch bypasses the caches (kseg1). */
+    UARCH_DUNCACHED = 1 << 5    /* So does the load or store. */
+};
+
+/* What the functional core tells the timing models about each step. */
+struct uarch_rec {
+    uint32_t pc;
+    uint32_t ins;
+    uint32_t next_pc;
+    uint32_t ipa;
+    uint32_t maddr;
+    uint32_t flags;
+};
+
+enum {
+    UARCH_CLASS_ALU,
+    UARCH_CLASS_LOAD,
+    UARCH_CLASS_STORE,
+    UARCH_CLASS_BRANCH,     /* Conditional, PC-relative. */
+    UARCH_CLASS_JUMP,       /* J, JAL. */
+    UARCH_CLASS_JUMP_REG,   /* JR, JALR. */
+    UARCH_CLASS_MULT,
+    UARCH_CLASS_DIV,
+    UARCH_CLASS_HILO,       /* MFHI/MFLO/MTHI/MTLO. */
+    UARCH_CLASS_SYSTEM,     /* COP0, SYSCALL, TESTDONE. */
+    NUM_UARCH_CLASSES
+};
+
+#define UARCH_NO_REG 0
+
+/* Register usage of an instruction; $0 reads and writes are dropped. */
+struct uarch_dec {
+    int cls;
+    uint8_t src1;
+    uint8_t src2;           /* For stores, the data register. */
+    uint8_t dst;
+    uint8_t reads_hilo;
+    uint8_t writes_hilo;
+};
+
+enum {
+    UARCH_MARK_BEGIN,       /* Start of a measurement window. */
+    UARCH_MARK_END          /* End of one. */
+};
+
+/* What happened in one measurement window; counts are deltas. */
+typedef struct uarch_window {
+    uint64_t insts;
+    uint64_t cycles;        /* From ooo if enabled, else pipeline5, else 0. */
+    uint64_t iaccesses, imisses;
+    uint64_t daccesses, dmisses;
+} uarch_window_t;
+
+uarch_t *uarch_create(mem_t *mem);
+void uarch_destroy(uarch_t *u);
+void uarch_set_caches(uarch_t *u, cache_t *icache, cache_t *dcache);
+void uarch_set_dram(uarch_t *u, dram_t *dram);
+int uarch_set_model(uarch_t *u, char *name);
+int uarch_add_bpred(uarch_t *u, char *spec);
+void uarch_commit(uarch_t *u, const uarch_rec_t *rec);
+void uarch_flush(uarch_t *u);
+void uarch_mark(uarch_t *u, int mark);
+const uarch_window_t *uarch_windows(uarch_t *u, unsigned *n);
+void uarch_report(uarch_t *u, FILE *out);
+
+void uarch_decode(uint32_t ins, uarch_dec_t *d);
+
+#endif
@@ -5,8 +5,15 @@
 #include "debug.h"
 #include "util.h"
 
+/*
+ Calls to xmalloc and xrealloc, for the microbenchmarks.  The model and
+ trace parser threads allocate too, so it is only updated atomically.
+ */
+unsigned long xmalloc_count;
+
 void *xmalloc(size_t size) {
     void *p = malloc(size);
+    __atomic_fetch_add(&xmalloc_count, 1, __ATOMIC_RELAXED);
     if (!p) {
         debug_printf(UTIL, FATAL, "xmalloc: malloc(%li) returned NULL\n",
                 size);
@@ -14,3 +21,22 @@ void *xmalloc(size_t size) {
     }
     return p;
 }
+
+void *xrealloc(void *p, size_t size) {
+    p = realloc(p, size);
+    __atomic_fetch_add(&xmalloc_count, 1, __ATOMIC_RELAXED);
+    if (!p) {
+        debug_printf(UTIL, FATAL, "xrealloc: realloc(%li) returned NULL\n",
+                size);
+        abort();
+    }
+    return p;
+}
+
+uint32_t we_to_mask(uint8_t we)
+{
+    return ((we & 8) ? 0xFF000000 : 0) |
+           ((we & 4) ? 0x00FF0000 : 0) |
+           ((we & 2) ? 0x0000FF00 : 0) |
+           ((we & 1) ? 0x000000FF : 0);
+}
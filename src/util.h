@@ -2,7 +2,12 @@
 #define UTIL_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+extern unsigned long xmalloc_count;
 
 void *xmalloc(size_t size);
+void *xrealloc(void *p, size_t size);
+uint32_t we_to_mask(uint8_t we);
 
 #endif